@@ -9,6 +9,8 @@ HopliteClient = _hoplite_store.DistributedObjectStore
 Buffer = _hoplite_store.Buffer
 ObjectID = _hoplite_store.ObjectID
 ReduceOp = _hoplite_store.ReduceOp
+DataType = _hoplite_store.DataType
+WireFormat = _hoplite_store.WireFormat
 
 
 def get_my_address():
@@ -71,4 +73,4 @@ def start_location_server():
 
 __all__ = ('start_location_server', 'random_object_id', 'object_id_from_int',
            'create_store_using_dict', 'extract_dict_from_args', 'add_arguments', 'get_my_address',
-           'Buffer', 'ObjectID', 'ReduceOp')
+           'Buffer', 'ObjectID', 'ReduceOp', 'DataType', 'WireFormat')
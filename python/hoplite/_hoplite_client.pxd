@@ -37,15 +37,59 @@ cdef extern from "common/id.h" namespace "" nogil:
 
 
 cdef extern from "common/buffer.h" namespace "" nogil:
+    ctypedef void (*CBufferReleaseCallback "BufferReleaseCallback")(void *context)
+
     cdef cppclass CBuffer "Buffer":
         CBuffer(int64_t size)
         CBuffer(uint8_t* data, int64_t size)
+        CBuffer(uint8_t* data, int64_t size, CBufferReleaseCallback release_callback, void *release_context)
         const uint8_t* Data()
         uint8_t* MutableData()
         int64_t Size()
         uint64_t Hash() const
 
 
+cdef extern from "common/reduce_kernels.h" namespace "" nogil:
+    cdef cppclass CReduceOp "ReduceOp":
+        pass
+
+    cdef cppclass CReduceDataType "ReduceDataType":
+        pass
+
+
+cdef extern from "common/reduce_kernels.h" namespace "ReduceOp" nogil:
+    cdef CReduceOp CReduceOpSUM "ReduceOp::SUM"
+    cdef CReduceOp CReduceOpMIN "ReduceOp::MIN"
+    cdef CReduceOp CReduceOpMAX "ReduceOp::MAX"
+    cdef CReduceOp CReduceOpPROD "ReduceOp::PROD"
+
+
+cdef extern from "common/reduce_kernels.h" namespace "ReduceDataType" nogil:
+    cdef CReduceDataType CReduceDataTypeFLOAT32 "ReduceDataType::FLOAT32"
+    cdef CReduceDataType CReduceDataTypeFLOAT64 "ReduceDataType::FLOAT64"
+    cdef CReduceDataType CReduceDataTypeINT32 "ReduceDataType::INT32"
+    cdef CReduceDataType CReduceDataTypeINT64 "ReduceDataType::INT64"
+    cdef CReduceDataType CReduceDataTypeFLOAT16 "ReduceDataType::FLOAT16"
+    cdef CReduceDataType CReduceDataTypeBFLOAT16 "ReduceDataType::BFLOAT16"
+
+
+cdef extern from "common/wire_quantization.h" namespace "" nogil:
+    cdef cppclass CWireFormat "WireFormat":
+        pass
+
+    cdef cppclass CWireQuantization "WireQuantization":
+        CWireFormat format
+        int64_t error_feedback_id
+
+
+cdef extern from "common/wire_quantization.h" namespace "WireFormat" nogil:
+    cdef CWireFormat CWireFormatRAW "WireFormat::RAW"
+    cdef CWireFormat CWireFormatFLOAT16 "WireFormat::FLOAT16"
+    cdef CWireFormat CWireFormatBFLOAT16 "WireFormat::BFLOAT16"
+    cdef CWireFormat CWireFormatINT8 "WireFormat::INT8"
+    cdef CWireFormat CWireFormatSPARSE "WireFormat::SPARSE"
+
+
 cdef extern from "client/distributed_object_store.h" namespace "" nogil:
     cdef cppclass CDistributedObjectStore "DistributedObjectStore":
         CDistributedObjectStore(const c_string &object_directory_address)
@@ -54,6 +98,10 @@ cdef extern from "client/distributed_object_store.h" namespace "" nogil:
 
         CObjectID Put(const shared_ptr[CBuffer] &buffer)
 
+        void PutZeroCopy(const shared_ptr[CBuffer] &buffer, const CObjectID &object_id)
+
+        CObjectID PutZeroCopy(const shared_ptr[CBuffer] &buffer)
+
         void Reduce(const c_vector[CObjectID] &object_ids,
                     CObjectID *created_reduction_id)
 
@@ -68,7 +116,58 @@ cdef extern from "client/distributed_object_store.h" namespace "" nogil:
                     const CObjectID &reduction_id,
                     ssize_t num_reduce_objects)
 
+        void Reduce(const c_vector[CObjectID] &object_ids,
+                    CObjectID *created_reduction_id,
+                    ssize_t num_reduce_objects,
+                    CReduceOp reduce_op,
+                    CReduceDataType reduce_dtype)
+
+        void Reduce(const c_vector[CObjectID] &object_ids,
+                    const CObjectID &reduction_id,
+                    ssize_t num_reduce_objects,
+                    CReduceOp reduce_op,
+                    CReduceDataType reduce_dtype)
+
+        void Reduce(const c_vector[CObjectID] &object_ids,
+                    CObjectID *created_reduction_id,
+                    ssize_t num_reduce_objects,
+                    CReduceOp reduce_op,
+                    CReduceDataType reduce_dtype,
+                    const CWireQuantization &quantization)
+
+        void Reduce(const c_vector[CObjectID] &object_ids,
+                    const CObjectID &reduction_id,
+                    ssize_t num_reduce_objects,
+                    CReduceOp reduce_op,
+                    CReduceDataType reduce_dtype,
+                    const CWireQuantization &quantization)
+
         unordered_set[CObjectID] GetReducedObjects(const CObjectID &reduction_id)
 
+        void Delete(const c_vector[CObjectID] &object_ids)
+
+        void AddReference(const c_vector[CObjectID] &object_ids)
+
+        void Release(const c_vector[CObjectID] &object_ids)
+
+        void AddToGroup(int64_t group, const c_vector[CObjectID] &object_ids)
+
+        void DeleteGroup(int64_t group)
+
         void Get(const CObjectID &object_id,
                  shared_ptr[CBuffer] *result)
+
+        void AllReduce(const c_vector[CObjectID] &object_ids,
+                       const CObjectID &reduction_id,
+                       shared_ptr[CBuffer] *result,
+                       c_bool is_root,
+                       CReduceOp reduce_op,
+                       CReduceDataType reduce_dtype)
+
+        void AllReduce(const c_vector[CObjectID] &object_ids,
+                       const CObjectID &reduction_id,
+                       shared_ptr[CBuffer] *result,
+                       c_bool is_root,
+                       CReduceOp reduce_op,
+                       CReduceDataType reduce_dtype,
+                       const CWireQuantization &quantization)
@@ -12,7 +12,15 @@ from libcpp.unordered_set cimport unordered_set
 from libcpp.vector cimport vector as c_vector
 
 from hoplite._hoplite_client cimport CDistributedObjectStore, CBuffer, CObjectID, CRayLog, CRayLogDEBUG, CRayLogINFO, CRayLogERROR
+from hoplite._hoplite_client cimport (
+    CReduceOp, CReduceOpSUM, CReduceOpMIN, CReduceOpMAX, CReduceOpPROD,
+    CReduceDataType, CReduceDataTypeFLOAT32, CReduceDataTypeFLOAT64, CReduceDataTypeINT32, CReduceDataTypeINT64,
+    CReduceDataTypeFLOAT16, CReduceDataTypeBFLOAT16)
+from hoplite._hoplite_client cimport (
+    CWireQuantization, CWireFormatRAW, CWireFormatFLOAT16, CWireFormatBFLOAT16, CWireFormatINT8,
+    CWireFormatSPARSE)
 from cpython cimport Py_buffer, PyObject
+from cpython.ref cimport Py_INCREF, Py_DECREF
 from cpython.buffer cimport PyBUF_SIMPLE, PyObject_CheckBuffer, PyBuffer_Release, PyObject_GetBuffer, PyBuffer_FillInfo
 
 from enum import Enum
@@ -21,6 +29,10 @@ import socket
 from cython.operator cimport dereference, preincrement
 
 
+cdef void _release_python_object(void *obj) noexcept with gil:
+    Py_DECREF(<object>obj)
+
+
 cdef class Buffer:
     cdef:
         shared_ptr[CBuffer] buf
@@ -131,6 +143,82 @@ class ReduceOp(Enum):
      PROD = 4
 
 
+class DataType(Enum):
+     FLOAT32 = 1
+     FLOAT64 = 2
+     INT32 = 3
+     INT64 = 4
+     FLOAT16 = 5
+     BFLOAT16 = 6
+
+
+class WireFormat(Enum):
+     """How the partial results of a reduction are sent between nodes.
+
+     FLOAT16, BFLOAT16 and INT8 quantize float32 reductions, which are still computed
+     in float32. SPARSE is exact for every dtype, and sends mostly-zero blocks as
+     indices and values.
+     """
+     RAW = 1
+     FLOAT16 = 2
+     BFLOAT16 = 3
+     INT8 = 4
+     SPARSE = 5
+
+
+cdef CReduceOp _to_c_reduce_op(reduce_op) except *:
+    if reduce_op == ReduceOp.SUM:
+        return CReduceOpSUM
+    elif reduce_op == ReduceOp.MIN:
+        return CReduceOpMIN
+    elif reduce_op == ReduceOp.MAX:
+        return CReduceOpMAX
+    elif reduce_op == ReduceOp.PROD:
+        return CReduceOpPROD
+    raise NotImplementedError("Unsupported reduce_op")
+
+
+cdef CReduceDataType _to_c_reduce_dtype(dtype) except *:
+    if dtype == DataType.FLOAT32:
+        return CReduceDataTypeFLOAT32
+    elif dtype == DataType.FLOAT64:
+        return CReduceDataTypeFLOAT64
+    elif dtype == DataType.INT32:
+        return CReduceDataTypeINT32
+    elif dtype == DataType.INT64:
+        return CReduceDataTypeINT64
+    elif dtype == DataType.FLOAT16:
+        return CReduceDataTypeFLOAT16
+    elif dtype == DataType.BFLOAT16:
+        return CReduceDataTypeBFLOAT16
+    raise NotImplementedError("Unsupported dtype")
+
+
+cdef CWireQuantization _to_c_wire_quantization(wire_format, int64_t error_feedback_id) except *:
+    cdef CWireQuantization quantization
+    if wire_format == WireFormat.RAW:
+        quantization.format = CWireFormatRAW
+    elif wire_format == WireFormat.FLOAT16:
+        quantization.format = CWireFormatFLOAT16
+    elif wire_format == WireFormat.BFLOAT16:
+        quantization.format = CWireFormatBFLOAT16
+    elif wire_format == WireFormat.INT8:
+        quantization.format = CWireFormatINT8
+    elif wire_format == WireFormat.SPARSE:
+        quantization.format = CWireFormatSPARSE
+    else:
+        raise NotImplementedError("Unsupported wire_format")
+    quantization.error_feedback_id = error_feedback_id
+    return quantization
+
+
+cdef c_vector[CObjectID] _to_c_object_ids(object_ids) except *:
+    cdef c_vector[CObjectID] raw_object_ids
+    for oid in object_ids:
+        raw_object_ids.push_back((<ObjectID>oid).data)
+    return raw_object_ids
+
+
 cdef class DistributedObjectStore:
     cdef unique_ptr[CDistributedObjectStore] store
 
@@ -145,32 +233,55 @@ cdef class DistributedObjectStore:
         self.store.get().Get(object_id.data, &buf)
         return Buffer.from_native(buf)
 
-    def reduce_async(self, object_ids, reduce_op, reduction_id=None, num_reduce_objects=-1):
+    def reduce_async(self, object_ids, reduce_op, reduction_id=None, num_reduce_objects=-1,
+                     dtype=DataType.FLOAT32, wire_format=WireFormat.RAW, error_feedback_id=0):
+        """Reduce the objects in the background.
+
+        `wire_format` quantizes float32 partial results on the wire. With a nonzero
+        `error_feedback_id`, every node carries its quantization error over to the next
+        reduction with the same id.
+        """
         cdef:
             ObjectID _created_reduction_id = ObjectID(b'\0' * 20)
             c_vector[CObjectID] raw_object_ids
-
-        if reduce_op == ReduceOp.SUM:
-            for oid in object_ids:
-                raw_object_ids.push_back((<ObjectID>oid).data)
-            if reduction_id is not None:
-                if num_reduce_objects > 0:
-                    self.store.get().Reduce(
-                        raw_object_ids, (<ObjectID>reduction_id).data, <ssize_t>num_reduce_objects)
-                else:
-                    self.store.get().Reduce(
-                        raw_object_ids, (<ObjectID>reduction_id).data)
-                return reduction_id
-            else:
-                if num_reduce_objects > 0:
-                    self.store.get().Reduce(
-                        raw_object_ids, &_created_reduction_id.data, <ssize_t>num_reduce_objects)
-                else:
-                    self.store.get().Reduce(
-                        raw_object_ids, &_created_reduction_id.data)
-                return _created_reduction_id
+            CReduceOp c_reduce_op = _to_c_reduce_op(reduce_op)
+            CReduceDataType c_reduce_dtype = _to_c_reduce_dtype(dtype)
+            CWireQuantization c_quantization = _to_c_wire_quantization(wire_format, error_feedback_id)
+            # negative means all objects are reduced
+            ssize_t c_num_reduce_objects = num_reduce_objects if num_reduce_objects > 0 else -1
+
+        for oid in object_ids:
+            raw_object_ids.push_back((<ObjectID>oid).data)
+        if reduction_id is not None:
+            self.store.get().Reduce(
+                raw_object_ids, (<ObjectID>reduction_id).data, c_num_reduce_objects, c_reduce_op, c_reduce_dtype,
+                c_quantization)
+            return reduction_id
         else:
-            raise NotImplementedError("Unsupported reduce_op")
+            self.store.get().Reduce(
+                raw_object_ids, &_created_reduction_id.data, c_num_reduce_objects, c_reduce_op, c_reduce_dtype,
+                c_quantization)
+            return _created_reduction_id
+
+    def allreduce(self, object_ids, reduce_op, ObjectID reduction_id, is_root, dtype=DataType.FLOAT32,
+                  wire_format=WireFormat.RAW, error_feedback_id=0):
+        """Reduce the objects and return the result on every participant.
+
+        Every participant calls it with the same arguments after putting its own object, except
+        'is_root', which is true for exactly one participant that drives the reduction.
+        """
+        cdef:
+            c_vector[CObjectID] raw_object_ids
+            shared_ptr[CBuffer] buf
+            CReduceOp c_reduce_op = _to_c_reduce_op(reduce_op)
+            CReduceDataType c_reduce_dtype = _to_c_reduce_dtype(dtype)
+            CWireQuantization c_quantization = _to_c_wire_quantization(wire_format, error_feedback_id)
+
+        for oid in object_ids:
+            raw_object_ids.push_back((<ObjectID>oid).data)
+        self.store.get().AllReduce(raw_object_ids, reduction_id.data, &buf, is_root, c_reduce_op, c_reduce_dtype,
+                                   c_quantization)
+        return Buffer.from_native(buf)
 
     def get_reduced_objects(self, ObjectID reduction_id):
         cdef:
@@ -185,14 +296,53 @@ cdef class DistributedObjectStore:
             preincrement(it)
         return object_ids
 
-    def put(self, Buffer buf, object_id=None):
-        cdef CObjectID created_object_id
+    def put(self, Buffer buf, object_id=None, zero_copy=False):
+        """Put a buffer into the object store.
+
+        With zero_copy, the store publishes the memory of the buffer instead of copying it,
+        and keeps the buffer alive until the object is released. The memory must not be
+        modified afterwards.
+        """
+        cdef:
+            CObjectID created_object_id
+            shared_ptr[CBuffer] pinned_buf
+        if not zero_copy:
+            if object_id is None:
+                created_object_id = self.store.get().Put(buf.buf)
+                return ObjectID(created_object_id.Binary())
+            else:
+                self.store.get().Put(buf.buf, (<ObjectID>object_id).data)
+                return object_id
+        # the reference is dropped by the release callback
+        Py_INCREF(buf)
+        pinned_buf.reset(new CBuffer(buf.buf.get().MutableData(), buf.buf.get().Size(),
+                                     _release_python_object, <void *>buf))
         if object_id is None:
-            created_object_id = self.store.get().Put(buf.buf)
+            created_object_id = self.store.get().PutZeroCopy(pinned_buf)
             return ObjectID(created_object_id.Binary())
         else:
-            self.store.get().Put(buf.buf, (<ObjectID>object_id).data)
+            self.store.get().PutZeroCopy(pinned_buf, (<ObjectID>object_id).data)
             return object_id
 
+    def delete(self, object_ids):
+        """Delete the objects on every node, regardless of their references."""
+        self.store.get().Delete(_to_c_object_ids(object_ids))
+
+    def add_reference(self, object_ids):
+        """Add a reference to each object. Every object starts with one reference."""
+        self.store.get().AddReference(_to_c_object_ids(object_ids))
+
+    def release(self, object_ids):
+        """Drop a reference of each object. Objects without references are deleted on every node."""
+        self.store.get().Release(_to_c_object_ids(object_ids))
+
+    def add_to_group(self, int64_t group, object_ids):
+        """Add the objects to a group (e.g. a training iteration) to delete them together."""
+        self.store.get().AddToGroup(group, _to_c_object_ids(object_ids))
+
+    def delete_group(self, int64_t group):
+        """Delete all objects of the group on every node."""
+        self.store.get().DeleteGroup(group)
+
     def __dealloc__(self):
         self.store.reset()
@@ -0,0 +1,116 @@
+#include "connection_pool.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/config.h"
+#include "util/logging.h"
+#include "util/socket_utils.h"
+
+namespace {
+
+/// An idle connection must have nothing to read. EOF means the peer has closed it, and any data
+/// means the stream is out of sync, so both make the connection unusable.
+bool connection_alive(int conn_fd) {
+  char c;
+  int bytes_recv = recv(conn_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return bytes_recv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+} // namespace
+
+ConnectionPool::ConnectionPool(int port, size_t max_idle_per_peer)
+    : port_(port), max_idle_per_peer_(max_idle_per_peer) {}
+
+ConnectionPool::~ConnectionPool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &p : idle_connections_) {
+    for (int conn_fd : p.second) {
+      close(conn_fd);
+    }
+  }
+}
+
+int ConnectionPool::Acquire(const std::string &ip_address, int *conn_fd) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &idle = idle_connections_[ip_address];
+    while (!idle.empty()) {
+      int fd = idle.back();
+      idle.pop_back();
+      if (connection_alive(fd)) {
+        LOG(DEBUG) << "[ConnectionPool] reuse a connection to " << ip_address;
+        *conn_fd = fd;
+        return 0;
+      }
+      close(fd);
+    }
+  }
+  return connect_peer(ip_address, conn_fd);
+}
+
+int ConnectionPool::connect_peer(const std::string &ip_address, int *conn_fd) {
+#ifdef HOPLITE_ENABLE_LOCAL_TRANSPORT
+  bool known = false;
+  bool local = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto search = local_peers_.find(ip_address);
+    if (search != local_peers_.end()) {
+      known = true;
+      local = search->second;
+    }
+  }
+  if (!known || local) {
+    if (unix_connect(local_socket_name(ip_address, port_), conn_fd) == 0) {
+      if (!known) {
+        LOG(DEBUG) << "[ConnectionPool] " << ip_address << " is on this host, using the local socket";
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      local_peers_[ip_address] = true;
+      return 0;
+    }
+    if (local) {
+      // the local sender has gone
+      return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    local_peers_[ip_address] = false;
+  }
+#endif
+  int ec = tcp_connect(ip_address, port_, conn_fd);
+  if (ec) {
+    close(*conn_fd);
+  }
+  return ec;
+}
+
+bool ConnectionPool::IsLocal(const std::string &ip_address) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto search = local_peers_.find(ip_address);
+  return search != local_peers_.end() && search->second;
+}
+
+void ConnectionPool::Release(const std::string &ip_address, int conn_fd) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &idle = idle_connections_[ip_address];
+  if (idle.size() >= max_idle_per_peer_) {
+    close(conn_fd);
+    return;
+  }
+  idle.push_back(conn_fd);
+}
+
+void ConnectionPool::Discard(int conn_fd) { close(conn_fd); }
+
+void ConnectionPool::Prewarm(const std::vector<std::string> &ip_addresses) {
+  TIMELINE("ConnectionPool::Prewarm");
+  for (const auto &ip_address : ip_addresses) {
+    int conn_fd;
+    if (connect_peer(ip_address, &conn_fd)) {
+      LOG(WARNING) << "[ConnectionPool] cannot pre-warm the connection to " << ip_address;
+      continue;
+    }
+    Release(ip_address, conn_fd);
+  }
+}
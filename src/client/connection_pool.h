@@ -0,0 +1,53 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// A pool of long-lived data-plane connections to the senders of other nodes.
+///
+/// A connection carries one transfer at a time: a framed 'ObjectWriterRequest' followed by the
+/// requested bytes. Once all of them are received, the connection is clean and can be handed
+/// back for the next transfer to the same peer, which saves a TCP handshake and slow start.
+/// Connections that did not finish a transfer must be discarded instead.
+///
+/// Peers on the same host are reached through the Unix domain socket of their sender instead
+/// of loopback TCP. Whether a peer is local is detected by connecting to that socket once.
+class ConnectionPool {
+public:
+  /// \param port The port of the peer senders.
+  /// \param max_idle_per_peer The maximum number of idle connections kept for each peer.
+  ConnectionPool(int port, size_t max_idle_per_peer);
+
+  ~ConnectionPool();
+
+  /// Take an idle connection to the peer, or create a new one.
+  /// \param[in] ip_address The address of the peer.
+  /// \param[out] conn_fd The connection.
+  /// \return The error code of creating the connection. 0 means success.
+  int Acquire(const std::string &ip_address, int *conn_fd);
+
+  /// Hand back a connection whose transfer has completed.
+  void Release(const std::string &ip_address, int conn_fd);
+
+  /// Close a connection that failed or was interrupted during a transfer.
+  void Discard(int conn_fd);
+
+  /// Create one idle connection for each peer ahead of time. Failures are ignored.
+  void Prewarm(const std::vector<std::string> &ip_addresses);
+
+  /// Whether the connections to the peer are Unix domain sockets on this host. It is only
+  /// known after the first connection to the peer.
+  bool IsLocal(const std::string &ip_address);
+
+private:
+  int connect_peer(const std::string &ip_address, int *conn_fd);
+
+  const int port_;
+  const size_t max_idle_per_peer_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::vector<int>> idle_connections_;
+  // whether each peer that we have connected to is on this host
+  std::unordered_map<std::string, bool> local_peers_;
+};
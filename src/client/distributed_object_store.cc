@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <unordered_set>
 
 // gRPC headers
@@ -7,6 +9,7 @@
 #include <grpcpp/server_context.h>
 
 #include "common/config.h"
+#include "common/reduce_engine.h"
 #include "distributed_object_store.h"
 #include "util/logging.h"
 #include "util/socket_utils.h"
@@ -19,7 +22,8 @@ DistributedObjectStore::DistributedObjectStore(const std::string &object_directo
     : my_address_(get_host_ipaddress()), gcs_client_{object_directory_address, my_address_, OBJECT_DIRECTORY_PORT},
       local_store_client_{}, object_sender_{state_, gcs_client_, local_store_client_, my_address_},
       receiver_{state_, gcs_client_, local_store_client_, my_address_, HOPLITE_RECEIVER_PORT},
-      notification_listener_(my_address_, OBJECT_DIRECTORY_LISTENER_PORT, state_, receiver_, local_store_client_) {
+      notification_listener_(my_address_, OBJECT_DIRECTORY_LISTENER_PORT, state_, receiver_, local_store_client_),
+      async_get_pool_(HOPLITE_ASYNC_GET_THREADS), async_put_pool_(HOPLITE_ASYNC_PUT_THREADS) {
   TIMELINE("DistributedObjectStore construction function");
   // Creating the first random ObjectID will initialize the random number
   // generator, which is pretty slow. So we generate one first, and it
@@ -28,11 +32,15 @@ DistributedObjectStore::DistributedObjectStore(const std::string &object_directo
   // create a thread to send object
   object_sender_.Run();
   notification_listener_.Run();
-  gcs_client_.ConnectNotificationServer();
+  // pre-warm data-plane connections to the nodes that are already up
+  receiver_.prewarm_connections(gcs_client_.ConnectNotificationServer());
 }
 
 DistributedObjectStore::~DistributedObjectStore() {
   TIMELINE("~DistributedObjectStore");
+  // finish the pending asynchronous calls while the components are running
+  async_put_pool_.stop(true);
+  async_get_pool_.stop(true);
   object_sender_.Shutdown();
   notification_listener_.Shutdown();
   LOG(DEBUG) << "Object store has been shutdown.";
@@ -80,18 +88,40 @@ ObjectID DistributedObjectStore::Put(const std::shared_ptr<Buffer> &buffer) {
   return object_id;
 }
 
+void DistributedObjectStore::PutZeroCopy(const std::shared_ptr<Buffer> &buffer, const ObjectID &object_id) {
+  TIMELINE(std::string("DistributedObjectStore PutZeroCopy single object ") + object_id.Hex());
+  DCHECK(buffer->IsFinished()) << "Only finished buffers can be put without copying";
+  auto status = local_store_client_.Adopt(object_id, buffer);
+  DCHECK(status.ok()) << "Failed to adopt object_id = " << object_id.Hex() << " size = " << buffer->Size()
+                      << ", status = " << status.ToString();
+  gcs_client_.WriteLocation(object_id, my_address_, true, buffer->Size(), buffer->Data(),
+                            /*blocking=*/HOPLITE_PUT_BLOCKING);
+}
+
+ObjectID DistributedObjectStore::PutZeroCopy(const std::shared_ptr<Buffer> &buffer) {
+  TIMELINE("DistributedObjectStore PutZeroCopy without object_id");
+  // generate a random object id
+  auto object_id = ObjectID::FromRandom();
+  PutZeroCopy(buffer, object_id);
+  return object_id;
+}
+
 void DistributedObjectStore::Reduce(const std::vector<ObjectID> &object_ids, ObjectID *created_reduction_id,
-                                    ssize_t num_reduce_objects) {
+                                    ssize_t num_reduce_objects, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                                    const WireQuantization &quantization) {
   const auto reduction_id = ObjectID::FromRandom();
   *created_reduction_id = reduction_id;
-  Reduce(object_ids, reduction_id, num_reduce_objects);
+  Reduce(object_ids, reduction_id, num_reduce_objects, reduce_op, reduce_dtype, quantization);
 }
 
 void DistributedObjectStore::Reduce(const std::vector<ObjectID> &object_ids, const ObjectID &reduction_id,
-                                    ssize_t num_reduce_objects) {
-  // TODO: support different reduce op and types.
+                                    ssize_t num_reduce_objects, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                                    const WireQuantization &quantization) {
   TIMELINE("DistributedObjectStore Async Reduce");
   DCHECK(!object_ids.empty());
+  DCHECK(quantization.format == WireFormat::RAW || quantization.format == WireFormat::SPARSE ||
+         reduce_dtype == ReduceDataType::FLOAT32)
+      << "Only float32 reductions can be quantized on the wire.";
 
   // only include remote objects
   std::vector<ObjectID> objects_to_reduce;
@@ -125,7 +155,8 @@ void DistributedObjectStore::Reduce(const std::vector<ObjectID> &object_ids, con
     num_reduce_objects -= local_objects.size();
   }
   DCHECK(num_reduce_objects > 0);
-  gcs_client_.CreateReduceTask(objects_to_reduce, reduction_id, num_reduce_objects);
+  gcs_client_.CreateReduceTask(objects_to_reduce, reduction_id, num_reduce_objects, reduce_op, reduce_dtype,
+                               quantization);
   // this is not necessary, but we can create the reduction object ahead of time
   if (!local_objects.empty()) {
     int64_t size = local_store_client_.GetBufferNoExcept(local_objects[0])->Size();
@@ -133,6 +164,7 @@ void DistributedObjectStore::Reduce(const std::vector<ObjectID> &object_ids, con
     // NOTE: DO NOT USE CREATE() HERE! Otherwise it will override old results.
     auto status = local_store_client_.GetBufferOrCreate(reduction_id, size, &r);
     DCHECK(status.ok());
+    state_.get_local_reduce_task(reduction_id)->SetStream(r);
   }
 }
 
@@ -155,7 +187,8 @@ void DistributedObjectStore::Get(const ObjectID &object_id, std::shared_ptr<Buff
     // location here.
   } else {
     LOG(DEBUG) << "Try to fetch " << object_id.ToString() << " from local store.";
-    if (!local_store_client_.ObjectExists(object_id)) {
+    // objects received by other processes of this host are mapped instead of pulled again
+    if (!local_store_client_.ObjectExists(object_id) && !local_store_client_.AttachShared(object_id)) {
       LOG(DEBUG) << "Cannot find " << object_id.ToString() << " in local store. Try to pull it from remote";
       receiver_.pull_object(object_id);
     }
@@ -167,6 +200,232 @@ void DistributedObjectStore::Get(const ObjectID &object_id, std::shared_ptr<Buff
   *result = object_buffer.data;
 }
 
+std::vector<ObjectID> DistributedObjectStore::get_local_objects(const std::vector<ObjectID> &object_ids) {
+  std::vector<ObjectID> remote_objects;
+  std::unordered_set<ObjectID> visited;
+  for (const auto &object_id : object_ids) {
+    if (!visited.insert(object_id).second) {
+      continue;
+    }
+    if (state_.local_reduce_task_exists(object_id)) {
+      std::shared_ptr<Buffer> buffer;
+      Get(object_id, &buffer);
+    } else if (!local_store_client_.ObjectExists(object_id) && !local_store_client_.AttachShared(object_id)) {
+      remote_objects.push_back(object_id);
+    }
+  }
+  return remote_objects;
+}
+
+void DistributedObjectStore::Get(const std::vector<ObjectID> &object_ids,
+                                 std::vector<std::shared_ptr<Buffer>> *results) {
+  TIMELINE(std::string("DistributedObjectStore Get ") + std::to_string(object_ids.size()) + " objects");
+  std::vector<ObjectID> remote_objects = get_local_objects(object_ids);
+  if (!remote_objects.empty()) {
+    LOG(DEBUG) << "Pulling " << remote_objects.size() << " objects from remote";
+    receiver_.pull_objects(remote_objects, gcs_client_.GetLocationsSync(remote_objects, true, my_address_,
+                                                                        receiver_.max_extra_senders()));
+  }
+  results->clear();
+  for (const auto &object_id : object_ids) {
+    ObjectBuffer object_buffer;
+    local_store_client_.Get(object_id, &object_buffer);
+    results->push_back(object_buffer.data);
+  }
+}
+
+void DistributedObjectStore::Gather(const std::vector<ObjectID> &object_ids, std::shared_ptr<Buffer> *result,
+                                    std::vector<int64_t> *offsets) {
+  TIMELINE(std::string("DistributedObjectStore Gather ") + std::to_string(object_ids.size()) + " objects");
+  // the objects are received into buffers of the local store, because this node serves them to
+  // other nodes afterwards. the output belongs to the caller, who may write to it or reuse it.
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  Get(object_ids, &buffers);
+  std::vector<int64_t> object_offsets;
+  int64_t total_size = 0;
+  for (const auto &buffer : buffers) {
+    object_offsets.push_back(total_size);
+    total_size += buffer->Size();
+  }
+  if (!*result || (*result)->Size() < total_size) {
+    *result = std::make_shared<Buffer>(total_size);
+  }
+  uint8_t *data = (*result)->MutableData();
+  ReduceEngine &engine = ReduceEngine::Get();
+  for (size_t i = 0; i < buffers.size(); i++) {
+    const uint8_t *src = buffers[i]->Data();
+    uint8_t *dst = data + object_offsets[i];
+    engine.ParallelFor(buffers[i]->Size(), 1,
+                       [&](int64_t begin, int64_t end) { std::memcpy(dst + begin, src + begin, end - begin); });
+  }
+  (*result)->Seal();
+  if (offsets != nullptr) {
+    *offsets = std::move(object_offsets);
+  }
+}
+
+std::shared_ptr<ObjectHandle> DistributedObjectStore::run_async(ctpl::thread_pool &pool, const ObjectID &object_id,
+                                                                std::function<std::shared_ptr<Buffer>()> call) {
+  auto handle = std::make_shared<ObjectHandle>(object_id);
+  pool.push([this, handle, call](int id) {
+    handle->Finish(call());
+    // the lock orders the notification after the check of a waiter
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    async_cv_.notify_all();
+  });
+  return handle;
+}
+
+std::shared_ptr<ObjectHandle> DistributedObjectStore::PutAsync(const std::shared_ptr<Buffer> &buffer,
+                                                               const ObjectID &object_id) {
+  return run_async(async_put_pool_, object_id, [this, buffer, object_id]() {
+    Put(buffer, object_id);
+    return buffer;
+  });
+}
+
+std::shared_ptr<ObjectHandle> DistributedObjectStore::GetAsync(const ObjectID &object_id) {
+  return run_async(async_get_pool_, object_id, [this, object_id]() {
+    std::shared_ptr<Buffer> result;
+    Get(object_id, &result);
+    return result;
+  });
+}
+
+void DistributedObjectStore::Wait(const std::vector<std::shared_ptr<ObjectHandle>> &handles) {
+  for (const auto &handle : handles) {
+    handle->Wait();
+  }
+}
+
+size_t DistributedObjectStore::WaitAny(const std::vector<std::shared_ptr<ObjectHandle>> &handles) {
+  DCHECK(!handles.empty()) << "Waiting for any of no calls.";
+  size_t index = 0;
+  std::unique_lock<std::mutex> lock(async_mutex_);
+  async_cv_.wait(lock, [&]() {
+    for (index = 0; index < handles.size(); index++) {
+      if (handles[index]->IsFinished()) {
+        return true;
+      }
+    }
+    return false;
+  });
+  return index;
+}
+
+std::unique_ptr<ObjectReader> DistributedObjectStore::OpenReader(const ObjectID &object_id,
+                                                                 std::shared_ptr<ObjectHandle> *handle) {
+  TIMELINE(std::string("DistributedObjectStore OpenReader ") + object_id.ToString());
+  std::shared_ptr<Buffer> stream;
+  std::shared_ptr<ObjectHandle> get_handle;
+  if (state_.local_reduce_task_exists(object_id)) {
+    // the reduction is written to its buffer once its first inputs arrive. the background get
+    // waits for the end of the reduction and seals it.
+    stream = state_.get_local_reduce_task(object_id)->WaitStream();
+    get_handle = GetAsync(object_id);
+    if (!stream) {
+      stream = get_handle->Wait();
+    }
+  } else if (local_store_client_.ObjectExists(object_id, false) || local_store_client_.AttachShared(object_id)) {
+    // local objects can also be partial, e.g. while they are being pulled by another call
+    stream = local_store_client_.GetBufferNoExcept(object_id);
+    get_handle = GetAsync(object_id);
+  } else {
+    SyncReply reply = gcs_client_.GetLocationSync(object_id, true, my_address_, receiver_.max_extra_senders());
+    Status s = local_store_client_.GetBufferOrCreate(object_id, reply.object_size, &stream);
+    DCHECK(s.ok()) << "Failed to create " << object_id.ToString() << ", status = " << s.ToString();
+    get_handle = run_async(async_get_pool_, object_id, [this, object_id, reply, stream]() {
+      receiver_.pull_object(object_id, reply);
+      return stream;
+    });
+  }
+  if (handle != nullptr) {
+    *handle = get_handle;
+  }
+  return std::unique_ptr<ObjectReader>(new ObjectReader(stream));
+}
+
+void DistributedObjectStore::AllReduce(const std::vector<ObjectID> &object_ids, const ObjectID &reduction_id,
+                                       std::shared_ptr<Buffer> *result, bool is_root, ReduceOp reduce_op,
+                                       ReduceDataType reduce_dtype, const WireQuantization &quantization) {
+  TIMELINE("DistributedObjectStore AllReduce");
+  DCHECK(!object_ids.empty());
+  // The reduce caller is the root of the reduce tree and holds the target stream. The directory
+  // publishes the reduction ID as soon as the top of the tree is located (not when the reduction
+  // completes), so the other participants start streaming the target stream from the root by its
+  // progress, and then from each other along the multicast chains. The root is named by the caller:
+  // any participant may hold a copy of an input, so a local object does not pick a single node.
+  if (is_root) {
+    Reduce(object_ids, reduction_id, -1, reduce_op, reduce_dtype, quantization);
+  }
+  Get(reduction_id, result);
+}
+
+void DistributedObjectStore::Pin(const ObjectID &object_id) {
+  Status s = local_store_client_.Pin(object_id);
+  DCHECK(s.ok()) << s.ToString();
+}
+
+void DistributedObjectStore::Unpin(const ObjectID &object_id) {
+  Status s = local_store_client_.Unpin(object_id);
+  DCHECK(s.ok()) << s.ToString();
+}
+
+void DistributedObjectStore::Delete(const std::vector<ObjectID> &object_ids) {
+  TIMELINE("DistributedObjectStore Delete");
+  // free our copies right away; the directory deletes the copies of the other nodes
+  for (const auto &object_id : object_ids) {
+    local_store_client_.Delete(object_id);
+  }
+  gcs_client_.DeleteObjects(object_ids);
+}
+
+void DistributedObjectStore::AddReference(const std::vector<ObjectID> &object_ids) {
+  gcs_client_.UpdateObjectReferences(object_ids, 1);
+}
+
+void DistributedObjectStore::Release(const std::vector<ObjectID> &object_ids) {
+  TIMELINE("DistributedObjectStore Release");
+  gcs_client_.UpdateObjectReferences(object_ids, -1);
+}
+
+void DistributedObjectStore::AddToGroup(int64_t group, const std::vector<ObjectID> &object_ids) {
+  gcs_client_.AddObjectsToGroup(group, object_ids);
+}
+
+void DistributedObjectStore::DeleteGroup(int64_t group) {
+  TIMELINE("DistributedObjectStore DeleteGroup");
+  gcs_client_.DeleteObjects({}, {group});
+}
+
 std::unordered_set<ObjectID> DistributedObjectStore::GetReducedObjects(const ObjectID &reduction_id) {
   return gcs_client_.GetReducedObjects(reduction_id);
 }
+
+void DistributedObjectStore::reduce_local_objects(const std::vector<ObjectID> &object_ids, Buffer *output,
+                                                  ReduceOp reduce_op, ReduceDataType reduce_dtype) {
+  const size_t element_size = ReduceDataTypeSize(reduce_dtype);
+  DCHECK(output->Size() % element_size == 0) << "Buffer size cannot be divide whole by the element size";
+  const int64_t num_elements = output->Size() / element_size;
+  const ReduceKernel reduce_kernel = GetReduceKernel(reduce_op, reduce_dtype);
+  uint8_t *target = output->MutableData();
+  ReduceEngine &engine = ReduceEngine::Get();
+  bool first = true;
+  for (const auto &object_id : object_ids) {
+    // TODO: those object_ids could also be local streams.
+    ObjectBuffer object_buffer;
+    DCHECK(local_store_client_.ObjectExists(object_id)) << "ObjectID not in local store";
+    local_store_client_.Get(object_id, &object_buffer);
+    std::shared_ptr<Buffer> buf = object_buffer.data;
+    if (!first) {
+      engine.Reduce(reduce_kernel, target, buf->Data(), num_elements, element_size);
+    } else {
+      engine.ParallelFor(output->Size(), element_size, [&](int64_t begin, int64_t end) {
+        std::memcpy(target + begin, buf->Data() + begin, end - begin);
+      });
+      first = false;
+    }
+  }
+  // TODO: try to pipeline this
+  output->Seal();
+}
@@ -1,19 +1,28 @@
 #ifndef DISTRIBUTED_OBJECT_STORE_H
 #define DISTRIBUTED_OBJECT_STORE_H
 
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 // common headers
 #include "common/buffer.h"
 #include "common/id.h"
+#include "common/reduce_kernels.h"
+#include "common/wire_quantization.h"
 // components headers
 #include "global_control_store.h"
 #include "local_store_client.h"
 #include "notification_listener.h"
+#include "object_handle.h"
+#include "object_reader.h"
 #include "object_sender.h"
 #include "object_store_state.h"
 #include "receiver.h"
+#include "util/ctpl_stl.h"
 
 class DistributedObjectStore {
 public:
@@ -25,42 +34,129 @@ public:
 
   ObjectID Put(const std::shared_ptr<Buffer> &buffer);
 
-  void Reduce(const std::vector<ObjectID> &object_ids, ObjectID *created_reduction_id, ssize_t num_reduce_objects = -1);
+  /// Put an object without copying it. The local store keeps a reference to 'buffer' and the
+  /// sender streams directly from its memory, so the caller must not modify the memory
+  /// afterwards. To publish external memory, wrap it with a Buffer that has a release
+  /// callback; the callback runs once the store and all transfers have dropped the buffer.
+  /// \param[in] buffer The finished buffer to publish.
+  /// \param[in] object_id The ID of the object.
+  void PutZeroCopy(const std::shared_ptr<Buffer> &buffer, const ObjectID &object_id);
 
-  void Reduce(const std::vector<ObjectID> &object_ids, const ObjectID &reduction_id, ssize_t num_reduce_objects = -1);
+  ObjectID PutZeroCopy(const std::shared_ptr<Buffer> &buffer);
+
+  /// Reduce objects element-wise into a new object.
+  /// \param[in] num_reduce_objects The number of objects to reduce. Negative means all of them.
+  /// \param[in] reduce_op The element-wise operation of the reduction.
+  /// \param[in] reduce_dtype The element type of the reduced objects.
+  /// \param[in] quantization How the partial results are sent between the nodes. Only float32
+  /// reductions can be quantized.
+  void Reduce(const std::vector<ObjectID> &object_ids, ObjectID *created_reduction_id, ssize_t num_reduce_objects = -1,
+              ReduceOp reduce_op = ReduceOp::SUM, ReduceDataType reduce_dtype = ReduceDataType::FLOAT32,
+              const WireQuantization &quantization = WireQuantization());
+
+  void Reduce(const std::vector<ObjectID> &object_ids, const ObjectID &reduction_id, ssize_t num_reduce_objects = -1,
+              ReduceOp reduce_op = ReduceOp::SUM, ReduceDataType reduce_dtype = ReduceDataType::FLOAT32,
+              const WireQuantization &quantization = WireQuantization());
 
   void Get(const ObjectID &object_id, std::shared_ptr<Buffer> *result);
 
+  /// Put an object in the background. The caller must not modify 'buffer' until the handle
+  /// is finished.
+  /// \return The handle of the call. It returns 'buffer' when it is finished.
+  std::shared_ptr<ObjectHandle> PutAsync(const std::shared_ptr<Buffer> &buffer, const ObjectID &object_id);
+
+  /// Get an object in the background, e.g. to overlap the transfer with computation.
+  /// \return The handle of the call. It returns the object when it is finished.
+  std::shared_ptr<ObjectHandle> GetAsync(const ObjectID &object_id);
+
+  /// Wait until all calls are finished.
+  void Wait(const std::vector<std::shared_ptr<ObjectHandle>> &handles);
+
+  /// Wait until any of the calls is finished.
+  /// \return The index of a finished call in 'handles'.
+  size_t WaitAny(const std::vector<std::shared_ptr<ObjectHandle>> &handles);
+
+  /// Read an object while it is still being received or reduced. The object is fetched in
+  /// the background like 'GetAsync'. It blocks until the object is located and its buffer
+  /// is created.
+  /// \param[in] object_id The object to read, which can also be a reduction.
+  /// \param[out] handle The handle of the background get. It can be nullptr.
+  /// \return The reader of the object.
+  std::unique_ptr<ObjectReader> OpenReader(const ObjectID &object_id, std::shared_ptr<ObjectHandle> *handle = nullptr);
+
+  /// Get objects concurrently. The locations of the remote objects are resolved with one
+  /// request to the object directory, and up to HOPLITE_MAX_INFLOW_CONCURRENCY of them are
+  /// pulled at the same time.
+  /// \param[in] object_ids The objects to get. They can repeat.
+  /// \param[out] results The objects in the order of 'object_ids'.
+  void Get(const std::vector<ObjectID> &object_ids, std::vector<std::shared_ptr<Buffer>> *results);
+
+  /// Get objects concurrently like 'Get' and copy them into one contiguous buffer, back to back
+  /// in the order of 'object_ids'.
+  /// \param[in] object_ids The objects to gather. They can repeat.
+  /// \param[in,out] result The gathered objects. A buffer passed in is filled if it is large
+  /// enough, otherwise a new buffer is allocated. It is sealed once it is filled, and the
+  /// caller can write to it and reuse it afterwards.
+  /// \param[out] offsets The offsets of the objects in 'result'. It can be nullptr.
+  void Gather(const std::vector<ObjectID> &object_ids, std::shared_ptr<Buffer> *result,
+              std::vector<int64_t> *offsets = nullptr);
+
+  /// Reduce objects element-wise and deliver the result to every participant. All participants
+  /// call it with the same arguments after putting their own objects. The root participant drives
+  /// the reduction; the others pull the result while it is still being reduced, so the broadcast is
+  /// pipelined with the reduction.
+  /// \param[in] object_ids The objects to reduce.
+  /// \param[in] reduction_id The ID of the reduced object. It must be agreed by all participants.
+  /// \param[out] result The reduced object.
+  /// \param[in] is_root Whether the caller drives the reduction. Exactly one participant is the root.
+  /// \param[in] reduce_op The element-wise operation of the reduction.
+  /// \param[in] reduce_dtype The element type of the reduced objects.
+  /// \param[in] quantization How the partial results are sent between the nodes.
+  void AllReduce(const std::vector<ObjectID> &object_ids, const ObjectID &reduction_id,
+                 std::shared_ptr<Buffer> *result, bool is_root, ReduceOp reduce_op = ReduceOp::SUM,
+                 ReduceDataType reduce_dtype = ReduceDataType::FLOAT32,
+                 const WireQuantization &quantization = WireQuantization());
+
   bool IsLocalObject(const ObjectID &object_id, int64_t *size);
 
+  /// Keep a local object resident, e.g. parameters that are read every iteration. Objects
+  /// are never evicted while they are in use anyway; pinning also keeps idle ones.
+  void Pin(const ObjectID &object_id);
+
+  void Unpin(const ObjectID &object_id);
+
+  /// Delete objects on every node and drop them from the object directory, regardless of
+  /// their references. The objects must not be read or written afterwards.
+  void Delete(const std::vector<ObjectID> &object_ids);
+
+  /// Add a reference to each object. Every object starts with one reference, which belongs
+  /// to its creator.
+  void AddReference(const std::vector<ObjectID> &object_ids);
+
+  /// Drop a reference of each object. Objects are deleted on every node once no reference
+  /// is left.
+  void Release(const std::vector<ObjectID> &object_ids);
+
+  /// Add objects to a group, e.g. the objects created in a training iteration, so that they
+  /// can be deleted together with 'DeleteGroup'.
+  void AddToGroup(int64_t group, const std::vector<ObjectID> &object_ids);
+
+  /// Delete all objects of a group on every node.
+  void DeleteGroup(int64_t group);
+
   std::unordered_set<ObjectID> GetReducedObjects(const ObjectID &reduction_id);
 
 private:
-  template <typename T> void reduce_local_objects(const std::vector<ObjectID> &object_ids, Buffer *output) {
-    DCHECK(output->Size() % sizeof(T) == 0) << "Buffer size cannot be divide whole by the element size";
-    auto num_elements = output->Size() / sizeof(T);
-    T *target = (T *)output->MutableData();
-    bool first = true;
-    // TODO: implement parallel reducing
-    for (const auto &object_id : object_ids) {
-      // TODO: those object_ids could also be local streams.
-      ObjectBuffer object_buffer;
-      DCHECK(local_store_client_.ObjectExists(object_id)) << "ObjectID not in local store";
-      local_store_client_.Get(object_id, &object_buffer);
-      std::shared_ptr<Buffer> buf = object_buffer.data;
-      const T *data_ptr = (const T *)buf->Data();
-      if (!first) {
-        for (int64_t i = 0; i < num_elements; i++)
-          target[i] += data_ptr[i];
-      } else {
-        for (int64_t i = 0; i < num_elements; i++)
-          target[i] = data_ptr[i];
-        first = false;
-      }
-    }
-    // TODO: try to pipeline this
-    output->progress = output->Size();
-  }
+  /// Get the objects that are local or can be attached from the other processes of the host,
+  /// and wait for the reductions among them. Return the objects that must be pulled.
+  std::vector<ObjectID> get_local_objects(const std::vector<ObjectID> &object_ids);
+
+  /// Run a call in the background and finish its handle with the result.
+  std::shared_ptr<ObjectHandle> run_async(ctpl::thread_pool &pool, const ObjectID &object_id,
+                                          std::function<std::shared_ptr<Buffer>()> call);
+
+  void reduce_local_objects(const std::vector<ObjectID> &object_ids, Buffer *output, ReduceOp reduce_op,
+                            ReduceDataType reduce_dtype);
 
   // order of fields should be kept for proper initialization order
   std::string my_address_;
@@ -70,6 +166,14 @@ private:
   ObjectSender object_sender_;
   Receiver receiver_;
   NotificationListener notification_listener_;
+
+  // for the asynchronous calls. they are declared last, so their threads are joined before
+  // the components that the calls use are destroyed.
+  std::mutex async_mutex_;
+  // notified whenever an asynchronous call finishes
+  std::condition_variable async_cv_;
+  ctpl::thread_pool async_get_pool_;
+  ctpl::thread_pool async_put_pool_;
 };
 
 #endif // DISTRIBUTED_OBJECT_STORE_H
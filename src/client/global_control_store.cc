@@ -5,18 +5,26 @@
 #include "global_control_store.h"
 #include "util/logging.h"
 
+using objectstore::AddObjectsToGroupReply;
+using objectstore::AddObjectsToGroupRequest;
 using objectstore::ConnectReply;
 using objectstore::ConnectRequest;
 using objectstore::CreateReduceTaskReply;
 using objectstore::CreateReduceTaskRequest;
+using objectstore::DeleteObjectsReply;
+using objectstore::DeleteObjectsRequest;
 using objectstore::GetLocationSyncReply;
 using objectstore::GetLocationSyncRequest;
+using objectstore::GetLocationsSyncReply;
+using objectstore::GetLocationsSyncRequest;
 using objectstore::GetReducedObjectsReply;
 using objectstore::GetReducedObjectsRequest;
 using objectstore::HandlePullObjectFailureReply;
 using objectstore::HandlePullObjectFailureRequest;
 using objectstore::HandleReceiveReducedObjectFailureReply;
 using objectstore::HandleReceiveReducedObjectFailureRequest;
+using objectstore::UpdateObjectReferencesReply;
+using objectstore::UpdateObjectReferencesRequest;
 using objectstore::WriteLocationReply;
 using objectstore::WriteLocationRequest;
 
@@ -37,13 +45,14 @@ GlobalControlStoreClient::GlobalControlStoreClient(const std::string &notificati
   LOG(DEBUG) << "notification_stub_ created";
 }
 
-void GlobalControlStoreClient::ConnectNotificationServer() {
+std::vector<std::string> GlobalControlStoreClient::ConnectNotificationServer() {
   grpc::ClientContext context;
   ConnectRequest request;
   request.set_sender_ip(my_address_);
   ConnectReply reply;
   auto status = notification_stub_->Connect(&context, request, &reply);
   DCHECK(status.ok()) << status.error_message();
+  return std::vector<std::string>(reply.peer_ips().begin(), reply.peer_ips().end());
 }
 
 void GlobalControlStoreClient::WriteLocation(const ObjectID &object_id, const std::string &sender_ip, bool finished,
@@ -85,7 +94,7 @@ void GlobalControlStoreClient::WriteLocation(const ObjectID &object_id, const st
 }
 
 SyncReply GlobalControlStoreClient::GetLocationSync(const ObjectID &object_id, bool occupying,
-                                                    const std::string &receiver_ip) {
+                                                    const std::string &receiver_ip, int max_extra_senders) {
   TIMELINE("GetLocationSync");
   grpc::ClientContext context;
   GetLocationSyncRequest request;
@@ -93,10 +102,38 @@ SyncReply GlobalControlStoreClient::GetLocationSync(const ObjectID &object_id, b
   request.set_object_id(object_id.Binary());
   request.set_occupying(occupying);
   request.set_receiver_ip(receiver_ip);
+  request.set_max_extra_senders(max_extra_senders);
   auto status = notification_stub_->GetLocationSync(&context, request, &reply);
   DCHECK(status.ok()) << "GetLocationSync for " << object_id.ToString() << " failed. "
                       << "Error message: " << status.error_message();
-  return {std::string(reply.sender_ip()), reply.object_size(), reply.inband_data()};
+  return {std::string(reply.sender_ip()), reply.object_size(), reply.inband_data(),
+          std::vector<std::string>(reply.extra_sender_ips().begin(), reply.extra_sender_ips().end())};
+}
+
+std::vector<SyncReply> GlobalControlStoreClient::GetLocationsSync(const std::vector<ObjectID> &object_ids,
+                                                                 bool occupying, const std::string &receiver_ip,
+                                                                 int max_extra_senders) {
+  TIMELINE("GetLocationsSync");
+  grpc::ClientContext context;
+  GetLocationsSyncRequest request;
+  GetLocationsSyncReply reply;
+  for (const auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  request.set_occupying(occupying);
+  request.set_receiver_ip(receiver_ip);
+  request.set_max_extra_senders(max_extra_senders);
+  auto status = notification_stub_->GetLocationsSync(&context, request, &reply);
+  DCHECK(status.ok()) << "GetLocationsSync for " << object_ids.size() << " objects failed. "
+                      << "Error message: " << status.error_message();
+  DCHECK(reply.locations_size() == object_ids.size()) << "GetLocationsSync returns a wrong number of locations.";
+  std::vector<SyncReply> locations;
+  for (const auto &location : reply.locations()) {
+    locations.push_back(
+        {std::string(location.sender_ip()), location.object_size(), location.inband_data(),
+         std::vector<std::string>(location.extra_sender_ips().begin(), location.extra_sender_ips().end())});
+  }
+  return locations;
 }
 
 bool GlobalControlStoreClient::HandlePullObjectFailure(const ObjectID &object_id, const std::string &receiver_ip,
@@ -130,7 +167,9 @@ void GlobalControlStoreClient::HandleReceiveReducedObjectFailure(const ObjectID
 }
 
 void GlobalControlStoreClient::CreateReduceTask(const std::vector<ObjectID> &objects_to_reduce,
-                                                const ObjectID &reduction_id, int num_reduce_objects) {
+                                                const ObjectID &reduction_id, int num_reduce_objects,
+                                                ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                                                const WireQuantization &quantization) {
   TIMELINE("CreateReduceTask");
   grpc::ClientContext context;
   CreateReduceTaskRequest request;
@@ -138,11 +177,16 @@ void GlobalControlStoreClient::CreateReduceTask(const std::vector<ObjectID> &obj
   request.set_reduce_dst(my_address_);
   request.set_reduction_id(reduction_id.Binary());
   request.set_num_reduce_objects(num_reduce_objects);
+  request.set_reduce_op(static_cast<objectstore::ReduceOp>(reduce_op));
+  request.set_reduce_dtype(static_cast<objectstore::ReduceDataType>(reduce_dtype));
+  request.mutable_quantization()->set_format(static_cast<objectstore::WireFormat>(quantization.format));
+  request.mutable_quantization()->set_error_feedback_id(quantization.error_feedback_id);
   for (auto &object_id : objects_to_reduce) {
     request.add_objects_to_reduce(object_id.Binary());
   }
   auto status = notification_stub_->CreateReduceTask(&context, request, &reply);
   DCHECK(status.ok()) << status.error_message();
+  DCHECK(reply.created()) << reduction_id.ToString() << " is already being reduced by another node.";
 }
 
 std::unordered_set<ObjectID> GlobalControlStoreClient::GetReducedObjects(const ObjectID &reduction_id) {
@@ -159,3 +203,45 @@ std::unordered_set<ObjectID> GlobalControlStoreClient::GetReducedObjects(const O
   }
   return reduced_objects;
 }
+
+void GlobalControlStoreClient::UpdateObjectReferences(const std::vector<ObjectID> &object_ids, int delta) {
+  TIMELINE("GlobalControlStoreClient::UpdateObjectReferences");
+  grpc::ClientContext context;
+  UpdateObjectReferencesRequest request;
+  UpdateObjectReferencesReply reply;
+  for (auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  request.set_delta(delta);
+  auto status = notification_stub_->UpdateObjectReferences(&context, request, &reply);
+  DCHECK(status.ok()) << status.error_message();
+}
+
+void GlobalControlStoreClient::AddObjectsToGroup(int64_t group, const std::vector<ObjectID> &object_ids) {
+  TIMELINE("GlobalControlStoreClient::AddObjectsToGroup");
+  grpc::ClientContext context;
+  AddObjectsToGroupRequest request;
+  AddObjectsToGroupReply reply;
+  request.set_group(group);
+  for (auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  auto status = notification_stub_->AddObjectsToGroup(&context, request, &reply);
+  DCHECK(status.ok()) << status.error_message();
+}
+
+void GlobalControlStoreClient::DeleteObjects(const std::vector<ObjectID> &object_ids,
+                                             const std::vector<int64_t> &groups) {
+  TIMELINE("GlobalControlStoreClient::DeleteObjects");
+  grpc::ClientContext context;
+  DeleteObjectsRequest request;
+  DeleteObjectsReply reply;
+  for (auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  for (int64_t group : groups) {
+    request.add_groups(group);
+  }
+  auto status = notification_stub_->DeleteObjects(&context, request, &reply);
+  DCHECK(status.ok()) << status.error_message();
+}
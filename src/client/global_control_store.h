@@ -2,6 +2,8 @@
 #define GLOBAL_CONTROL_STORE_H
 
 #include "common/id.h"
+#include "common/reduce_kernels.h"
+#include "common/wire_quantization.h"
 #include "object_store.grpc.pb.h"
 #include "util/ctpl_stl.h"
 #include <condition_variable>
@@ -20,6 +22,8 @@ struct SyncReply {
   std::string sender_ip;
   size_t object_size;
   std::string inband_data;
+  // other nodes that hold the complete object
+  std::vector<std::string> extra_sender_ips;
 };
 
 class GlobalControlStoreClient {
@@ -27,14 +31,24 @@ public:
   GlobalControlStoreClient(const std::string &notification_server_address, const std::string &my_address,
                            int notification_server_port);
 
-  void ConnectNotificationServer();
+  /// Connect to the notification server.
+  /// \return The addresses of the nodes that connected before us.
+  std::vector<std::string> ConnectNotificationServer();
 
   // Write object location to the notification server.
   void WriteLocation(const ObjectID &object_id, const std::string &my_address, bool finished, size_t object_size,
                      const uint8_t *inband_data = nullptr, bool blocking = false);
 
   // Get object location from the notification server.
-  SyncReply GetLocationSync(const ObjectID &object_id, bool occupying, const std::string &receiver_ip);
+  /// \param max_extra_senders The maximum number of other complete holders to return besides
+  /// the sender, to pull disjoint ranges from all of them.
+  SyncReply GetLocationSync(const ObjectID &object_id, bool occupying, const std::string &receiver_ip,
+                            int max_extra_senders = 0);
+
+  /// Get the locations of objects with one request. It returns after all of them are located.
+  /// \return The locations in the order of 'object_ids'.
+  std::vector<SyncReply> GetLocationsSync(const std::vector<ObjectID> &object_ids, bool occupying,
+                                          const std::string &receiver_ip, int max_extra_senders = 0);
 
   bool HandlePullObjectFailure(const ObjectID &object_id, const std::string &receiver_ip,
                                std::string *alternative_sender_ip);
@@ -44,14 +58,34 @@ public:
 
   /// Create reduce task
   /// \param reduce_dst The IP address of the node that holds the final reduced object.
+  /// \param reduce_op The element-wise operation of the reduction.
+  /// \param reduce_dtype The element type of the reduced objects.
+  /// \param quantization How the partial results are sent between the nodes.
   void CreateReduceTask(const std::vector<ObjectID> &objects_to_reduce, const ObjectID &reduction_id,
-                        int num_reduce_objects);
+                        int num_reduce_objects, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                        const WireQuantization &quantization);
 
   /// Get the IDs of objects reduced for a reduction ID.
   /// \param[in] reduction_id The reduction ID represents the reduce event.
   /// \return A set of reduced object IDs
   std::unordered_set<ObjectID> GetReducedObjects(const ObjectID &reduction_id);
 
+  /// Add references to objects, or drop them with a negative delta. Every object starts with
+  /// one reference, and it is deleted on every node once no reference is left.
+  /// \param[in] object_ids The objects.
+  /// \param[in] delta The number of references to add.
+  void UpdateObjectReferences(const std::vector<ObjectID> &object_ids, int delta);
+
+  /// Add objects to a group (e.g. the objects of a training iteration) to delete them together.
+  /// \param[in] group The group. An object belongs to at most one group.
+  /// \param[in] object_ids The objects.
+  void AddObjectsToGroup(int64_t group, const std::vector<ObjectID> &object_ids);
+
+  /// Delete objects on every node and forget them in the object directory.
+  /// \param[in] object_ids The objects to delete.
+  /// \param[in] groups The groups whose objects are also deleted.
+  void DeleteObjects(const std::vector<ObjectID> &object_ids, const std::vector<int64_t> &groups = {});
+
 private:
   const std::string &notification_server_address_;
   const std::string &my_address_;
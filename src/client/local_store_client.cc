@@ -1,100 +1,376 @@
 #include "local_store_client.h"
+#include "common/config.h"
 #include "util/logging.h"
 
-LocalStoreClient::LocalStoreClient() : total_store_size_(0) {
-  // std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
+namespace {
+
+std::string get_string_config_from_env(const char *name) {
+  const char *value = std::getenv(name);
+  return value != nullptr ? value : "";
+}
+
+} // namespace
+
+LocalStoreClient::LocalStoreClient()
+    : LocalStoreClient(get_config_from_env("HOPLITE_LOCAL_STORE_CAPACITY", HOPLITE_LOCAL_STORE_CAPACITY),
+                       HOPLITE_LOCAL_STORE_SHARDS, get_string_config_from_env("HOPLITE_SPILL_DIRECTORY"),
+                       get_string_config_from_env("HOPLITE_SHARED_STORE_NAME")) {}
+
+LocalStoreClient::LocalStoreClient(int64_t capacity, int n_shards, const std::string &spill_directory,
+                                   const std::string &shared_store_name)
+    : total_store_size_(0), capacity_(capacity) {
+  DCHECK(n_shards > 0) << "The local store needs at least one shard.";
+  for (int i = 0; i < n_shards; i++) {
+    shards_.emplace_back(new Shard());
+  }
+  if (!spill_directory.empty()) {
+    spill_store_.reset(new SpillStore(
+        spill_directory, [this](const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer,
+                                const std::string &path) { on_spilled(object_id, buffer, path); }));
+  }
+  if (!shared_store_name.empty()) {
+    shared_store_ = SharedObjectStore::Open(shared_store_name, HOPLITE_SHARED_OBJECT_SLOTS);
+    DCHECK(shared_store_) << "Cannot open the shared store " << shared_store_name;
+  }
   // if (use_plasma) {
   //   plasma_client_.Connect(plasma_socket, "");
   // }
 }
 
-Status LocalStoreClient::create_internal(const ObjectID &object_id, int64_t data_size, std::shared_ptr<Buffer> *data) {
-  buffers_[object_id] = std::make_shared<Buffer>(data_size);
-  *data = buffers_[object_id];
-  total_store_size_ += data_size;
-  lru_queue_.push(object_id);
-  while (total_store_size_ > lru_bound_size_) {
-    ObjectID front_id = lru_queue_.front();
-    lru_queue_.pop();
-    std::shared_ptr<Buffer> buffer_ptr = buffers_[front_id];
-    buffers_.erase(front_id);
-    total_store_size_ -= buffer_ptr->Size();
-    buffer_ptr->ShrinkForLRU();
+LocalStoreClient::~LocalStoreClient() {
+  if (spill_store_) {
+    // the spill thread updates the shards, so stop it first
+    spill_store_->Shutdown();
+    for (auto &shard : shards_) {
+      for (auto &p : shard->buffers) {
+        if (!p.second.spill_path.empty()) {
+          spill_store_->Remove(p.second.spill_path);
+        }
+      }
+    }
   }
+}
+
+Status LocalStoreClient::create_internal(Shard &shard, const ObjectID &object_id, int64_t data_size,
+                                         std::shared_ptr<Buffer> *data) {
+  std::shared_ptr<Buffer> buffer;
+  if (shared_store_ && data_size >= HOPLITE_SHARED_OBJECT_MIN_SIZE) {
+    buffer = shared_store_->Create(data_size);
+  }
+  if (!buffer) {
+    buffer = std::make_shared<Buffer>(data_size);
+  }
+  insert_internal(shard, object_id, buffer);
+  *data = std::move(buffer);
   return Status::OK();
 }
 
+void LocalStoreClient::insert_internal(Shard &shard, const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer) {
+  auto search = shard.buffers.find(object_id);
+  if (search != shard.buffers.end()) {
+    // replace the old object, including its spill file
+    delete_unsafe(shard, search);
+  }
+  ObjectEntry &entry = shard.buffers[object_id];
+  entry.buffer = buffer;
+  entry.size = buffer->Size();
+  shard.lru_list.push_front(object_id);
+  entry.lru_position = shard.lru_list.begin();
+  shard.size += entry.size;
+  total_store_size_ += entry.size;
+}
+
+bool LocalStoreClient::attach_unsafe(Shard &shard, const ObjectID &object_id) {
+  if (!shared_store_) {
+    return false;
+  }
+  std::shared_ptr<Buffer> buffer = shared_store_->Attach(object_id);
+  if (!buffer) {
+    return false;
+  }
+  LOG(DEBUG) << "Attached " << object_id.ToString() << " from the shared store, size = " << buffer->Size();
+  insert_internal(shard, object_id, buffer);
+  shard.buffers[object_id].attached = true;
+  return true;
+}
+
+void LocalStoreClient::delete_unsafe(Shard &shard, std::unordered_map<ObjectID, ObjectEntry>::iterator search) {
+  ObjectEntry &entry = search->second;
+  if (entry.resident) {
+    shard.size -= entry.size;
+    total_store_size_ -= entry.size;
+    shard.lru_list.erase(entry.lru_position);
+  }
+  // an object being spilled has no file yet; 'on_spilled' removes it
+  if (!entry.spill_path.empty()) {
+    spill_store_->Remove(entry.spill_path);
+  }
+  shard.buffers.erase(search);
+}
+
+void LocalStoreClient::evict_unsafe(Shard &shard) {
+  auto it = shard.lru_list.end();
+  while (total_store_size_ > capacity_ && it != shard.lru_list.begin()) {
+    --it;
+    auto search = shard.buffers.find(*it);
+    ObjectEntry &entry = search->second;
+    // the store (and the spill thread) hold the only references to an unpinned object
+    if (entry.pin_count > 0 || entry.buffer.use_count() > (entry.spilling ? 2 : 1)) {
+      continue;
+    }
+    LOG(DEBUG) << "Evict " << it->ToString() << " from the local store, size = " << entry.size;
+    shard.size -= entry.size;
+    total_store_size_ -= entry.size;
+    it = shard.lru_list.erase(it);
+    if (spill_store_ && entry.buffer->IsFinished() && !entry.attached) {
+      entry.resident = false;
+      if (entry.spill_path.empty()) {
+        // keep the buffer until it is written, so the object can still be read meanwhile. it may
+        // have been restored and evicted again before it was written.
+        if (!entry.spilling) {
+          entry.spilling = true;
+          spill_store_->SpillAsync(search->first, entry.buffer);
+        }
+      } else {
+        entry.buffer.reset();
+      }
+    } else {
+      shard.buffers.erase(search);
+    }
+  }
+}
+
+void LocalStoreClient::on_spilled(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer,
+                                  const std::string &path) {
+  Shard &shard = shard_of(object_id);
+  std::lock_guard<std::mutex> lock_guard(shard.mutex);
+  auto search = shard.buffers.find(object_id);
+  if (search == shard.buffers.end() || search->second.buffer != buffer) {
+    // the object was deleted or replaced while it was being written
+    if (!path.empty()) {
+      spill_store_->Remove(path);
+    }
+    return;
+  }
+  ObjectEntry &entry = search->second;
+  entry.spilling = false;
+  if (path.empty()) {
+    if (!entry.resident) {
+      LOG(WARNING) << "Dropping " << object_id.ToString() << " because it cannot be spilled.";
+      shard.buffers.erase(search);
+    }
+    return;
+  }
+  entry.spill_path = path;
+  // the object may have been used again while it was being written
+  if (!entry.resident) {
+    entry.buffer.reset();
+  }
+}
+
+void LocalStoreClient::evict(const ObjectID &object_id) {
+  if (total_store_size_ <= capacity_) {
+    return;
+  }
+  const size_t first = shard_index(object_id);
+  for (size_t i = 0; i < shards_.size() && total_store_size_ > capacity_; i++) {
+    Shard &shard = *shards_[(first + i) % shards_.size()];
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    evict_unsafe(shard);
+  }
+  if (total_store_size_ > capacity_) {
+    LOG(DEBUG) << "The local store exceeds its capacity because all objects are in use (size = "
+               << total_store_size_ << ", capacity = " << capacity_ << ").";
+  }
+}
+
+std::shared_ptr<Buffer> LocalStoreClient::touch_unsafe(Shard &shard, const ObjectID &object_id) {
+  auto search = shard.buffers.find(object_id);
+  if (search == shard.buffers.end()) {
+    return nullptr;
+  }
+  ObjectEntry &entry = search->second;
+  if (entry.resident) {
+    shard.lru_list.splice(shard.lru_list.begin(), shard.lru_list, entry.lru_position);
+    return entry.buffer;
+  }
+  if (!entry.buffer) {
+    entry.buffer = spill_store_->Restore(entry.spill_path, entry.size);
+    if (!entry.buffer) {
+      LOG(ERROR) << "Cannot restore " << object_id.ToString() << " from " << entry.spill_path;
+      delete_unsafe(shard, search);
+      return nullptr;
+    }
+    LOG(DEBUG) << "Restored " << object_id.ToString() << " from " << entry.spill_path;
+  }
+  entry.resident = true;
+  shard.lru_list.push_front(object_id);
+  entry.lru_position = shard.lru_list.begin();
+  shard.size += entry.size;
+  total_store_size_ += entry.size;
+  return entry.buffer;
+}
+
 Status LocalStoreClient::Create(const ObjectID &object_id, int64_t data_size, std::shared_ptr<Buffer> *data) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
-  return create_internal(object_id, data_size, data);
+  Shard &shard = shard_of(object_id);
+  Status status;
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    status = create_internal(shard, object_id, data_size, data);
+  }
+  evict(object_id);
+  return status;
 }
 
 Status LocalStoreClient::Seal(const ObjectID &object_id) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
+  Shard &shard = shard_of(object_id);
+  std::lock_guard<std::mutex> lock_guard(shard.mutex);
   // if (use_plasma_) {
   //   return plasma_client_.Seal(object_id);
   // }
 
-  auto search = buffers_.find(object_id);
-  DCHECK(search != buffers_.end()) << "Sealing an object that does not exist.";
-  if (!search->second->IsFinished()) {
+  auto search = shard.buffers.find(object_id);
+  DCHECK(search != shard.buffers.end()) << "Sealing an object that does not exist.";
+  if (!search->second.buffer) {
+    // spilled objects are finished
+    return Status::OK();
+  }
+  if (!search->second.buffer->IsFinished()) {
     // TODO: See GitHub Issue #153. Disable it now.
     LOG(DEBUG) << "Sealing an unfinished buffer.";
   }
-  search->second->Seal();
+  search->second.buffer->Seal();
+  if (shared_store_) {
+    shared_store_->Publish(object_id, search->second.buffer);
+  }
+  return Status::OK();
+}
+
+Status LocalStoreClient::Adopt(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer) {
+  DCHECK(buffer->IsFinished()) << "Adopting an unfinished buffer.";
+  Shard &shard = shard_of(object_id);
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    DCHECK(!shard.buffers.count(object_id)) << "Adopting a buffer as an existing object " << object_id.ToString();
+    insert_internal(shard, object_id, buffer);
+  }
+  evict(object_id);
   return Status::OK();
 }
 
 bool LocalStoreClient::ObjectExists(const ObjectID &object_id, bool require_finished) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
-  return object_exists_unsafe(object_id, require_finished);
+  Shard &shard = shard_of(object_id);
+  std::lock_guard<std::mutex> lock_guard(shard.mutex);
+  return object_exists_unsafe(shard, object_id, require_finished);
+}
+
+bool LocalStoreClient::AttachShared(const ObjectID &object_id) {
+  Shard &shard = shard_of(object_id);
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    if (shard.buffers.count(object_id)) {
+      return false;
+    }
+    if (!attach_unsafe(shard, object_id)) {
+      return false;
+    }
+  }
+  evict(object_id);
+  return true;
 }
 
 Status LocalStoreClient::Get(const std::vector<ObjectID> &object_ids, std::vector<ObjectBuffer> *object_buffers) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
   // if (use_plasma_) {
   //   return plasma_client_.Get(object_ids, -1, object_buffers);
   // }
 
   for (auto &object_id : object_ids) {
     ObjectBuffer buf;
-    buf.data = buffers_[object_id];
-    buf.metadata = nullptr;
-    buf.device_num = 0;
+    Get(object_id, &buf);
     object_buffers->push_back(buf);
   }
   return Status::OK();
 }
 
 Status LocalStoreClient::Get(const ObjectID &object_id, ObjectBuffer *object_buffer) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
-  object_buffer->data = buffers_[object_id];
-  object_buffer->metadata = nullptr;
-  object_buffer->device_num = 0;
+  Shard &shard = shard_of(object_id);
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    object_buffer->data = touch_unsafe(shard, object_id);
+    object_buffer->metadata = nullptr;
+    object_buffer->device_num = 0;
+  }
+  // restoring a spilled object may exceed the capacity
+  evict(object_id);
   return Status::OK();
 }
 
 std::shared_ptr<Buffer> LocalStoreClient::GetBufferNoExcept(const ObjectID &object_id) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
-  DCHECK(object_exists_unsafe(object_id, false));
-  return buffers_[object_id];
+  Shard &shard = shard_of(object_id);
+  std::shared_ptr<Buffer> buffer;
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    DCHECK(object_exists_unsafe(shard, object_id, false));
+    buffer = touch_unsafe(shard, object_id);
+  }
+  evict(object_id);
+  return buffer;
 }
 
 Status LocalStoreClient::GetBufferOrCreate(const ObjectID &object_id, int64_t size, std::shared_ptr<Buffer> *data) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
-  if (!buffers_.count(object_id)) {
-    return create_internal(object_id, size, data);
+  Shard &shard = shard_of(object_id);
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    *data = touch_unsafe(shard, object_id);
+    if (!*data) {
+      create_internal(shard, object_id, size, data);
+    }
   }
-  DCHECK(object_exists_unsafe(object_id, false));
-  *data = buffers_[object_id];
+  evict(object_id);
   return Status::OK();
 }
 
 Status LocalStoreClient::Delete(const ObjectID &object_id) {
-  std::lock_guard<std::mutex> lock_guard(local_store_mutex_);
   // if (use_plasma_) {
   //   return plasma_client_.Delete(object_id);
   // }
+  if (shared_store_) {
+    // the other processes of the host must not attach it anymore
+    shared_store_->Remove(object_id);
+  }
+  Shard &shard = shard_of(object_id);
+  std::lock_guard<std::mutex> lock_guard(shard.mutex);
+  auto search = shard.buffers.find(object_id);
+  if (search == shard.buffers.end()) {
+    return Status::KeyError("Deleting an object that does not exist: " + object_id.ToString());
+  }
+  // on-going transfers keep their own references, so the memory is freed once they finish
+  delete_unsafe(shard, search);
+  return Status::OK();
+}
+
+Status LocalStoreClient::Pin(const ObjectID &object_id) {
+  Shard &shard = shard_of(object_id);
+  std::lock_guard<std::mutex> lock_guard(shard.mutex);
+  auto search = shard.buffers.find(object_id);
+  if (search == shard.buffers.end()) {
+    return Status::KeyError("Pinning an object that does not exist: " + object_id.ToString());
+  }
+  search->second.pin_count++;
+  return Status::OK();
+}
+
+Status LocalStoreClient::Unpin(const ObjectID &object_id) {
+  Shard &shard = shard_of(object_id);
+  {
+    std::lock_guard<std::mutex> lock_guard(shard.mutex);
+    auto search = shard.buffers.find(object_id);
+    if (search == shard.buffers.end() || search->second.pin_count <= 0) {
+      return Status::Invalid("Unpinning an object that is not pinned: " + object_id.ToString());
+    }
+    search->second.pin_count--;
+  }
+  evict(object_id);
   return Status::OK();
 }
 
@@ -105,7 +381,9 @@ Status LocalStoreClient::Wait(const ObjectID &object_id) {
   return Status::OK();
 }
 
-bool LocalStoreClient::object_exists_unsafe(const ObjectID &object_id, bool require_finished) {
-  auto search = buffers_.find(object_id);
-  return search != buffers_.end() && (!require_finished || search->second->IsFinished());
+bool LocalStoreClient::object_exists_unsafe(Shard &shard, const ObjectID &object_id, bool require_finished) {
+  auto search = shard.buffers.find(object_id);
+  // spilled objects are finished
+  return search != shard.buffers.end() &&
+         (!require_finished || !search->second.buffer || search->second.buffer->IsFinished());
 }
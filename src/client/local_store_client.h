@@ -2,24 +2,71 @@
 #define LOCAL_STORE_H
 
 #include "common/buffer.h"
+#include "common/config.h"
 #include "common/id.h"
 #include "common/status.h"
+#include "shared_object_store.h"
+#include "spill_store.h"
+#include <atomic>
+#include <list>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
+/// The objects of this node. When the total size exceeds the capacity, the least recently
+/// used objects are evicted. Objects are never evicted while they are pinned, or while
+/// anybody else (e.g. a sender, a receiver or a reduce task) holds a reference to their
+/// buffers, so eviction never invalidates memory in use.
+///
+/// The object table is sharded by object ID, and each shard has its own lock, LRU order and
+/// size accounting, so that threads working on different objects do not contend. The LRU
+/// order is therefore per shard; shards are visited in turn when evicting.
+///
+/// With a spill directory, evicted objects are written to disk in the background instead of
+/// being dropped, and are mapped back from their files when they are used again. Spilled
+/// objects still exist for the sender and for 'Get'.
+///
+/// With a shared store name, large objects are created in shared memory and published to the
+/// other processes of the host with the same name once they are sealed. Objects that are not
+/// in the store can be attached from there with 'AttachShared' before they are pulled, so an
+/// object crosses the network once per host.
 class LocalStoreClient {
 public:
+  /// The capacity, the spill directory and the shared store name are read from the
+  /// environment variables HOPLITE_LOCAL_STORE_CAPACITY, HOPLITE_SPILL_DIRECTORY and
+  /// HOPLITE_SHARED_STORE_NAME.
   LocalStoreClient();
 
+  /// \param capacity The total size of objects in memory above which objects are evicted.
+  /// \param n_shards The number of shards of the object table.
+  /// \param spill_directory The directory to spill evicted objects to. Evicted objects are
+  /// dropped if it is empty.
+  /// \param shared_store_name The name of the objects shared by the processes of the host.
+  /// Objects are private to the process if it is empty.
+  explicit LocalStoreClient(int64_t capacity, int n_shards = HOPLITE_LOCAL_STORE_SHARDS,
+                            const std::string &spill_directory = "", const std::string &shared_store_name = "");
+
+  ~LocalStoreClient();
+
   Status Create(const ObjectID &object_id, int64_t data_size, std::shared_ptr<Buffer> *data);
 
   Status Seal(const ObjectID &object_id);
 
+  /// Register a finished buffer as an object without copying it. The store keeps a
+  /// reference to the buffer, which pins its memory until the object is evicted.
+  Status Adopt(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer);
+
   // Check if an object exists in the store.
   // We assume this function will never fail.
   bool ObjectExists(const ObjectID &object_id, bool require_finished = true);
 
+  /// Map an object that another process of the host has shared, without copying it.
+  /// \return True if the object was attached. It returns false if the object is already in
+  /// the store, or if it is not shared.
+  bool AttachShared(const ObjectID &object_id);
+
   Status Get(const std::vector<ObjectID> &object_ids, std::vector<ObjectBuffer> *object_buffers);
 
   // Get single object from the store.
@@ -29,18 +76,72 @@ public:
 
   Status GetBufferOrCreate(const ObjectID &object_id, int64_t size, std::shared_ptr<Buffer> *data);
 
+  /// Remove an object from the store, even if it is pinned. Holders of its buffer keep the
+  /// memory alive until they drop it.
   Status Delete(const ObjectID &object_id);
 
+  /// Keep an object resident until it is unpinned as many times as it was pinned.
+  Status Pin(const ObjectID &object_id);
+
+  Status Unpin(const ObjectID &object_id);
+
   Status Wait(const ObjectID &object_id);
 
+  /// The total size of the objects in memory.
+  int64_t TotalSize() const { return total_store_size_; }
+
 private:
-  Status create_internal(const ObjectID &object_id, int64_t data_size, std::shared_ptr<Buffer> *data);
-  bool object_exists_unsafe(const ObjectID &object_id, bool require_finished);
-  std::mutex local_store_mutex_;
-  std::unordered_map<ObjectID, std::shared_ptr<Buffer>> buffers_;
-  size_t total_store_size_;
-  const size_t lru_bound_size_ = (16LL << 30);
-  std::queue<ObjectID> lru_queue_;
+  struct ObjectEntry {
+    // nullptr after the object is spilled
+    std::shared_ptr<Buffer> buffer;
+    int64_t size = 0;
+    // resident objects are counted in the size of the store and are in the LRU list.
+    // objects that are not resident are being spilled or have been spilled.
+    bool resident = true;
+    // the spill thread holds a reference to the buffer until it has written the file
+    bool spilling = false;
+    // the position in the LRU list of the shard
+    std::list<ObjectID>::iterator lru_position;
+    int pin_count = 0;
+    // mapped from the shared store of another process, so it is dropped instead of spilled
+    bool attached = false;
+    // the file of the object once it has been spilled. buffers are immutable after they are
+    // finished, so the file stays valid when the object is restored.
+    std::string spill_path;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<ObjectID, ObjectEntry> buffers;
+    // from the most recently used object to the least recently used one
+    std::list<ObjectID> lru_list;
+    int64_t size = 0;
+  };
+
+  size_t shard_index(const ObjectID &object_id) const { return object_id.Hash() % shards_.size(); }
+  Shard &shard_of(const ObjectID &object_id) { return *shards_[shard_index(object_id)]; }
+  Status create_internal(Shard &shard, const ObjectID &object_id, int64_t data_size, std::shared_ptr<Buffer> *data);
+  void insert_internal(Shard &shard, const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer);
+  bool object_exists_unsafe(Shard &shard, const ObjectID &object_id, bool require_finished);
+  /// Return the buffer of an object and mark it as the most recently used one. Spilled objects
+  /// are restored. It returns nullptr if the object does not exist.
+  std::shared_ptr<Buffer> touch_unsafe(Shard &shard, const ObjectID &object_id);
+  /// Insert an object shared by another process of the host into the shard. It returns
+  /// false if the object is not shared.
+  bool attach_unsafe(Shard &shard, const ObjectID &object_id);
+  void delete_unsafe(Shard &shard, std::unordered_map<ObjectID, ObjectEntry>::iterator search);
+  /// Called by the spill thread after the buffer of an object is written to 'path'.
+  void on_spilled(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer, const std::string &path);
+  /// Evict objects of the shard that are not in use until the store fits in its capacity.
+  void evict_unsafe(Shard &shard);
+  /// Evict objects from all shards, starting from the shard of 'object_id'. It must be
+  /// called without holding the lock of any shard.
+  void evict(const ObjectID &object_id);
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<int64_t> total_store_size_;
+  const int64_t capacity_;
+  std::unique_ptr<SpillStore> spill_store_;
+  std::shared_ptr<SharedObjectStore> shared_store_;
 };
 
 #endif // LOCAL_STORE_H
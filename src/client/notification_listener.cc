@@ -9,6 +9,8 @@
 
 using objectstore::ConnectListenerReply;
 using objectstore::ConnectListenerRequest;
+using objectstore::DeleteLocalObjectsReply;
+using objectstore::DeleteLocalObjectsRequest;
 using objectstore::PullAndReduceObjectReply;
 using objectstore::PullAndReduceObjectRequest;
 using objectstore::ReduceInbandObjectReply;
@@ -42,7 +44,12 @@ public:
     }
     receiver_.receive_and_reduce_object(reduction_id, request->is_tree_branch(), request->sender_ip(),
                                         request->from_left_child(), request->object_size(), object_id_to_reduce,
-                                        object_id_to_pull, request->is_sender_leaf(), request->reset_progress(), task);
+                                        object_id_to_pull, request->is_sender_leaf(), request->reset_progress(),
+                                        static_cast<ReduceOp>(request->reduce_op()),
+                                        static_cast<ReduceDataType>(request->reduce_dtype()),
+                                        {static_cast<WireFormat>(request->quantization().format()),
+                                         request->quantization().error_feedback_id()},
+                                        task);
     return grpc::Status::OK;
   }
 
@@ -54,10 +61,21 @@ public:
     std::shared_ptr<Buffer> buffer;
     local_store_client_.GetBufferOrCreate(reduction_id, request->inband_data().size(), &buffer);
     buffer->CopyFrom(request->inband_data());
+    task->SetStream(buffer);
     task->NotifyFinished();
     return grpc::Status::OK;
   }
 
+  grpc::Status DeleteLocalObjects(grpc::ServerContext *context, const DeleteLocalObjectsRequest *request,
+                                  DeleteLocalObjectsReply *reply) override {
+    TIMELINE("DeleteLocalObjects");
+    for (const auto &object_id_str : request->object_ids()) {
+      // the directory notifies every node, including those that do not hold the object
+      (void)local_store_client_.Delete(ObjectID::FromBinary(object_id_str));
+    }
+    return grpc::Status::OK;
+  }
+
 private:
   ObjectStoreState &state_;
   Receiver &receiver_;
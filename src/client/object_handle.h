@@ -0,0 +1,44 @@
+#ifndef OBJECT_HANDLE_H
+#define OBJECT_HANDLE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "common/buffer.h"
+#include "common/id.h"
+
+/// The completion of an asynchronous 'GetAsync' or 'PutAsync' call.
+class ObjectHandle {
+public:
+  explicit ObjectHandle(const ObjectID &object_id) : object_id_(object_id), is_finished_(false) {}
+
+  const ObjectID &object_id() const { return object_id_; }
+
+  bool IsFinished() const { return is_finished_; }
+
+  /// Wait until the call is finished.
+  /// \return The object for gets, and the buffer that was put for puts.
+  std::shared_ptr<Buffer> Wait() {
+    std::unique_lock<std::mutex> l(mutex_);
+    cv_.wait(l, [this]() { return is_finished_.load(); });
+    return buffer_;
+  }
+
+  void Finish(const std::shared_ptr<Buffer> &buffer) {
+    std::unique_lock<std::mutex> l(mutex_);
+    buffer_ = buffer;
+    is_finished_ = true;
+    cv_.notify_all();
+  }
+
+private:
+  const ObjectID object_id_;
+  std::shared_ptr<Buffer> buffer_;
+  std::atomic<bool> is_finished_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+#endif // OBJECT_HANDLE_H
@@ -0,0 +1,39 @@
+#include "object_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+int64_t ObjectReader::Next(const uint8_t **data, int64_t min_bytes, int64_t timeout_us) {
+  const int64_t target = std::min(position_ + std::max<int64_t>(min_bytes, 1), buffer_->Size());
+  int64_t progress = buffer_->Progress();
+  if (progress < target) {
+    progress = buffer_->WaitProgress(target, timeout_us);
+  }
+  if (progress < position_ || buffer_->IsReset()) {
+    // the stream went back behind what we have consumed
+    return -1;
+  }
+  if (progress < target) {
+    return 0;
+  }
+  *data = buffer_->Data() + position_;
+  int64_t n_bytes = progress - position_;
+  position_ = progress;
+  return n_bytes;
+}
+
+int64_t ObjectReader::Read(uint8_t *out, int64_t size) {
+  const int64_t end = std::min(position_ + size, buffer_->Size());
+  int64_t n_read = 0;
+  while (position_ < end) {
+    int64_t progress = buffer_->WaitProgress(end);
+    if (progress < position_ || buffer_->IsReset()) {
+      return -1;
+    }
+    int64_t n_bytes = std::min(progress, end) - position_;
+    std::memcpy(out + n_read, buffer_->Data() + position_, n_bytes);
+    position_ += n_bytes;
+    n_read += n_bytes;
+  }
+  return n_read;
+}
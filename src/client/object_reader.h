@@ -0,0 +1,46 @@
+#ifndef OBJECT_READER_H
+#define OBJECT_READER_H
+
+#include <cstdint>
+#include <memory>
+
+#include "common/buffer.h"
+
+/// Reads an object from the front to the back while it is still being received or reduced.
+/// The bytes become readable as the progress of the buffer advances, so the caller can
+/// consume a prefix of the object while the rest is in flight.
+class ObjectReader {
+public:
+  explicit ObjectReader(const std::shared_ptr<Buffer> &buffer) : buffer_(buffer), position_(0) {}
+
+  /// The size of the object.
+  int64_t Size() const { return buffer_->Size(); }
+
+  /// The number of bytes consumed so far.
+  int64_t Position() const { return position_; }
+
+  bool AtEnd() const { return position_ >= buffer_->Size(); }
+
+  /// Wait until at least 'min_bytes' bytes after the position are ready (or the rest of the
+  /// object, if it is shorter), and consume all bytes that are ready.
+  /// \param[out] data The first consumed byte.
+  /// \param[in] min_bytes The number of bytes to wait for.
+  /// \param[in] timeout_us The timeout in microseconds. Negative means no timeout.
+  /// \return The number of consumed bytes, which is 0 at the end of the object or when the
+  /// timeout expires. It is -1 if the buffer was reset (e.g. a reduction that is restarted
+  /// after a failure), and the bytes consumed before are no longer valid.
+  int64_t Next(const uint8_t **data, int64_t min_bytes = 1, int64_t timeout_us = -1);
+
+  /// Read exactly 'size' bytes (or the rest of the object) into 'out'.
+  /// \return The number of bytes read, or -1 if the buffer was reset.
+  int64_t Read(uint8_t *out, int64_t size);
+
+  /// The buffer of the object.
+  const std::shared_ptr<Buffer> &buffer() const { return buffer_; }
+
+private:
+  const std::shared_ptr<Buffer> buffer_;
+  int64_t position_;
+};
+
+#endif // OBJECT_READER_H
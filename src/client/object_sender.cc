@@ -1,159 +1,610 @@
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <util/logging.h>
 #include <netinet/in.h>
 #include <util/socket_utils.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
-#include <signal.h>
 
+#include "common/chunk_compression.h"
 #include "common/config.h"
+#include "common/sparse_chunk.h"
 #include "object_sender.h"
-#include "util/protobuf_utils.h"
 
 using objectstore::ObjectWriterRequest;
 using objectstore::ReceiveObjectRequest;
 using objectstore::ReceiveReducedObjectRequest;
 
-template <typename T> inline int stream_send(int conn_fd, T *stream, int64_t offset = 0) {
-  TIMELINE("ObjectSender::stream_send()");
-  LOG(DEBUG) << "ObjectSender::stream_send(), offset=" << offset;
-  const uint8_t *data_ptr = stream->Data();
-  const int64_t object_size = stream->Size();
-
-  if (stream->IsFinished()) {
-    int status = send_all(conn_fd, data_ptr + offset, object_size - offset);
-    if (status) {
-      LOG(ERROR) << "Failed to send object.";
-      return status;
-    }
-    return 0;
-  }
-  int64_t cursor = offset;
-  while (cursor < object_size) {
-    int64_t current_progress = stream->progress;
-    if (cursor < current_progress) {
-      int bytes_sent = send(conn_fd, data_ptr + cursor, current_progress - cursor, 0);
-      if (bytes_sent < 0) {
-        LOG(ERROR) << "[stream_send] socket send error (" << strerror(errno) << ", code=" << errno
-                   << ", cursor=" << cursor << ", stream_progress=" << current_progress << ")";
-        if (errno == EAGAIN) {
-          continue;
-        }
-        return errno;
-      }
-      cursor += bytes_sent;
-    }
+namespace {
+
+/// Quantize the block [begin, end) of a buffer of float32 elements.
+/// \param error_feedback The quantization error that the transfer carries over, or nullptr.
+std::shared_ptr<const std::string> quantize_block(WireFormat wire_format, ErrorFeedback *error_feedback,
+                                                  const ObjectID &transfer_id, const Buffer &stream, int64_t begin,
+                                                  int64_t end) {
+  const int64_t n_elements = (end - begin) / sizeof(float);
+  auto block = std::make_shared<std::string>(wire_block_size(wire_format, n_elements), '\0');
+  const float *src = (const float *)(stream.Data() + begin);
+  uint8_t *dst = (uint8_t *)&(*block)[0];
+  if (error_feedback) {
+    error_feedback->Encode(wire_format, transfer_id, src, begin / sizeof(float), n_elements, dst);
+  } else {
+    wire_encode(wire_format, src, n_elements, dst, nullptr);
   }
-  return 0;
+  return block;
 }
 
+} // namespace
+
 ObjectSender::ObjectSender(ObjectStoreState &state, GlobalControlStoreClient &gcs_client,
                            LocalStoreClient &local_store_client, const std::string &my_address)
     : state_(state), gcs_client_(gcs_client), local_store_client_(local_store_client), my_address_(my_address),
-      pool_(HOPLITE_MAX_OUTLOW_CONCURRENCY) {
+      shutdown_(false), max_outflow_concurrency_(get_config_from_env("HOPLITE_MAX_OUTFLOW_CONCURRENCY",
+                                                                     HOPLITE_MAX_OUTLOW_CONCURRENCY)),
+      encode_pool_(get_config_from_env("HOPLITE_SENDER_ENCODE_THREADS", HOPLITE_SENDER_ENCODE_THREADS)) {
   TIMELINE(std::string("ObjectSender construction function ") + my_address + ":" + std::to_string(HOPLITE_SENDER_PORT));
+  DCHECK(max_outflow_concurrency_ > 0) << "Outflow concurrency must be positive.";
   tcp_bind_and_listen(HOPLITE_SENDER_PORT, &address_, &server_fd_);
-  LOG(DEBUG) << "[ObjectSender] object sender is ready.";
-}
-
-void sender_handle_signal(int sig) {
-  LOG(DEBUG) << "Signal received on object sender";
-  pthread_exit(nullptr);
+  DCHECK(fcntl(server_fd_, F_SETFL, fcntl(server_fd_, F_GETFL) | O_NONBLOCK) >= 0)
+      << "Cannot enable non-blocking for the server socket (errno = " << errno << ").";
+#ifdef HOPLITE_ENABLE_LOCAL_TRANSPORT
+  unix_bind_and_listen(local_socket_name(my_address_, HOPLITE_SENDER_PORT), &local_server_fd_);
+  DCHECK(fcntl(local_server_fd_, F_SETFL, fcntl(local_server_fd_, F_GETFL) | O_NONBLOCK) >= 0)
+      << "Cannot enable non-blocking for the local server socket (errno = " << errno << ").";
+#else
+  local_server_fd_ = -1;
+#endif
+  epoll_fd_ = epoll_create1(0);
+  DCHECK(epoll_fd_ >= 0) << "Cannot create epoll (errno = " << errno << ").";
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK);
+  DCHECK(wakeup_fd_ >= 0) << "Cannot create eventfd (errno = " << errno << ").";
+  progress_event_fd_ = eventfd(0, EFD_NONBLOCK);
+  DCHECK(progress_event_fd_ >= 0) << "Cannot create eventfd (errno = " << errno << ").";
+  for (int fd : {server_fd_, local_server_fd_, wakeup_fd_, progress_event_fd_}) {
+    if (fd < 0) {
+      continue;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    DCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0) << "epoll_ctl error (errno = " << errno << ").";
+  }
+  LOG(DEBUG) << "[ObjectSender] object sender is ready. outflow concurrency = " << max_outflow_concurrency_;
 }
 
-void ObjectSender::Run() { server_thread_ = std::thread(&ObjectSender::listener_loop, this); }
+void ObjectSender::Run() { server_thread_ = std::thread(&ObjectSender::event_loop, this); }
 
 void ObjectSender::Shutdown() {
+  shutdown_ = true;
+  uint64_t one = 1;
+  (void)write(wakeup_fd_, &one, sizeof(one));
+  server_thread_.join();
+  // the workers signal 'progress_event_fd_', so they must be done before it is closed
+  encode_pool_.stop();
+  for (Connection *conn : waiting_for_progress_) {
+    conn->stream->CancelProgressNotification(progress_event_fd_, conn->progress_target);
+  }
+  waiting_for_progress_.clear();
+  for (auto &p : connections_) {
+    close(p.first);
+  }
+  connections_.clear();
   close(server_fd_);
   server_fd_ = -1;
-  // we still send a signal here because the thread may be
-  // processing a task
-  pthread_kill(server_thread_.native_handle(), SIGUSR1);
-  server_thread_.join();
+  if (local_server_fd_ >= 0) {
+    close(local_server_fd_);
+    local_server_fd_ = -1;
+  }
+  close(progress_event_fd_);
+  close(wakeup_fd_);
+  close(epoll_fd_);
 }
 
-void ObjectSender::listener_loop() {
-  signal(SIGUSR1, sender_handle_signal);
+void ObjectSender::event_loop() {
+  constexpr int kMaxEvents = 64;
+  struct epoll_event events[kMaxEvents];
+  while (!shutdown_) {
+    int n_events = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (n_events < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "epoll_wait error (" << strerror(errno) << "). Shutting down the object sender ...";
+      return;
+    }
+    for (int i = 0; i < n_events; i++) {
+      int fd = events[i].data.fd;
+      if (fd == wakeup_fd_) {
+        uint64_t count;
+        (void)read(wakeup_fd_, &count, sizeof(count));
+        continue;
+      }
+      if (fd == server_fd_ || fd == local_server_fd_) {
+        accept_connections(fd);
+        continue;
+      }
+      if (fd == progress_event_fd_) {
+        uint64_t count;
+        (void)read(progress_event_fd_, &count, sizeof(count));
+        collect_encoded_chunks();
+        resume_transfers();
+        continue;
+      }
+      auto search = connections_.find(fd);
+      if (search == connections_.end()) {
+        // closed while handling earlier events of this round
+        continue;
+      }
+      Connection *conn = search->second.get();
+      bool ok = true;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        ok = false;
+      } else if (conn->sending) {
+        if (conn->read_memory) {
+          ok = send_progress(conn);
+        } else if (conn->compressed || conn->wire_format != WireFormat::RAW) {
+          ok = send_chunks(conn);
+        } else {
+          ok = send_available(conn);
+        }
+      } else {
+        ok = read_request(conn);
+      }
+      if (!ok) {
+        close_connection(conn);
+      }
+    }
+    activate_transfers();
+  }
+}
+
+void ObjectSender::accept_connections(int server_fd) {
   while (true) {
-    LOG(DEBUG) << "waiting for a connection";
-    socklen_t addrlen = sizeof(address_);
-    int conn_fd = accept(server_fd_, (struct sockaddr *)&address_, &addrlen);
+    int conn_fd;
+    if (server_fd == server_fd_) {
+      socklen_t addrlen = sizeof(address_);
+      conn_fd = accept(server_fd, (struct sockaddr *)&address_, &addrlen);
+    } else {
+      conn_fd = accept(server_fd, nullptr, nullptr);
+    }
     if (conn_fd < 0) {
-      LOG(ERROR) << "Socket accept error, maybe it has been closed by the user. "
-                 << "Shutting down the object sender ...";
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG(ERROR) << "Socket accept error (" << strerror(errno) << ").";
+      }
       return;
     }
-    char *incoming_ip = inet_ntoa(address_.sin_addr);
-    LOG(DEBUG) << "recieve a TCP connection from " << incoming_ip;
-    TIMELINE(std::string("Sender::worker_loop(), requester_ip = ") + incoming_ip);
+    if (server_fd == server_fd_) {
+      char *incoming_ip = inet_ntoa(address_.sin_addr);
+      LOG(DEBUG) << "recieve a TCP connection from " << incoming_ip;
+    } else {
+      LOG(DEBUG) << "recieve a local connection";
+    }
+    DCHECK(fcntl(conn_fd, F_SETFL, fcntl(conn_fd, F_GETFL) | O_NONBLOCK) >= 0)
+        << "Cannot enable non-blocking for the socket (errno = " << errno << ").";
+    connections_[conn_fd].reset(new Connection(conn_fd));
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = conn_fd;
+    DCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, conn_fd, &event) == 0)
+        << "epoll_ctl error (errno = " << errno << ").";
+  }
+}
 
+bool ObjectSender::read_request(Connection *conn) {
+  while (true) {
+    uint8_t *dst;
+    size_t remaining;
+    if (conn->bytes_read < sizeof(conn->message_size)) {
+      dst = (uint8_t *)&conn->message_size + conn->bytes_read;
+      remaining = sizeof(conn->message_size) - conn->bytes_read;
+    } else {
+      size_t message_progress = conn->bytes_read - sizeof(conn->message_size);
+      dst = conn->message_buf.data() + message_progress;
+      remaining = conn->message_size - message_progress;
+    }
+    if (remaining > 0) {
+      int bytes_recv = recv(conn->fd, dst, remaining, 0);
+      if (bytes_recv < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+        LOG(ERROR) << "[Sender] socket recv error (" << strerror(errno) << ", code=" << errno << ")";
+        return false;
+      } else if (bytes_recv == 0) {
+        // the receiver has closed the connection
+        LOG(DEBUG) << "[Sender] connection closed by the receiver.";
+        return false;
+      }
+      conn->bytes_read += bytes_recv;
+      if (conn->bytes_read == sizeof(conn->message_size)) {
+        conn->message_buf.resize(conn->message_size);
+      }
+      continue;
+    }
+    // the request is complete
     ObjectWriterRequest message;
-    ReceiveProtobufMessage(conn_fd, &message);
-    switch (message.message_type_case()) {
-    case ObjectWriterRequest::kReceiveObject: {
-      auto request = message.receive_object();
-      pool_.push(
-          [this, conn_fd](int tid, ReceiveObjectRequest request) {
-            ObjectID object_id = ObjectID::FromBinary(request.object_id());
-            int ec = send_object(conn_fd, object_id, request.object_size(), request.offset());
-            if (ec) {
-              LOG(ERROR) << "[Sender] Failed to send object. " << strerror(errno) << ", error_code=" << errno << ")";
-            } else {
-              LOG(DEBUG) << "[Sender] Send finished successfully.";
-            }
-          },
-          std::move(request));
-    } break;
-    case ObjectWriterRequest::kReceiveReducedObject: {
-      auto request = message.receive_reduced_object();
-      pool_.push(
-          [this, conn_fd](int tid, ReceiveReducedObjectRequest request) {
-            ObjectID reduction_id = ObjectID::FromBinary(request.reduction_id());
-            int ec = send_reduced_object(conn_fd, reduction_id, request.object_size(), request.offset());
-            if (ec) {
-              LOG(ERROR) << "[Sender] Failed to send reduced object. " << strerror(errno) << ", error_code=" << errno
-                         << ")";
-            } else {
-              LOG(DEBUG) << "[Sender] Send finished successfully.";
-            }
-          },
-          std::move(request));
-    } break;
-    default:
-      LOG(FATAL) << "unrecognized message type " << message.message_type_case();
-    }
-  }
-}
-
-int ObjectSender::send_object(int conn_fd, const ObjectID &object_id, int64_t object_size, int64_t offset) {
-  // fetch object from local store
-  std::shared_ptr<Buffer> stream;
-  local_store_client_.GetBufferOrCreate(object_id, object_size, &stream);
-  LOG(DEBUG) << object_id.ToString() << " find in local store. Ready to send.";
-  if (stream->IsFinished()) {
-    LOG(DEBUG) << "[Sender] fetched a completed object from local store: " << object_id.ToString();
-  } else {
-    LOG(DEBUG) << "[Sender] fetching a partial object: " << object_id.ToString();
+    message.ParseFromArray(conn->message_buf.data(), conn->message_buf.size());
+    conn->bytes_read = 0;
+    conn->message_size = 0;
+    start_transfer(conn, message);
+    return true;
+  }
+}
+
+void ObjectSender::start_transfer(Connection *conn, const ObjectWriterRequest &request) {
+  switch (request.message_type_case()) {
+  case ObjectWriterRequest::kReceiveObject: {
+    const ReceiveObjectRequest &r = request.receive_object();
+    ObjectID object_id = ObjectID::FromBinary(r.object_id());
+    TIMELINE(std::string("ObjectSender::send_object ") + object_id.ToString());
+    // fetch object from local store
+    local_store_client_.GetBufferOrCreate(object_id, r.object_size(), &conn->stream);
+    LOG(DEBUG) << "[Sender] fetched " << (conn->stream->IsFinished() ? "a completed" : "a partial")
+               << " object from local store: " << object_id.ToString();
+    conn->cursor = r.offset();
+    // a stripe of the object
+    conn->end = r.end() > 0 ? std::min(r.end(), conn->stream->Size()) : conn->stream->Size();
+    set_quantization(conn, object_id, r.quantization());
+    if (r.read_memory()) {
+      // the header frame tells the receiver where to read the object
+      int64_t pid = getpid();
+      uint64_t address = (uint64_t)conn->stream->Data();
+      std::memcpy(conn->frame, &pid, sizeof(pid));
+      std::memcpy(conn->frame + sizeof(pid), &address, sizeof(address));
+      conn->frame_size = sizeof(pid) + sizeof(address);
+      conn->frame_sent = 0;
+      conn->read_memory = true;
+    } else if (r.compressed()) {
+      conn->compressed = true;
+    }
+  } break;
+  case ObjectWriterRequest::kReceiveReducedObject: {
+    const ReceiveReducedObjectRequest &r = request.receive_reduced_object();
+    ObjectID reduction_id = ObjectID::FromBinary(r.reduction_id());
+    TIMELINE(std::string("ObjectSender::send_reduced_object ") + reduction_id.ToString());
+    // fetch object from object_store_state
+    conn->stream = state_.get_or_create_reduction_stream(reduction_id, r.object_size());
+    LOG(DEBUG) << "[Sender] fetched " << (conn->stream->IsFinished() ? "a completed" : "a partial")
+               << " object from reduction_stream: " << reduction_id.ToString();
+    conn->cursor = r.offset();
+    conn->end = conn->stream->Size();
+    set_quantization(conn, reduction_id, r.quantization());
+  } break;
+  default:
+    LOG(FATAL) << "unrecognized message type " << request.message_type_case();
+  }
+  conn->serial = ++next_serial_;
+  // stop reading until the transfer is done
+  set_events(conn, 0);
+  pending_transfers_.push_back(conn);
+}
+
+void ObjectSender::activate_transfers() {
+  while (active_transfers_ < max_outflow_concurrency_ && !pending_transfers_.empty()) {
+    Connection *conn = pending_transfers_.front();
+    pending_transfers_.pop_front();
+    conn->sending = true;
+    active_transfers_++;
+    set_events(conn, EPOLLOUT);
+  }
+}
+
+bool ObjectSender::send_available(Connection *conn) {
+  const int64_t end = conn->end;
+  const uint8_t *data_ptr = conn->stream->Data();
+  while (conn->cursor < end) {
+    int64_t current_progress = conn->stream->Progress();
+    if (conn->cursor >= current_progress) {
+      // we have caught up with the partial buffer. sleep until it has new bytes.
+      wait_for_progress(conn, conn->cursor + 1);
+      return true;
+    }
+    // bound each send so that concurrent transfers share the event loop fairly
+    int64_t send_size = std::min(std::min(current_progress, end) - conn->cursor, STREAM_MAX_BLOCK_SIZE);
+    int bytes_sent = send(conn->fd, data_ptr + conn->cursor, send_size, MSG_NOSIGNAL);
+    if (bytes_sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      LOG(ERROR) << "[Sender] socket send error (" << strerror(errno) << ", code=" << errno
+                 << ", cursor=" << conn->cursor << ", stream_progress=" << current_progress << ")";
+      return false;
+    }
+    conn->cursor += bytes_sent;
+    if (bytes_sent < send_size) {
+      // the socket buffer is full; wait for writability
+      return true;
+    }
+  }
+  finish_transfer(conn);
+  return true;
+}
+
+bool ObjectSender::send_progress(Connection *conn) {
+  if (conn->awaiting_ack) {
+    uint8_t ack;
+    int bytes_recv = recv(conn->fd, &ack, sizeof(ack), 0);
+    if (bytes_recv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      LOG(ERROR) << "[Sender] socket recv error (" << strerror(errno) << ", code=" << errno << ")";
+      return false;
+    } else if (bytes_recv == 0) {
+      LOG(DEBUG) << "[Sender] connection closed by the receiver before the copy is finished.";
+      return false;
+    }
+    finish_transfer(conn);
+    return true;
+  }
+  const int64_t end = conn->end;
+  while (true) {
+    int frame_status = send_frame(conn);
+    if (frame_status <= 0) {
+      return frame_status == 0;
+    }
+    if (conn->cursor >= end) {
+      // the buffer must stay alive until the receiver has copied it
+      conn->awaiting_ack = true;
+      set_events(conn, EPOLLIN);
+      return true;
+    }
+    int64_t current_progress = conn->stream->Progress();
+    if (conn->cursor >= current_progress) {
+      wait_for_progress(conn, conn->cursor + 1);
+      return true;
+    }
+    // one frame covers all bytes available now, however many they are
+    conn->cursor = std::min(current_progress, end);
+    std::memcpy(conn->frame, &conn->cursor, sizeof(conn->cursor));
+    conn->frame_size = sizeof(conn->cursor);
+    conn->frame_sent = 0;
+  }
+}
+
+void ObjectSender::set_quantization(Connection *conn, const ObjectID &transfer_id,
+                                    const objectstore::WireQuantization &quantization) {
+  conn->offset = conn->cursor;
+  conn->wire_format = static_cast<WireFormat>(quantization.format());
+  if (conn->wire_format != WireFormat::RAW && conn->wire_format != WireFormat::SPARSE &&
+      quantization.error_feedback_id() != 0) {
+    conn->error_feedback =
+        state_.get_error_feedback(quantization.error_feedback_id(), conn->stream->Size() / sizeof(float));
+  }
+  conn->transfer_id = transfer_id;
+}
+
+bool ObjectSender::send_chunks(Connection *conn) {
+  while (true) {
+    int frame_status = send_frame(conn);
+    if (frame_status <= 0) {
+      return frame_status == 0;
+    }
+    if (conn->chunk) {
+      const uint8_t *payload;
+      int64_t payload_size;
+      if (conn->chunk->empty()) {
+        payload = conn->stream->Data() + conn->cursor;
+        payload_size = conn->chunk_end - conn->cursor;
+      } else {
+        payload = (const uint8_t *)conn->chunk->data();
+        payload_size = conn->chunk->size();
+      }
+      if (conn->chunk_sent < payload_size) {
+        int64_t send_size = std::min(payload_size - conn->chunk_sent, STREAM_MAX_BLOCK_SIZE);
+        int bytes_sent = send(conn->fd, payload + conn->chunk_sent, send_size, MSG_NOSIGNAL);
+        if (bytes_sent < 0) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+          }
+          LOG(ERROR) << "[Sender] socket send error (" << strerror(errno) << ", code=" << errno
+                     << ", cursor=" << conn->cursor << ")";
+          return false;
+        }
+        conn->chunk_sent += bytes_sent;
+        continue;
+      }
+      conn->cursor = conn->chunk_end;
+      conn->chunk.reset();
+    }
+    if (conn->cursor >= conn->end) {
+      finish_transfer(conn);
+      return true;
+    }
+    if (conn->encoded) {
+      install_encoded_chunk(conn);
+      continue;
+    }
+    if (conn->encoding) {
+      // the worker wakes us up once the chunk is ready
+      set_events(conn, 0);
+      return true;
+    }
+    int64_t chunk_end = encoded_chunk_end(conn, conn->cursor);
+    if (conn->stream->Progress() < chunk_end) {
+      // chunks are encoded as a whole
+      wait_for_progress(conn, chunk_end);
+      return true;
+    }
+    encode_chunk(conn, conn->cursor, chunk_end);
   }
-  int ec = stream_send<Buffer>(conn_fd, stream.get(), offset);
-  LOG(DEBUG) << "send " << object_id.ToString() << " done, error_code=" << ec;
-  close(conn_fd);
-  return ec;
 }
 
-int ObjectSender::send_reduced_object(int conn_fd, const ObjectID &reduction_id, int64_t object_size, int64_t offset) {
-  TIMELINE("ObjectSender::send_reduced_object");
-  // fetch object from object_store_state
-  std::shared_ptr<Buffer> stream = state_.get_or_create_reduction_stream(reduction_id, object_size);
-  if (stream->IsFinished()) {
-    LOG(DEBUG) << "[Sender] fetched a completed object from local reduction_stream: " << reduction_id.ToString();
+int64_t ObjectSender::encoded_chunk_end(const Connection *conn, int64_t begin) {
+  if (conn->wire_format != WireFormat::RAW) {
+    return wire_block_end(conn->offset, begin, conn->end);
+  }
+  return compression_chunk_end(begin, conn->end);
+}
+
+void ObjectSender::encode_chunk(Connection *conn, int64_t begin, int64_t end) {
+  auto encoded = std::make_shared<EncodedChunk>();
+  encoded->fd = conn->fd;
+  encoded->serial = conn->serial;
+  encoded->begin = begin;
+  encoded->end = end;
+  std::shared_ptr<Buffer> stream = conn->stream;
+  const WireFormat wire_format = conn->wire_format;
+  std::shared_ptr<ErrorFeedback> error_feedback = conn->error_feedback;
+  const ObjectID transfer_id = conn->transfer_id;
+  conn->encoding = true;
+  encode_pool_.push([this, encoded, stream, wire_format, error_feedback, transfer_id](int id) {
+    if (wire_format == WireFormat::SPARSE) {
+      auto chunk = std::make_shared<std::string>();
+      // the frame is the number of nonzero words, and an empty chunk sends the block as it is
+      uint32_t n_nonzero =
+          sparse_chunk_encode(stream->Data() + encoded->begin, encoded->end - encoded->begin, chunk.get());
+      std::memcpy(encoded->frame, &n_nonzero, sizeof(n_nonzero));
+      encoded->frame_size = sizeof(n_nonzero);
+      if (n_nonzero != 0) {
+        // a block of zeros is only the frame
+        encoded->chunk = chunk;
+      }
+    } else if (wire_format != WireFormat::RAW) {
+      // quantized blocks have a fixed size, so they need no frame
+      encoded->chunk = quantize_block(wire_format, error_feedback.get(), transfer_id, *stream, encoded->begin,
+                                      encoded->end);
+    } else {
+      encoded->chunk = stream->GetCompressedChunks()->Get(*stream, encoded->begin, encoded->end);
+      uint32_t chunk_size = encoded->chunk->size();
+      std::memcpy(encoded->frame, &chunk_size, sizeof(chunk_size));
+      encoded->frame_size = sizeof(chunk_size);
+    }
+    {
+      std::lock_guard<std::mutex> lock(encoded_mutex_);
+      encoded_chunks_.push_back(encoded);
+    }
+    uint64_t one = 1;
+    (void)write(progress_event_fd_, &one, sizeof(one));
+  });
+}
+
+void ObjectSender::install_encoded_chunk(Connection *conn) {
+  std::shared_ptr<EncodedChunk> encoded = std::move(conn->encoded);
+  conn->encoded.reset();
+  DCHECK(encoded->begin == conn->cursor) << "The prepared chunk does not start at the cursor.";
+  std::memcpy(conn->frame, encoded->frame, encoded->frame_size);
+  conn->frame_size = encoded->frame_size;
+  conn->frame_sent = 0;
+  conn->chunk = encoded->chunk;
+  conn->chunk_end = encoded->end;
+  conn->chunk_sent = 0;
+  if (!conn->chunk) {
+    conn->cursor = encoded->end;
+  }
+  if (encoded->end < conn->end) {
+    int64_t next_end = encoded_chunk_end(conn, encoded->end);
+    if (conn->stream->Progress() >= next_end) {
+      encode_chunk(conn, encoded->end, next_end);
+    }
+  }
+}
+
+void ObjectSender::collect_encoded_chunks() {
+  std::vector<std::shared_ptr<EncodedChunk>> encoded_chunks;
+  {
+    std::lock_guard<std::mutex> lock(encoded_mutex_);
+    encoded_chunks.swap(encoded_chunks_);
+  }
+  for (auto &encoded : encoded_chunks) {
+    auto search = connections_.find(encoded->fd);
+    if (search == connections_.end()) {
+      // the connection is closed
+      continue;
+    }
+    Connection *conn = search->second.get();
+    if (!conn->encoding || conn->serial != encoded->serial) {
+      // the chunk belongs to an earlier transfer or connection with the same descriptor
+      continue;
+    }
+    conn->encoding = false;
+    conn->encoded = std::move(encoded);
+    set_events(conn, EPOLLOUT);
+  }
+}
+
+int ObjectSender::send_frame(Connection *conn) {
+  while (conn->frame_sent < conn->frame_size) {
+    int bytes_sent = send(conn->fd, conn->frame + conn->frame_sent, conn->frame_size - conn->frame_sent, MSG_NOSIGNAL);
+    if (bytes_sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      LOG(ERROR) << "[Sender] socket send error (" << strerror(errno) << ", code=" << errno << ")";
+      return -1;
+    }
+    conn->frame_sent += bytes_sent;
+  }
+  return 1;
+}
+
+void ObjectSender::wait_for_progress(Connection *conn, int64_t target) {
+  set_events(conn, 0);
+  conn->progress_target = target;
+  waiting_for_progress_.insert(conn);
+  conn->stream->NotifyOnProgress(progress_event_fd_, target);
+}
+
+void ObjectSender::resume_transfers() {
+  for (auto it = waiting_for_progress_.begin(); it != waiting_for_progress_.end();) {
+    Connection *conn = *it;
+    // the notification has fired and been removed once the progress reaches the target
+    if (conn->stream->Progress() >= conn->progress_target) {
+      set_events(conn, EPOLLOUT);
+      it = waiting_for_progress_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ObjectSender::finish_transfer(Connection *conn) {
+  LOG(DEBUG) << "[Sender] Send finished successfully.";
+  conn->stream.reset();
+  conn->sending = false;
+  conn->read_memory = false;
+  conn->awaiting_ack = false;
+  conn->compressed = false;
+  conn->wire_format = WireFormat::RAW;
+  conn->error_feedback.reset();
+  conn->chunk.reset();
+  conn->encoding = false;
+  conn->encoded.reset();
+  conn->frame_size = 0;
+  conn->frame_sent = 0;
+  active_transfers_--;
+  // wait for the next request on this connection
+  set_events(conn, EPOLLIN);
+}
+
+void ObjectSender::close_connection(Connection *conn) {
+  if (conn->sending) {
+    active_transfers_--;
+    if (waiting_for_progress_.erase(conn)) {
+      conn->stream->CancelProgressNotification(progress_event_fd_, conn->progress_target);
+    }
   } else {
-    LOG(DEBUG) << "[Sender] fetched a partial object from reduction_stream: " << reduction_id.ToString();
+    for (auto it = pending_transfers_.begin(); it != pending_transfers_.end(); ++it) {
+      if (*it == conn) {
+        pending_transfers_.erase(it);
+        break;
+      }
+    }
   }
-  int ec = stream_send<Buffer>(conn_fd, stream.get(), offset);
-  LOG(DEBUG) << "send " << reduction_id.ToString() << " done, error_code=" << ec;
-  close(conn_fd);
-  return ec;
+  int fd = conn->fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  connections_.erase(fd);
+}
+
+void ObjectSender::set_events(Connection *conn, uint32_t events) {
+  struct epoll_event event;
+  event.events = events;
+  event.data.fd = conn->fd;
+  DCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &event) == 0) << "epoll_ctl error (errno = " << errno << ").";
 }
@@ -1,18 +1,38 @@
 #ifndef OBJECT_SENDER_H
 #define OBJECT_SENDER_H
 
-#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <netinet/in.h> // struct sockaddr_in
 
+#include "common/wire_quantization.h"
 #include "global_control_store.h"
 #include "local_store_client.h"
 #include "object_store.pb.h"
 #include "object_store_state.h"
+#include "util/ctpl_stl.h"
 
+/// The sender serves objects to the receivers of other nodes. All connections are handled by
+/// one epoll event loop: requests are read when a connection is readable, and data is sent
+/// only when the socket is writable and the requested buffer has bytes that were not sent yet.
+///
+/// Receivers on the same host connect through a Unix domain socket. They can also ask for the
+/// address of the object instead of its bytes, and copy it from the memory of this process
+/// with a single copy. Then the sender streams the progress of the object as 8-byte frames,
+/// and keeps the object alive until the receiver acknowledges the end of the copy.
+///
+/// Receivers can also ask for the object in compressed chunks. Every chunk is sent once its
+/// bytes are ready, and is compressed only once for all receivers. Receivers of reductions can
+/// ask for quantized blocks of float32 elements instead, or for sparse blocks that leave the
+/// zeros out. All of these chunks are prepared by worker threads, which wake up the event loop
+/// when a chunk is ready, so a slow encoding never holds up the other transfers.
 class ObjectSender {
 public:
   ObjectSender(ObjectStoreState &state, GlobalControlStoreClient &gcs_client, LocalStoreClient &local_store_client,
@@ -23,11 +43,126 @@ public:
   void Shutdown();
 
 private:
-  void listener_loop();
+  /// A chunk that a worker has prepared for a transfer.
+  struct EncodedChunk {
+    // the connection and the transfer that the chunk belongs to
+    int fd;
+    uint64_t serial;
+    int64_t begin;
+    int64_t end;
+    // the frame that precedes the chunk
+    uint8_t frame[sizeof(uint32_t)];
+    size_t frame_size = 0;
+    // the chunk. it is empty if the range is sent as it is, and nullptr if only the frame is sent.
+    std::shared_ptr<const std::string> chunk;
+  };
 
-  int send_object(int conn_fd, const ObjectID &object_id, int64_t object_size, int64_t offset);
+  /// A receiver connection. It reads one request, sends the requested bytes and then waits
+  /// for the next request, so receivers can reuse it.
+  struct Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    const int fd;
+    // the size-prefixed request being read
+    size_t message_size = 0;
+    size_t bytes_read = 0;
+    std::vector<uint8_t> message_buf;
+    // the transfer
+    std::shared_ptr<Buffer> stream;
+    int64_t cursor = 0;
+    // the beginning of the transfer, where quantized blocks start
+    int64_t offset = 0;
+    // the end of the requested range
+    int64_t end = 0;
+    bool sending = false;
+    // the progress of the stream that the transfer is waiting for
+    int64_t progress_target = 0;
+    // the receiver reads the object from our memory
+    bool read_memory = false;
+    // the frame being sent for 'read_memory' transfers
+    uint8_t frame[16];
+    size_t frame_size = 0;
+    size_t frame_sent = 0;
+    // all progress has been sent, and the copy of the receiver is not finished yet
+    bool awaiting_ack = false;
+    // the object is sent in compressed chunks
+    bool compressed = false;
+    // the float32 elements are sent in quantized blocks of this format
+    WireFormat wire_format = WireFormat::RAW;
+    // the quantization error that we carry over, or nullptr
+    std::shared_ptr<ErrorFeedback> error_feedback;
+    // the object or reduction being sent
+    ObjectID transfer_id;
+    // identifies the transfer, so that the chunks prepared for an earlier one are dropped
+    uint64_t serial = 0;
+    // a worker is preparing the next chunk
+    bool encoding = false;
+    // the next chunk, which a worker has prepared
+    std::shared_ptr<EncodedChunk> encoded;
+    // the chunk being sent for compressed, quantized and sparse transfers. a compressed or sparse
+    // chunk is empty if it is sent raw.
+    std::shared_ptr<const std::string> chunk;
+    int64_t chunk_end = 0;
+    int64_t chunk_sent = 0;
+  };
 
-  int send_reduced_object(int conn_fd, const ObjectID &object_id, int64_t object_size, int64_t offset);
+  void event_loop();
+
+  void accept_connections(int server_fd);
+
+  /// Read the request of a connection. Return false if the connection should be closed.
+  bool read_request(Connection *conn);
+
+  /// Resolve the buffer of a received request and queue the transfer.
+  void start_transfer(Connection *conn, const objectstore::ObjectWriterRequest &request);
+
+  /// Start queued transfers as long as the outflow concurrency allows.
+  void activate_transfers();
+
+  /// Send the available bytes of the transfer. Return false if the connection should be closed.
+  bool send_available(Connection *conn);
+
+  /// Send the progress of a 'read_memory' transfer, and finish it when the receiver has copied
+  /// the whole object. Return false if the connection should be closed.
+  bool send_progress(Connection *conn);
+
+  /// Send the ready chunks of a compressed or quantized transfer. Return false if the
+  /// connection should be closed.
+  bool send_chunks(Connection *conn);
+
+  /// The end of the chunk that starts at 'begin' in a compressed, quantized or sparse transfer.
+  static int64_t encoded_chunk_end(const Connection *conn, int64_t begin);
+
+  /// Let a worker prepare the chunk [begin, end) of a compressed, quantized or sparse transfer.
+  /// The bytes of the chunk must be ready.
+  void encode_chunk(Connection *conn, int64_t begin, int64_t end);
+
+  /// Make the prepared chunk the one being sent, and prepare the following chunk meanwhile if
+  /// its bytes are ready.
+  void install_encoded_chunk(Connection *conn);
+
+  /// Hand the chunks that the workers have prepared to their transfers.
+  void collect_encoded_chunks();
+
+  /// Set up the quantization that the receiver asks for.
+  /// \param transfer_id The object or reduction being sent.
+  void set_quantization(Connection *conn, const ObjectID &transfer_id,
+                        const objectstore::WireQuantization &quantization);
+
+  /// Send the rest of the pending frame.
+  /// \return 1 if the frame is sent, 0 if the socket is full and -1 on errors.
+  int send_frame(Connection *conn);
+
+  /// Sleep until the stream of the transfer reaches 'target'.
+  void wait_for_progress(Connection *conn, int64_t target);
+
+  /// Resume the transfers whose partial buffers have made progress.
+  void resume_transfers();
+
+  void finish_transfer(Connection *conn);
+
+  void close_connection(Connection *conn);
+
+  void set_events(Connection *conn, uint32_t events);
 
   GlobalControlStoreClient &gcs_client_;
   LocalStoreClient &local_store_client_;
@@ -38,8 +173,30 @@ private:
   int server_fd_;
   std::thread server_thread_;
   struct sockaddr_in address_;
-  // thread pool for launching tasks
-  ctpl::thread_pool pool_;
+  // for the receivers on the same host
+  int local_server_fd_;
+
+  // for the event loop
+  int epoll_fd_;
+  // wakes up the event loop for shutting down
+  int wakeup_fd_;
+  // signaled by the buffers that the waiting transfers have caught up with
+  int progress_event_fd_;
+  std::atomic<bool> shutdown_;
+  std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+  // transfers waiting for an outflow slot
+  std::deque<Connection *> pending_transfers_;
+  // transfers that have sent all available bytes of a partial buffer
+  std::unordered_set<Connection *> waiting_for_progress_;
+  int64_t active_transfers_ = 0;
+  const int64_t max_outflow_concurrency_;
+  uint64_t next_serial_ = 0;
+
+  // for preparing chunks off the event loop. the workers signal 'progress_event_fd_' once they
+  // have added a chunk.
+  ctpl::thread_pool encode_pool_;
+  std::mutex encoded_mutex_;
+  std::vector<std::shared_ptr<EncodedChunk>> encoded_chunks_;
 };
 
 #endif // OBJECT_SENDER_H
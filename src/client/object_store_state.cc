@@ -67,3 +67,13 @@ bool ObjectStoreState::local_reduce_task_exists(const ObjectID &reduction_id) {
   std::lock_guard<std::mutex> lock(reduce_tasks_mutex_);
   return reduce_tasks_.count(reduction_id) > 0;
 }
+
+std::shared_ptr<ErrorFeedback> ObjectStoreState::get_error_feedback(int64_t error_feedback_id, int64_t n_elements) {
+  std::unique_lock<std::mutex> l(error_feedback_mutex_);
+  auto &error_feedback = error_feedback_[error_feedback_id];
+  if (!error_feedback || error_feedback->Size() != n_elements) {
+    // the residual of another shape does not apply
+    error_feedback = std::make_shared<ErrorFeedback>(n_elements);
+  }
+  return error_feedback;
+}
@@ -10,6 +10,7 @@
 
 #include "common/buffer.h"
 #include "common/id.h"
+#include "common/wire_quantization.h"
 
 class LocalReduceTask {
 public:
@@ -28,7 +29,24 @@ public:
     notification_cv_.notify_all();
   }
 
+  /// Publish the buffer that the reduction is written to, so that it can be read while it is
+  /// being reduced.
+  void SetStream(const std::shared_ptr<Buffer> &stream) {
+    std::unique_lock<std::mutex> l(notification_mutex_);
+    stream_ = stream;
+    notification_cv_.notify_all();
+  }
+
+  /// Wait until the buffer of the reduction is created.
+  /// \return The buffer, or nullptr if the reduction has finished without publishing it.
+  std::shared_ptr<Buffer> WaitStream() {
+    std::unique_lock<std::mutex> l(notification_mutex_);
+    notification_cv_.wait(l, [this]() { return stream_ || is_finished_.load(); });
+    return stream_;
+  }
+
 private:
+  std::shared_ptr<Buffer> stream_;
   std::atomic<bool> is_finished_;
   std::mutex notification_mutex_;
   std::condition_variable notification_cv_;
@@ -53,6 +71,10 @@ public:
 
   bool local_reduce_task_exists(const ObjectID &reduction_id);
 
+  /// Get the quantization error that this node carries over for an error feedback id. It
+  /// starts from zeros for a new id or a different number of elements.
+  std::shared_ptr<ErrorFeedback> get_error_feedback(int64_t error_feedback_id, int64_t n_elements);
+
 private:
   std::mutex reduction_stream_mutex_;
   std::condition_variable reduction_stream_cv_;
@@ -60,6 +82,9 @@ private:
 
   std::mutex reduce_tasks_mutex_;
   std::unordered_map<ObjectID, std::shared_ptr<LocalReduceTask>> reduce_tasks_;
+
+  std::mutex error_feedback_mutex_;
+  std::unordered_map<int64_t, std::shared_ptr<ErrorFeedback>> error_feedback_;
 };
 
 #endif // OBJECT_STORE_STATE_H
@@ -1,9 +1,19 @@
 #include "receiver.h"
 
+#include <chrono>
 #include <fcntl.h> // for non-blocking socket
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h> // process_vm_readv
 #include <unistd.h>
 
+#include "common/chunk_compression.h"
 #include "common/config.h"
+#include "common/reduce_engine.h"
+#include "common/reduce_kernels.h"
+#include "common/sparse_chunk.h"
+#include "common/striped_progress.h"
+#include "common/wire_quantization.h"
 
 #include "object_store.pb.h"
 #include "util/protobuf_utils.h"
@@ -12,18 +22,31 @@ using objectstore::ObjectWriterRequest;
 using objectstore::ReceiveObjectRequest;
 using objectstore::ReceiveReducedObjectRequest;
 
-template <typename T> inline int stream_receive_next(int conn_fd, T *stream, int64_t *receive_progress) {
-  int remaining_size = stream->Size() - *receive_progress;
+/// Receive the next block of a stream.
+/// \param end The end of the bytes to receive. Negative means the end of the stream.
+/// \param data Where the bytes go instead of the stream, if it is not null.
+template <typename T>
+inline int stream_receive_next(int conn_fd, T *stream, int64_t *receive_progress, int64_t end = -1,
+                               uint8_t *data = nullptr) {
+  int remaining_size = (end < 0 ? stream->Size() : end) - *receive_progress;
   // here we receive no more than STREAM_MAX_BLOCK_SIZE for streaming
   int recv_block_size = remaining_size > STREAM_MAX_BLOCK_SIZE ? STREAM_MAX_BLOCK_SIZE : remaining_size;
+  if (!data) {
+    data = stream->MutableData() + *receive_progress;
+  }
   while (true) {
-    int bytes_recv = recv(conn_fd, stream->MutableData() + *receive_progress, recv_block_size, 0);
+    int bytes_recv = recv(conn_fd, data, recv_block_size, 0);
     if (bytes_recv < 0) {
       if (errno == EAGAIN) {
 #ifndef HOPLITE_ENABLE_NONBLOCKING_SOCKET_RECV
         LOG(WARNING) << "[stream_receive_next] socket recv error (EAGAIN). Ignored.";
 #endif
-        if (stream->reset) {
+        // sleep until the socket is readable or the stream is reset
+        int ready = wait_socket(conn_fd, POLLIN, stream->ResetEventFd());
+        if (ready < 0) {
+          return -1;
+        }
+        if (ready == 0 || stream->IsReset()) {
           return 0;
         }
         continue;
@@ -39,140 +62,470 @@ template <typename T> inline int stream_receive_next(int conn_fd, T *stream, int
   }
 }
 
-template <typename T> inline int stream_receive(int conn_fd, T *stream, int64_t offset = 0) {
+inline int recv_frame(int conn_fd, uint8_t *frame, size_t size, Buffer *stream);
+
+/// Receive the next block of a quantized stream, and decode it into float32.
+/// \param offset The beginning of the transfer, where the blocks start.
+/// \param wire_block The buffer for the encoded block.
+/// \param data Where the block is decoded to.
+/// \return 0 on success, and -1 on errors. The progress is unchanged if the stream is reset.
+inline int stream_receive_next_quantized(int conn_fd, Buffer *stream, int64_t *receive_progress, int64_t offset,
+                                         WireFormat wire_format, std::vector<uint8_t> *wire_block, uint8_t *data) {
+  const int64_t block_end = wire_block_end(offset, *receive_progress, stream->Size());
+  const int64_t n_elements = (block_end - *receive_progress) / sizeof(float);
+  wire_block->resize(wire_block_size(wire_format, n_elements));
+  int ec = recv_frame(conn_fd, wire_block->data(), wire_block->size(), stream);
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  wire_decode(wire_format, wire_block->data(), n_elements, (float *)data);
+  *receive_progress = block_end;
+  return 0;
+}
+
+/// Receive the next block of a sparse stream, and expand it into the stream.
+/// \param offset The beginning of the transfer, where the blocks start.
+/// \param wire_block The buffer for the sparse chunk.
+/// \param data Where the block is expanded to.
+/// \return 0 on success, and -1 on errors. The progress is unchanged if the stream is reset.
+inline int stream_receive_next_sparse(int conn_fd, Buffer *stream, int64_t *receive_progress, int64_t offset,
+                                      std::vector<uint8_t> *wire_block, uint8_t *data) {
+  uint32_t n_nonzero;
+  int ec = recv_frame(conn_fd, (uint8_t *)&n_nonzero, sizeof(n_nonzero), stream);
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  const int64_t block_end = wire_block_end(offset, *receive_progress, stream->Size());
+  const int64_t size = block_end - *receive_progress;
+  if (n_nonzero == kSparseDenseChunk) {
+    ec = recv_frame(conn_fd, data, size, stream);
+  } else {
+    if (n_nonzero > size / sizeof(uint32_t)) {
+      LOG(ERROR) << "[stream_receive_next_sparse] corrupted sparse chunk (" << n_nonzero << " words)";
+      return -1;
+    }
+    wire_block->resize(sparse_chunk_size(n_nonzero));
+    ec = recv_frame(conn_fd, wire_block->data(), wire_block->size(), stream);
+    if (!ec && sparse_chunk_decode(wire_block->data(), n_nonzero, data, size)) {
+      LOG(ERROR) << "[stream_receive_next_sparse] corrupted sparse chunk (" << n_nonzero << " words)";
+      return -1;
+    }
+  }
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  *receive_progress = block_end;
+  return 0;
+}
+
+/// Receive the next block of a stream in its wire format.
+/// \param end The end of the bytes to receive for raw streams. Negative means the end of the stream.
+/// \param data Where the bytes go instead of the stream, if it is not null.
+template <typename T>
+inline int stream_receive_next_wire(int conn_fd, T *stream, int64_t *receive_progress, int64_t offset,
+                                    WireFormat wire_format, std::vector<uint8_t> *wire_block, int64_t end = -1,
+                                    uint8_t *data = nullptr) {
+  if (wire_format == WireFormat::RAW) {
+    return stream_receive_next<T>(conn_fd, stream, receive_progress, end, data);
+  }
+  if (!data) {
+    data = stream->MutableData() + *receive_progress;
+  }
+  if (wire_format == WireFormat::SPARSE) {
+    return stream_receive_next_sparse(conn_fd, stream, receive_progress, offset, wire_block, data);
+  }
+  return stream_receive_next_quantized(conn_fd, stream, receive_progress, offset, wire_format, wire_block, data);
+}
+
+template <typename T>
+inline int stream_receive(int conn_fd, T *stream, int64_t offset = 0, WireFormat wire_format = WireFormat::RAW) {
   TIMELINE("stream_receive");
   int64_t receive_progress = offset;
-  while (receive_progress < stream->Size() && !stream->reset) {
-    int ec = stream_receive_next<T>(conn_fd, stream, &receive_progress);
+  std::vector<uint8_t> wire_block;
+  while (receive_progress < stream->Size() && !stream->IsReset()) {
+    int ec = stream_receive_next_wire<T>(conn_fd, stream, &receive_progress, offset, wire_format, &wire_block);
     if (ec) {
       // return the error
       LOG(ERROR) << "[stream_receive] socket receive error (" << strerror(errno) << ", code=" << errno
                  << ", receive_progress=" << receive_progress << ")";
       return ec;
     }
-    // update the progress
-#ifdef HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-    stream->progress.store(receive_progress);
-#else
-    stream->progress = receive_progress;
-#endif
+    // publish the progress to the readers of the stream
+    stream->SetProgress(receive_progress);
+  }
+  return 0;
+}
+
+/// Receive a fixed-size frame. Return 0 on success, 1 if the stream is reset meanwhile, and
+/// -1 on connection errors.
+inline int recv_frame(int conn_fd, uint8_t *frame, size_t size, Buffer *stream) {
+  size_t received = 0;
+  while (received < size) {
+    int bytes_recv = recv(conn_fd, frame + received, size - received, 0);
+    if (bytes_recv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        int ready = wait_socket(conn_fd, POLLIN, stream->ResetEventFd());
+        if (ready < 0) {
+          return -1;
+        }
+        if (ready == 0 || stream->IsReset()) {
+          return 1;
+        }
+        continue;
+      }
+      LOG(ERROR) << "[recv_frame] socket recv error (" << strerror(errno) << ", code=" << errno << ")";
+      return -1;
+    } else if (bytes_recv == 0) {
+      LOG(ERROR) << "[recv_frame] connection closed by the sender";
+      return -1;
+    }
+    received += bytes_recv;
+  }
+  return 0;
+}
+
+/// Receive the next chunk of a compressed stream, and cache it for forwarding.
+/// \param end The end of the bytes to receive.
+/// \return 0 on success, and -1 on errors. The progress is unchanged if the stream is reset.
+inline int stream_receive_next_compressed(int conn_fd, Buffer *stream, int64_t *receive_progress, int64_t end) {
+  uint32_t chunk_size;
+  int ec = recv_frame(conn_fd, (uint8_t *)&chunk_size, sizeof(chunk_size), stream);
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  const int64_t chunk_end = compression_chunk_end(*receive_progress, end);
+  uint8_t *data = stream->MutableData() + *receive_progress;
+  auto chunk = std::make_shared<std::string>(chunk_size, '\0');
+  if (chunk_size == 0) {
+    // the chunk does not compress
+    ec = recv_frame(conn_fd, data, chunk_end - *receive_progress, stream);
+  } else {
+    ec = recv_frame(conn_fd, (uint8_t *)&(*chunk)[0], chunk_size, stream);
+    if (!ec) {
+      ec = decompress_chunk(*chunk, data, chunk_end - *receive_progress);
+    }
+  }
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  stream->GetCompressedChunks()->Put(*stream, *receive_progress, chunk_end, chunk);
+  *receive_progress = chunk_end;
+  return 0;
+}
+
+inline int stream_receive_compressed(int conn_fd, Buffer *stream, int64_t offset) {
+  TIMELINE("stream_receive_compressed");
+  int64_t receive_progress = offset;
+  while (receive_progress < stream->Size() && !stream->IsReset()) {
+    int ec = stream_receive_next_compressed(conn_fd, stream, &receive_progress, stream->Size());
+    if (ec) {
+      LOG(ERROR) << "[stream_receive_compressed] receive error (receive_progress=" << receive_progress << ")";
+      return ec;
+    }
+    stream->SetProgress(receive_progress);
   }
   return 0;
 }
 
 /// reduce(conn, dep_stream) -> stream
-template <typename T, typename DT>
-int stream_reduce_add_single_thread(int conn_fd, T *stream, T &dep_stream, int64_t offset) {
+template <typename T>
+int stream_reduce_add_single_thread(int conn_fd, T *stream, T &dep_stream, int64_t offset, ReduceKernel reduce_kernel,
+                                    size_t element_size, WireFormat wire_format) {
   TIMELINE("stream_reduce_add_single_thread");
   LOG(DEBUG) << "stream_reduce_add_single_thread(), offset=" << offset;
   int64_t receive_progress = offset;
-  const size_t element_size = sizeof(DT);
   uint8_t *data_ptr = stream->MutableData();
-  uint8_t *dep_data_ptr = dep_stream.MutableData();
+  const uint8_t *dep_data_ptr = dep_stream.Data();
   const int64_t object_size = stream->Size();
-  while (receive_progress < object_size && !stream->reset) {
-    int status = stream_receive_next<T>(conn_fd, stream, &receive_progress);
+  std::vector<uint8_t> wire_block;
+  while (receive_progress < object_size && !stream->IsReset()) {
+    int status = stream_receive_next_wire<T>(conn_fd, stream, &receive_progress, offset, wire_format, &wire_block);
     if (status) {
       // return the error
       return status;
     }
     // reduce related objects
-#ifdef HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-    auto progress = stream->progress.load();
-    auto dep_stream_progress = dep_stream.progress.load();
-#else
-    auto progress = stream->progress;
-    auto dep_stream_progress = dep_stream.progress;
-#endif
+    int64_t progress = stream->Progress();
+    int64_t dep_stream_progress = dep_stream.Progress();
     if (dep_stream_progress > progress) {
       int64_t n_reduce_elements = (std::min(dep_stream_progress, receive_progress) - progress) / element_size;
-      DT *cursor = (DT *)(data_ptr + progress);
-      const DT *own_data_cursor = (DT *)(dep_data_ptr + progress);
-      for (size_t i = 0; i < n_reduce_elements; i++) {
-        cursor[i] += own_data_cursor[i];
-      }
-      stream->progress += n_reduce_elements * element_size;
+      ReduceEngine::Get().Reduce(reduce_kernel, data_ptr + progress, dep_data_ptr + progress, n_reduce_elements,
+                                 element_size);
+      stream->AdvanceProgress(n_reduce_elements * element_size);
     }
   }
-  while (!stream->IsFinished() && !stream->reset) {
-#ifdef HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-    auto progress = stream->progress.load();
-    auto dep_stream_progress = dep_stream.progress.load();
-#else
-    auto progress = stream->progress;
-    auto dep_stream_progress = dep_stream.progress;
-#endif
+  while (!stream->IsFinished() && !stream->IsReset()) {
+    int64_t progress = stream->Progress();
+    // sleep until the dependency has new elements. the timeout bounds the delay of noticing a reset.
+    int64_t dep_stream_progress =
+        dep_stream.WaitProgress(progress + (int64_t)element_size, HOPLITE_PROGRESS_WAIT_TIMEOUT_US);
     int64_t n_reduce_elements = (dep_stream_progress - progress) / element_size;
-    DT *cursor = (DT *)(data_ptr + progress);
-    const DT *own_data_cursor = (DT *)(dep_data_ptr + progress);
-    for (size_t i = 0; i < n_reduce_elements; i++) {
-      cursor[i] += own_data_cursor[i];
+    if (n_reduce_elements > 0) {
+      ReduceEngine::Get().Reduce(reduce_kernel, data_ptr + progress, dep_data_ptr + progress, n_reduce_elements,
+                                 element_size);
+      stream->AdvanceProgress(n_reduce_elements * element_size);
     }
-    stream->progress += n_reduce_elements * element_size;
   }
   return 0;
 }
 
 /// reduce(conn, dep_stream) -> stream
-template <typename T, typename DT>
-int stream_reduce_add_multi_thread(int conn_fd, T *stream, T &dep_stream, int64_t offset) {
+template <typename T>
+int stream_reduce_add_multi_thread(int conn_fd, T *stream, T &dep_stream, int64_t offset, ReduceKernel reduce_kernel,
+                                   size_t element_size, WireFormat wire_format) {
   TIMELINE("stream_reduce_add_multi_thread");
   LOG(DEBUG) << "stream_reduce_add_multi_thread(), offset=" << offset;
-  int64_t receive_progress = offset;
-  const size_t element_size = sizeof(DT);
+  // the bytes received from the connection, which are ahead of the reduced progress of the stream
+  ProgressCounter received(offset);
   uint8_t *data_ptr = stream->MutableData();
-  uint8_t *dep_data_ptr = dep_stream.MutableData();
-  volatile bool reset = false;
+  const uint8_t *dep_data_ptr = dep_stream.Data();
+  std::atomic<bool> failed(false);
 
   std::thread t([&]() {
-    while (!stream->IsFinished() && !stream->reset && !reset) {
-#ifdef HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-      auto progress = stream->progress.load();
-      auto dep_stream_progress = dep_stream.progress.load();
-#else
-      auto progress = stream->progress;
-      auto dep_stream_progress = dep_stream.progress;
-#endif
-      int64_t n_reduce_elements = (std::min(dep_stream_progress, receive_progress) - progress) / element_size;
-      DT *cursor = (DT *)(data_ptr + progress);
-      const DT *own_data_cursor = (DT *)(dep_data_ptr + progress);
-      for (size_t i = 0; i < n_reduce_elements; i++) {
-        cursor[i] += own_data_cursor[i];
+    while (!stream->IsFinished() && !stream->IsReset() && !failed) {
+      int64_t progress = stream->Progress();
+      int64_t target = progress + element_size;
+      // sleep until both inputs have new elements. the timeouts bound the delay of noticing a reset.
+      int64_t receive_progress = received.Wait(target, HOPLITE_PROGRESS_WAIT_TIMEOUT_US);
+      if (receive_progress < target) {
+        continue;
       }
-      stream->progress += n_reduce_elements * element_size;
+      int64_t dep_stream_progress = dep_stream.WaitProgress(target, HOPLITE_PROGRESS_WAIT_TIMEOUT_US);
+      if (dep_stream_progress < target) {
+        continue;
+      }
+      int64_t n_reduce_elements = (std::min(dep_stream_progress, receive_progress) - progress) / element_size;
+      ReduceEngine::Get().Reduce(reduce_kernel, data_ptr + progress, dep_data_ptr + progress, n_reduce_elements,
+                                 element_size);
+      stream->AdvanceProgress(n_reduce_elements * element_size);
     }
   });
 
+  int64_t receive_progress = offset;
   const int64_t object_size = stream->Size();
-  while (receive_progress < object_size && !stream->reset) {
-    int status = stream_receive_next<T>(conn_fd, stream, &receive_progress);
+  std::vector<uint8_t> wire_block;
+  auto start = std::chrono::steady_clock::now();
+  while (receive_progress < object_size && !stream->IsReset()) {
+    int status = stream_receive_next_wire<T>(conn_fd, stream, &receive_progress, offset, wire_format, &wire_block);
     if (status) {
-      reset = true;
+      failed = true;
+      received.Interrupt();
       t.join();
       // return the error
       return status;
     }
+    received.Store(receive_progress);
   }
+  // the receiving does not wait for the reducing here, so it measures the link
+  ReduceEngine::Get().RecordLink(receive_progress - offset,
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  // let the reducer re-check the reset flag in case the loop was interrupted
+  received.Interrupt();
   t.join();
   return 0;
 }
 
+/// reduce(conn, dep_stream) -> stream for sparse transfers of reductions where zero is the identity
+/// (SUM). Each block of the local object is copied into the stream once it is ready, and only the
+/// nonzero words of the received chunk are reduced into it, so all-zero blocks skip the kernel.
+template <typename T>
+int stream_reduce_add_sparse(int conn_fd, T *stream, T &dep_stream, int64_t offset, ReduceKernel reduce_kernel,
+                             size_t element_size) {
+  TIMELINE("stream_reduce_add_sparse");
+  LOG(DEBUG) << "stream_reduce_add_sparse(), offset=" << offset;
+  int64_t receive_progress = offset;
+  uint8_t *data_ptr = stream->MutableData();
+  const uint8_t *dep_data_ptr = dep_stream.Data();
+  const int64_t object_size = stream->Size();
+  std::vector<uint8_t> wire_block;
+  while (receive_progress < object_size && !stream->IsReset()) {
+    uint32_t n_nonzero;
+    int ec = recv_frame(conn_fd, (uint8_t *)&n_nonzero, sizeof(n_nonzero), stream);
+    if (ec) {
+      return ec < 0 ? ec : 0;
+    }
+    const int64_t block_end = wire_block_end(offset, receive_progress, object_size);
+    const int64_t size = block_end - receive_progress;
+    uint8_t *data = data_ptr + receive_progress;
+    if (n_nonzero == kSparseDenseChunk) {
+      ec = recv_frame(conn_fd, data, size, stream);
+    } else {
+      if (n_nonzero > size / sizeof(uint32_t)) {
+        LOG(ERROR) << "[stream_reduce_add_sparse] corrupted sparse chunk (" << n_nonzero << " words)";
+        return -1;
+      }
+      wire_block.resize(sparse_chunk_size(n_nonzero));
+      ec = recv_frame(conn_fd, wire_block.data(), wire_block.size(), stream);
+    }
+    if (ec) {
+      return ec < 0 ? ec : 0;
+    }
+    // sleep until the local object has the block. the timeout bounds the delay of noticing a reset.
+    while (dep_stream.WaitProgress(block_end, HOPLITE_PROGRESS_WAIT_TIMEOUT_US) < block_end) {
+      if (stream->IsReset()) {
+        return 0;
+      }
+    }
+    if (n_nonzero == kSparseDenseChunk) {
+      ReduceEngine::Get().Reduce(reduce_kernel, data, dep_data_ptr + receive_progress, size / element_size,
+                                 element_size);
+    } else {
+      std::memcpy(data, dep_data_ptr + receive_progress, size);
+      if (sparse_chunk_reduce(wire_block.data(), n_nonzero, reduce_kernel, element_size, data, size)) {
+        LOG(ERROR) << "[stream_reduce_add_sparse] corrupted sparse chunk (" << n_nonzero << " words)";
+        return -1;
+      }
+    }
+    receive_progress = block_end;
+    stream->SetProgress(receive_progress);
+  }
+  return 0;
+}
+
 /// reduce(conn, dep_stream) -> stream
-template <typename T, typename DT> int stream_reduce_add(int conn_fd, T *stream, T &dep_stream, int64_t offset) {
+/// \param wire_format The format of the elements on the wire. They are decoded into the stream
+/// before they are reduced.
+template <typename T>
+int stream_reduce_add(int conn_fd, T *stream, T &dep_stream, int64_t offset, ReduceKernel reduce_kernel,
+                      size_t element_size, WireFormat wire_format) {
   TIMELINE("stream_reduce_add");
-  int64_t left = stream->Size() - stream->progress;
-  if (left >= HOPLITE_MULTITHREAD_REDUCE_SIZE) {
-    return stream_reduce_add_multi_thread<T, DT>(conn_fd, stream, dep_stream, offset);
+  int64_t left = stream->Size() - stream->Progress();
+  if (ReduceEngine::Get().ShouldOverlap(left)) {
+    return stream_reduce_add_multi_thread<T>(conn_fd, stream, dep_stream, offset, reduce_kernel, element_size,
+                                             wire_format);
   } else {
-    return stream_reduce_add_single_thread<T, DT>(conn_fd, stream, dep_stream, offset);
+    return stream_reduce_add_single_thread<T>(conn_fd, stream, dep_stream, offset, reduce_kernel, element_size,
+                                              wire_format);
   }
 }
 
+StreamWindow::StreamWindow(int64_t stream_size) {
+  // wire blocks must not wrap around the ring
+  const int64_t block_size = HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float);
+  int64_t size = std::min<int64_t>(stream_size, HOPLITE_FUSED_REDUCE_WINDOW);
+  data.resize(std::max<int64_t>((size + block_size - 1) / block_size, 1) * block_size);
+}
+
+/// Receive a stream into a window of it. The receiving waits while the window is full, until
+/// the stream has consumed the bytes.
+/// \param stream The stream. Only its progress, size and reset are used.
+/// \param offset The beginning of the transfer. It is the end of the bytes in the window.
+int stream_receive_window(int conn_fd, Buffer *stream, StreamWindow *window, int64_t offset, WireFormat wire_format) {
+  TIMELINE("stream_receive_window");
+  const int64_t window_size = window->data.size();
+  // wire blocks start at the offset, and must not wrap around the ring
+  DCHECK((offset - window->base) % (HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float)) == 0);
+  int64_t receive_progress = offset;
+  std::vector<uint8_t> wire_block;
+  while (receive_progress < stream->Size() && !stream->IsReset()) {
+    // raw bytes are received a quarter of the window at a time, so the window keeps filling
+    // while the stream consumes the rest
+    int64_t end = wire_format == WireFormat::RAW
+                      ? std::min(receive_progress + std::min(window->ContiguousSize(receive_progress), window_size / 4),
+                                 stream->Size())
+                      : wire_block_end(offset, receive_progress, stream->Size());
+    // sleep until the stream makes room. the timeout bounds the delay of noticing a reset.
+    if (stream->WaitProgress(end - window_size, HOPLITE_PROGRESS_WAIT_TIMEOUT_US) < end - window_size) {
+      continue;
+    }
+    int ec = stream_receive_next_wire<Buffer>(conn_fd, stream, &receive_progress, offset, wire_format,
+                                              &wire_block, end, window->At(receive_progress));
+    if (ec) {
+      LOG(ERROR) << "[stream_receive_window] receive error (receive_progress=" << receive_progress << ")";
+      return ec;
+    }
+    window->received.Store(receive_progress);
+  }
+  return 0;
+}
+
+/// reduce(conn, window, local_object) -> stream, where the bytes of the stream are reduced with
+/// both inputs while they are in cache.
+/// \param local_object The local object, or nullptr if the node has none.
+int stream_reduce_add_fused(int conn_fd, Buffer *stream, StreamWindow *window, Buffer *local_object, int64_t offset,
+                            ReduceKernel reduce_kernel, size_t element_size, WireFormat wire_format) {
+  TIMELINE("stream_reduce_add_fused");
+  LOG(DEBUG) << "stream_reduce_add_fused(), offset=" << offset;
+  // the bytes received from the connection, which are ahead of the reduced progress of the stream
+  ProgressCounter received(offset);
+  uint8_t *data_ptr = stream->MutableData();
+  std::atomic<bool> failed(false);
+
+  std::thread t([&]() {
+    // a multiple of every element size, small enough to stay in cache between the two kernels
+    constexpr int64_t kPieceSize = 64 << 10;
+    while (!stream->IsFinished() && !stream->IsReset() && !failed) {
+      int64_t progress = stream->Progress();
+      int64_t target = progress + element_size;
+      // sleep until all inputs have new elements. the timeouts bound the delay of noticing a reset.
+      int64_t ready = received.Wait(target, HOPLITE_PROGRESS_WAIT_TIMEOUT_US);
+      ready = std::min(ready, window->received.Wait(target, HOPLITE_PROGRESS_WAIT_TIMEOUT_US));
+      if (local_object) {
+        ready = std::min(ready, local_object->WaitProgress(target, HOPLITE_PROGRESS_WAIT_TIMEOUT_US));
+      }
+      if (ready < target) {
+        continue;
+      }
+      int64_t end = progress + (ready - progress) / element_size * element_size;
+      ReduceEngine::Get().ParallelFor(end - progress, element_size, [&](int64_t chunk_begin, int64_t chunk_end) {
+        for (int64_t begin = progress + chunk_begin; begin < progress + chunk_end;) {
+          int64_t size = std::min(std::min(progress + chunk_end - begin, kPieceSize), window->ContiguousSize(begin));
+          reduce_kernel(data_ptr + begin, window->At(begin), size / element_size);
+          if (local_object) {
+            reduce_kernel(data_ptr + begin, local_object->Data() + begin, size / element_size);
+          }
+          begin += size;
+        }
+      });
+      // publishing the progress makes room in the window
+      stream->AdvanceProgress(end - progress);
+    }
+  });
+
+  int64_t receive_progress = offset;
+  const int64_t object_size = stream->Size();
+  std::vector<uint8_t> wire_block;
+  auto start = std::chrono::steady_clock::now();
+  while (receive_progress < object_size && !stream->IsReset()) {
+    int status = stream_receive_next_wire<Buffer>(conn_fd, stream, &receive_progress, offset, wire_format,
+                                                  &wire_block);
+    if (status) {
+      failed = true;
+      received.Interrupt();
+      t.join();
+      // return the error
+      return status;
+    }
+    received.Store(receive_progress);
+  }
+  // the receiving does not wait for the reducing here, so it measures the link
+  ReduceEngine::Get().RecordLink(receive_progress - offset,
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  // let the reducer re-check the reset flag in case the loop was interrupted
+  received.Interrupt();
+  t.join();
+  return 0;
+}
+
 Receiver::Receiver(ObjectStoreState &state, GlobalControlStoreClient &gcs_client, LocalStoreClient &local_store_client,
                    const std::string &my_address, int port)
     : state_(state), gcs_client_(gcs_client), my_address_(my_address), local_store_client_(local_store_client),
+      n_stripes_(std::max<int64_t>(get_config_from_env("HOPLITE_TRANSFER_STRIPES", HOPLITE_TRANSFER_STRIPES), 1)),
+      n_swarm_sources_(std::max<int64_t>(get_config_from_env("HOPLITE_SWARM_SOURCES", HOPLITE_SWARM_SOURCES), 1)),
+      compression_(get_config_from_env("HOPLITE_WIRE_COMPRESSION", HOPLITE_WIRE_COMPRESSION) != 0),
+      // keep the connections of all stripes for the next transfer
+      connection_pool_(HOPLITE_SENDER_PORT, std::max<int64_t>(HOPLITE_MAX_IDLE_CONNECTIONS_PER_PEER, n_stripes_)),
+#ifdef HOPLITE_ENABLE_CROSS_MEMORY_ATTACH
+      cross_memory_attach_(true),
+#else
+      cross_memory_attach_(false),
+#endif
       pool_(HOPLITE_MAX_INFLOW_CONCURRENCY) {}
 
+void Receiver::prewarm_connections(const std::vector<std::string> &ip_addresses) {
+  connection_pool_.Prewarm(ip_addresses);
+}
+
 bool Receiver::check_and_store_inband_data(const ObjectID &object_id, int64_t object_size,
                                            const std::string &inband_data) {
   TIMELINE("Receiver::check_and_store_inband_data");
@@ -182,7 +535,8 @@ bool Receiver::check_and_store_inband_data(const ObjectID &object_id, int64_t ob
     DCHECK(inband_data.size() <= inband_data_size_limit) << "unexpected inband data size";
     DCHECK(inband_data.size() == object_size) << "inband data size is different from object size";
     std::shared_ptr<Buffer> data;
-    local_store_client_.Create(object_id, object_size, &data);
+    // the buffer may have been created by the caller, e.g. in a gathered buffer
+    local_store_client_.GetBufferOrCreate(object_id, object_size, &data);
     data->CopyFrom(inband_data);
     local_store_client_.Seal(object_id);
     return true;
@@ -190,14 +544,117 @@ bool Receiver::check_and_store_inband_data(const ObjectID &object_id, int64_t ob
   return false;
 }
 
-int Receiver::receive_object(const std::string &sender_ip, int sender_port, const ObjectID &object_id, Buffer *stream) {
+int Receiver::receive_range(const std::string &sender_ip, const ObjectID &object_id, Buffer *stream, int conn_fd,
+                            StripedProgress *striped, size_t range) {
+  TIMELINE(std::string("Receiver::receive_range() ") + object_id.ToString());
+  if (conn_fd < 0) {
+    int ec = connection_pool_.Acquire(sender_ip, &conn_fd);
+    if (ec) {
+      LOG(ERROR) << "Failed to connect to sender (ip=" << sender_ip << ").";
+      return ec;
+    }
+  }
+  const int64_t end = striped->End(range);
+  ObjectWriterRequest req;
+  auto ro_request = new ReceiveObjectRequest();
+  ro_request->set_object_id(object_id.Binary());
+  ro_request->set_object_size(stream->Size());
+  ro_request->set_offset(striped->Begin(range));
+  ro_request->set_end(end);
+  ro_request->set_compressed(compression_);
+  req.set_allocated_receive_object(ro_request);
+  SendProtobufMessage(conn_fd, req);
+#ifdef HOPLITE_ENABLE_NONBLOCKING_SOCKET_RECV
+  DCHECK(fcntl(conn_fd, F_SETFL, fcntl(conn_fd, F_GETFL) | O_NONBLOCK) >= 0)
+      << "Cannot enable non-blocking for the socket (errno = " << errno << ").";
+#endif
+  int ec = 0;
+  int64_t receive_progress = striped->Begin(range);
+  while (receive_progress < end && !stream->IsReset()) {
+    if (compression_) {
+      ec = stream_receive_next_compressed(conn_fd, stream, &receive_progress, end);
+    } else {
+      ec = stream_receive_next<Buffer>(conn_fd, stream, &receive_progress, end);
+    }
+    if (ec) {
+      LOG(ERROR) << "[receive_range] socket receive error (" << strerror(errno) << ", code=" << errno
+                 << ", receive_progress=" << receive_progress << ", end=" << end << ")";
+      break;
+    }
+    striped->Update(range, receive_progress);
+  }
+  if (!ec && receive_progress == end) {
+    connection_pool_.Release(sender_ip, conn_fd);
+  } else {
+    connection_pool_.Discard(conn_fd);
+  }
+  return ec;
+}
+
+int Receiver::receive_object_ranges(const std::vector<std::string> &sender_ips, const ObjectID &object_id,
+                                    Buffer *stream, int conn_fd) {
+  // 64-byte boundaries keep the ranges aligned for every element type, and compressed ranges
+  // are made of whole chunks
+  const int64_t alignment = compression_ ? HOPLITE_COMPRESSION_CHUNK_SIZE : 64;
+  StripedProgress striped(stream,
+                          StripedProgress::Split(stream->Progress(), stream->Size(), sender_ips.size(), alignment));
+  LOG(DEBUG) << "receive " << object_id.ToString() << " in " << striped.Size() << " ranges";
+  std::vector<int> error_codes(striped.Size(), 0);
+  std::vector<std::thread> range_threads;
+  for (size_t range = 1; range < striped.Size(); range++) {
+    range_threads.emplace_back([this, &sender_ips, &object_id, stream, &striped, &error_codes, range]() {
+      error_codes[range] = receive_range(sender_ips[range], object_id, stream, -1, &striped, range);
+    });
+  }
+  // the first range uses the connection that we have
+  error_codes[0] = receive_range(sender_ips[0], object_id, stream, conn_fd, &striped, 0);
+  for (auto &t : range_threads) {
+    t.join();
+  }
+  // the contiguous prefix stays received, and the retry resumes from there
+  if (error_codes[0]) {
+    return error_codes[0];
+  }
+  for (size_t range = 1; range < error_codes.size(); range++) {
+    if (error_codes[range]) {
+      return sender_ips[range] == sender_ips[0] ? error_codes[range] : kExtraSenderFailed;
+    }
+  }
+  return 0;
+}
+
+int Receiver::receive_object(const std::string &sender_ip, const ObjectID &object_id, Buffer *stream,
+                             const std::vector<std::string> &extra_sender_ips) {
   TIMELINE(std::string("Receiver::receive_object() ") + object_id.ToString());
   LOG(DEBUG) << "start receiving object " << object_id.ToString() << " from " << sender_ip
-             << ", size = " << stream->Size() << ", intial_progress=" << stream->progress;
+             << ", size = " << stream->Size() << ", intial_progress=" << stream->Progress();
   int conn_fd;
-  int ec = tcp_connect(sender_ip, sender_port, &conn_fd);
+  int ec = connection_pool_.Acquire(sender_ip, &conn_fd);
   if (ec) {
-    LOG(ERROR) << "Failed to connect to sender (ip=" << sender_ip << ", port=" << sender_port << ").";
+    LOG(ERROR) << "Failed to connect to sender (ip=" << sender_ip << ").";
+    return ec;
+  }
+
+  // the pool knows whether the sender is on this host once we are connected
+  const bool read_memory = cross_memory_attach_ && connection_pool_.IsLocal(sender_ip);
+  const int64_t remaining_size = stream->Size() - stream->Progress();
+  std::vector<std::string> sender_ips;
+  if (!read_memory && !extra_sender_ips.empty() && remaining_size >= HOPLITE_SWARM_MIN_SIZE) {
+    sender_ips.push_back(sender_ip);
+    for (const auto &extra_sender_ip : extra_sender_ips) {
+      if (extra_sender_ip != my_address_ && extra_sender_ip != sender_ip) {
+        sender_ips.push_back(extra_sender_ip);
+      }
+    }
+  } else if (!read_memory && n_stripes_ > 1 && remaining_size >= HOPLITE_STRIPE_MIN_SIZE) {
+    sender_ips.assign(n_stripes_, sender_ip);
+  }
+  if (sender_ips.size() > 1) {
+    ec = receive_object_ranges(sender_ips, object_id, stream, conn_fd);
+    LOG(DEBUG) << "receive " << object_id.ToString() << " done, error_code=" << ec;
+    if (stream->IsFinished()) {
+      gcs_client_.WriteLocation(object_id, my_address_, true, stream->Size(), stream->Data());
+    }
     return ec;
   }
 
@@ -206,7 +663,9 @@ int Receiver::receive_object(const std::string &sender_ip, int sender_port, cons
   auto ro_request = new ReceiveObjectRequest();
   ro_request->set_object_id(object_id.Binary());
   ro_request->set_object_size(stream->Size());
-  ro_request->set_offset(stream->progress);
+  ro_request->set_offset(stream->Progress());
+  ro_request->set_read_memory(read_memory);
+  ro_request->set_compressed(compression_ && !read_memory);
   req.set_allocated_receive_object(ro_request);
   SendProtobufMessage(conn_fd, req);
 
@@ -215,17 +674,111 @@ int Receiver::receive_object(const std::string &sender_ip, int sender_port, cons
   DCHECK(fcntl(conn_fd, F_SETFL, fcntl(conn_fd, F_GETFL) | O_NONBLOCK) >= 0)
       << "Cannot enable non-blocking for the socket (errno = " << errno << ").";
 #endif
-  ec = stream_receive<Buffer>(conn_fd, stream, stream->progress);
+  if (read_memory) {
+    ec = copy_from_local_sender(conn_fd, stream);
+    if (ec == kCrossMemoryDenied) {
+      LOG(WARNING) << "Cannot read the memory of the local senders. Their objects are streamed from now on.";
+      cross_memory_attach_ = false;
+      connection_pool_.Discard(conn_fd);
+      return receive_object(sender_ip, object_id, stream);
+    }
+  } else if (compression_) {
+    ec = stream_receive_compressed(conn_fd, stream, stream->Progress());
+  } else {
+    ec = stream_receive<Buffer>(conn_fd, stream, stream->Progress());
+  }
   LOG(DEBUG) << "receive " << object_id.ToString() << " done, error_code=" << ec;
-  close(conn_fd);
+  if (!ec && stream->IsFinished()) {
+    connection_pool_.Release(sender_ip, conn_fd);
+  } else {
+    connection_pool_.Discard(conn_fd);
+  }
   if (stream->IsFinished()) {
     gcs_client_.WriteLocation(object_id, my_address_, true, stream->Size(), stream->Data());
   }
   return ec;
 }
 
+int Receiver::copy_from_local_sender(int conn_fd, Buffer *stream) {
+  TIMELINE("Receiver::copy_from_local_sender");
+  uint8_t header[sizeof(int64_t) + sizeof(uint64_t)];
+  int ec = recv_frame(conn_fd, header, sizeof(header), stream);
+  if (ec) {
+    return ec < 0 ? ec : 0;
+  }
+  int64_t pid;
+  uint64_t address;
+  std::memcpy(&pid, header, sizeof(pid));
+  std::memcpy(&address, header + sizeof(pid), sizeof(address));
+  // the kernel translates the pid of the peer into our pid namespace (0 if it is not visible).
+  // the pid of the sender means nothing to us if they differ.
+  struct ucred peer;
+  socklen_t peer_size = sizeof(peer);
+  if (getsockopt(conn_fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) != 0 || peer.pid != pid) {
+    return kCrossMemoryDenied;
+  }
+
+  int64_t copied = stream->Progress();
+  const int64_t object_size = stream->Size();
+  while (copied < object_size && !stream->IsReset()) {
+    int64_t progress;
+    ec = recv_frame(conn_fd, (uint8_t *)&progress, sizeof(progress), stream);
+    if (ec) {
+      return ec < 0 ? ec : 0;
+    }
+    DCHECK(progress <= object_size) << "The progress of the sender exceeds the object size.";
+    while (copied < progress) {
+      // copy in blocks, so that the readers of the stream can start early
+      int64_t copy_size = std::min(progress - copied, STREAM_MAX_BLOCK_SIZE);
+      struct iovec local_iov = {stream->MutableData() + copied, (size_t)copy_size};
+      struct iovec remote_iov = {(void *)(address + copied), (size_t)copy_size};
+      ssize_t bytes_copied = process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0);
+      if (bytes_copied < 0) {
+        if (errno == EPERM || errno == ENOSYS) {
+          return kCrossMemoryDenied;
+        }
+        LOG(ERROR) << "[copy_from_local_sender] process_vm_readv error (" << strerror(errno) << ", code=" << errno
+                   << ")";
+        return -1;
+      } else if (bytes_copied == 0) {
+        LOG(ERROR) << "[copy_from_local_sender] 0 bytes copied";
+        return -1;
+      }
+      copied += bytes_copied;
+      stream->SetProgress(copied);
+    }
+  }
+  if (copied == object_size) {
+    // the sender keeps the object until we are done with it
+    uint8_t ack = 1;
+    if (send_all(conn_fd, &ack, sizeof(ack))) {
+      LOG(ERROR) << "[copy_from_local_sender] cannot acknowledge the copy";
+      return -1;
+    }
+  }
+  return 0;
+}
+
 void Receiver::pull_object(const ObjectID &object_id) {
-  SyncReply reply = gcs_client_.GetLocationSync(object_id, true, my_address_);
+  pull_object(object_id, gcs_client_.GetLocationSync(object_id, true, my_address_, max_extra_senders()));
+}
+
+void Receiver::pull_objects(const std::vector<ObjectID> &object_ids, const std::vector<SyncReply> &locations) {
+  TIMELINE("Receiver::pull_objects");
+  DCHECK(object_ids.size() == locations.size()) << "Every object needs a location.";
+  std::vector<std::future<void>> pulls;
+  for (size_t i = 0; i < object_ids.size(); i++) {
+    const ObjectID &object_id = object_ids[i];
+    const SyncReply &location = locations[i];
+    // the pool bounds the number of concurrent pulls by the inflow concurrency
+    pulls.push_back(pool_.push([this, &object_id, &location](int id) { pull_object(object_id, location); }));
+  }
+  for (auto &pull : pulls) {
+    pull.get();
+  }
+}
+
+void Receiver::pull_object(const ObjectID &object_id, SyncReply reply) {
   if (!check_and_store_inband_data(object_id, reply.object_size, reply.inband_data)) {
     // prepare object buffer for receiving.
     std::shared_ptr<Buffer> stream;
@@ -234,6 +787,8 @@ void Receiver::pull_object(const ObjectID &object_id) {
                          << ", status = " << pstatus.ToString();
     LOG(DEBUG) << "Created buffer for " << object_id.ToString() << ", size=" << reply.object_size;
     std::string sender_ip = reply.sender_ip;
+    // the other holders only help with the first attempt. retries go to the sender alone.
+    std::vector<std::string> extra_sender_ips = std::move(reply.extra_sender_ips);
     // ---------------------------------------------------------------------------------------------
     // Here is our fault tolerance logic for multicast.
     // If the sender failed during sending the object, we retry with another sender that already has
@@ -244,8 +799,13 @@ void Receiver::pull_object(const ObjectID &object_id) {
     // ---------------------------------------------------------------------------------------------
     while (!stream->IsFinished()) {
       LOG(DEBUG) << "Try receiving " << object_id.ToString() << " from " << sender_ip << ", size=" << reply.object_size;
-      int ec = receive_object(sender_ip, HOPLITE_SENDER_PORT, object_id, stream.get());
-      if (ec) {
+      int ec = receive_object(sender_ip, object_id, stream.get(), extra_sender_ips);
+      extra_sender_ips.clear();
+      if (ec == kExtraSenderFailed) {
+        // the sender is fine, so we continue with it from the received prefix
+        LOG(WARNING) << "Failed to receive " << object_id.ToString() << " from other holders. Continue with "
+                     << sender_ip;
+      } else if (ec) {
         LOG(ERROR) << "Failed to receive " << object_id.ToString() << " from sender " << sender_ip;
         bool success = gcs_client_.HandlePullObjectFailure(object_id, my_address_, &sender_ip);
         if (!success) {
@@ -260,32 +820,20 @@ void Receiver::pull_object(const ObjectID &object_id) {
   }
 }
 
-int ReduceReceiverTask::receive_reduced_object(const std::string &sender_ip, int sender_port, bool is_left_child) {
+int ReduceReceiverTask::receive_reduced_object(const std::string &sender_ip, bool is_left_child) {
   TIMELINE(std::string("Receiver::receive_reduced_object() ") + reduction_id_.ToString());
-  Buffer *stream;
-  bool work_on_target_stream = true;
-  bool is_sender_leaf;
-  if (is_left_child) {
-    is_sender_leaf = this->is_left_sender_leaf;
-    if (!is_tree_branch_) {
-      // directly reduced to the target stream
-      stream = target_stream.get();
-    } else {
-      // reduced to the left stream temporarily, and the right child thread will reduce it to the target stream
-      stream = left_stream.get();
-      work_on_target_stream = false;
-    }
-  } else {
-    is_sender_leaf = this->is_right_sender_leaf;
-    // directly reduced to the target stream
-    stream = target_stream.get();
-  }
+  Buffer *stream = target_stream.get();
+  const bool is_sender_leaf = is_left_child ? this->is_left_sender_leaf : this->is_right_sender_leaf;
+  // the left child of a tree branch is received into the window, and the right child thread
+  // reduces it into the target stream together with the right child
+  const bool to_window = is_left_child && is_tree_branch_;
+  const int64_t offset = to_window ? left_window->received.Load() : stream->Progress();
   LOG(DEBUG) << "start receiving object " << reduction_id_.ToString() << " from " << sender_ip
-             << ", size = " << stream->Size() << ", intial_progress=" << stream->progress;
+             << ", size = " << stream->Size() << ", intial_progress=" << offset;
   int conn_fd;
-  int ec = tcp_connect(sender_ip, sender_port, &conn_fd);
+  int ec = connection_pool_.Acquire(sender_ip, &conn_fd);
   if (ec) {
-    LOG(ERROR) << "Failed to connect to sender (ip=" << sender_ip << ", port=" << sender_port << ").";
+    LOG(ERROR) << "Failed to connect to sender (ip=" << sender_ip << ").";
     return ec;
   }
   // send request
@@ -294,13 +842,17 @@ int ReduceReceiverTask::receive_reduced_object(const std::string &sender_ip, int
     auto ro_request = new ReceiveObjectRequest();
     ro_request->set_object_id(is_left_child ? this->left_sender_object.Binary() : this->right_sender_object.Binary());
     ro_request->set_object_size(stream->Size());
-    ro_request->set_offset(stream->progress);
+    ro_request->set_offset(offset);
+    ro_request->mutable_quantization()->set_format(static_cast<objectstore::WireFormat>(quantization_.format));
+    ro_request->mutable_quantization()->set_error_feedback_id(quantization_.error_feedback_id);
     req.set_allocated_receive_object(ro_request);
   } else {
     auto ro_request = new ReceiveReducedObjectRequest();
     ro_request->set_reduction_id(reduction_id_.Binary());
     ro_request->set_object_size(stream->Size());
-    ro_request->set_offset(stream->progress);
+    ro_request->set_offset(offset);
+    ro_request->mutable_quantization()->set_format(static_cast<objectstore::WireFormat>(quantization_.format));
+    ro_request->mutable_quantization()->set_error_feedback_id(quantization_.error_feedback_id);
     req.set_allocated_receive_reduced_object(ro_request);
   }
   SendProtobufMessage(conn_fd, req);
@@ -309,19 +861,29 @@ int ReduceReceiverTask::receive_reduced_object(const std::string &sender_ip, int
   DCHECK(fcntl(conn_fd, F_SETFL, fcntl(conn_fd, F_GETFL) | O_NONBLOCK) >= 0)
       << "Cannot enable non-blocking for the socket (errno = " << errno << ").";
 #endif
-  if (is_left_child) {
-    if (!local_object) {
-      // no local object, so we only need to receive from the sender
-      ec = stream_receive<Buffer>(conn_fd, stream, stream->progress);
-    } else {
-      ec = stream_reduce_add<Buffer, float>(conn_fd, stream, *local_object, stream->progress);
-    }
+  if (to_window) {
+    ec = stream_receive_window(conn_fd, stream, left_window.get(), offset, quantization_.format);
+  } else if (!is_left_child) {
+    ec = stream_reduce_add_fused(conn_fd, stream, left_window.get(), local_object.get(), offset, reduce_kernel_,
+                                 element_size_, quantization_.format);
+  } else if (!local_object) {
+    // no local object, so we only need to receive from the sender
+    ec = stream_receive<Buffer>(conn_fd, stream, offset, quantization_.format);
+  } else if (quantization_.format == WireFormat::SPARSE && reduce_op_ == ReduceOp::SUM) {
+    ec = stream_reduce_add_sparse<Buffer>(conn_fd, stream, *local_object, offset, reduce_kernel_, element_size_);
   } else {
-    ec = stream_reduce_add<Buffer, float>(conn_fd, stream, *left_stream, stream->progress);
+    ec = stream_reduce_add<Buffer>(conn_fd, stream, *local_object, offset, reduce_kernel_, element_size_,
+                                   quantization_.format);
   }
   LOG(DEBUG) << "receive " << reduction_id_.ToString() << " from " << sender_ip << " done, error_code=" << ec;
-  close(conn_fd);
-  if (!ec && work_on_target_stream && target_stream->IsFinished() && local_task_) {
+  const bool received_all = to_window ? left_window->received.Load() >= stream->Size() : stream->IsFinished();
+  // an interrupted transfer leaves unread bytes in the connection
+  if (!ec && received_all) {
+    connection_pool_.Release(sender_ip, conn_fd);
+  } else {
+    connection_pool_.Discard(conn_fd);
+  }
+  if (!ec && !to_window && target_stream->IsFinished() && local_task_) {
     LOG(DEBUG) << "Notify " << reduction_id_.ToString() << " is finished.";
     local_task_->NotifyFinished();
   }
@@ -330,7 +892,7 @@ int ReduceReceiverTask::receive_reduced_object(const std::string &sender_ip, int
 
 void ReduceReceiverTask::start_recv(bool is_left_child) {
   auto func = [this, is_left_child](std::string sender_ip) {
-    int ec = receive_reduced_object(sender_ip, HOPLITE_SENDER_PORT, /*is_left_child=*/is_left_child);
+    int ec = receive_reduced_object(sender_ip, /*is_left_child=*/is_left_child);
     if (ec) {
       LOG(ERROR) << "Failed to receive object for reduce from sender " << sender_ip;
       // this gRPC call must be non-blocking and executed by another thread
@@ -346,13 +908,10 @@ void ReduceReceiverTask::start_recv(bool is_left_child) {
   }
 }
 
-void ReduceReceiverTask::reset_progress(bool is_left_child) {
+void ReduceReceiverTask::reset_progress() {
   TIMELINE("ReduceReceiverTask::reset_progress");
-  // target stream is required to reset anyway
-  target_stream->reset = true;
-  if (left_stream) {
-    left_stream->reset = true;
-  }
+  // target stream is required to reset anyway. it interrupts the left window as well.
+  target_stream->RequestReset();
   // clean up previous threads
   if (right_recv_thread_.joinable()) {
     right_recv_thread_.join();
@@ -361,27 +920,28 @@ void ReduceReceiverTask::reset_progress(bool is_left_child) {
     left_recv_thread_.join();
   }
   // target stream is required to reset anyway
-  target_stream->progress = 0;
-  if (is_left_child && is_tree_branch_) {
-    // the left sender first reduces it to the left stream, so both stream needs to be reset
-    left_stream->progress = 0;
-  }
-  target_stream->reset = false;
-  if (left_stream) {
-    left_stream->reset = false;
+  target_stream->SetProgress(0);
+  if (left_window) {
+    // the window only holds what the target stream has not consumed, so the left child starts
+    // over as well, whichever child has failed
+    left_window->received.Store(0);
+    left_window->base = 0;
   }
+  target_stream->ClearReset();
 }
 
 void Receiver::receive_and_reduce_object(const ObjectID &reduction_id, bool is_tree_branch,
                                          const std::string &sender_ip, bool from_left_child, int64_t object_size,
                                          const ObjectID &object_id_to_reduce, const ObjectID &object_id_to_pull,
-                                         bool is_sender_leaf, bool reset_progress,
+                                         bool is_sender_leaf, bool reset_progress, ReduceOp reduce_op,
+                                         ReduceDataType reduce_dtype, const WireQuantization &quantization,
                                          const std::shared_ptr<LocalReduceTask> &local_task) {
   TIMELINE("Receiver::receive_and_reduce_object() ");
   std::lock_guard<std::mutex> lock(reduce_receiver_tasks_mutex_);
   std::shared_ptr<ReduceReceiverTask> task;
   if (!reduce_receiver_tasks_.count(reduction_id)) {
-    task = std::make_shared<ReduceReceiverTask>(reduction_id, is_tree_branch, local_task, gcs_client_, my_address_);
+    task = std::make_shared<ReduceReceiverTask>(reduction_id, is_tree_branch, reduce_op, reduce_dtype, quantization,
+                                                local_task, gcs_client_, connection_pool_, my_address_);
     reduce_receiver_tasks_[reduction_id] = task;
   } else {
     task = reduce_receiver_tasks_[reduction_id];
@@ -394,12 +954,13 @@ void Receiver::receive_and_reduce_object(const ObjectID &reduction_id, bool is_t
     if (local_task) {
       Status s = local_store_client_.GetBufferOrCreate(reduction_id, object_size, &task->target_stream);
       DCHECK(s.ok());
+      local_task->SetStream(task->target_stream);
     } else {
       task->target_stream = state_.get_or_create_reduction_stream(reduction_id, object_size);
     }
   }
-  if (is_tree_branch && !task->left_stream) {
-    task->left_stream = std::make_shared<Buffer>(task->target_stream->Size());
+  if (is_tree_branch && !task->left_window) {
+    task->left_window = std::make_shared<StreamWindow>(task->target_stream->Size());
   }
   if (from_left_child) {
     task->is_left_sender_leaf = is_sender_leaf;
@@ -426,7 +987,7 @@ void Receiver::receive_and_reduce_object(const ObjectID &reduction_id, bool is_t
     task->start_recv(from_left_child);
   } else {
     // clean up previous threads
-    task->reset_progress(from_left_child);
+    task->reset_progress();
     // restart all tasks
     if (!task->left_sender_ip.empty()) {
       task->start_recv(/*is_left_child=*/true);
@@ -8,25 +8,54 @@
 
 #include "common/buffer.h"
 #include "common/id.h"
+#include "common/progress_counter.h"
+#include "common/reduce_kernels.h"
+#include "common/striped_progress.h"
+#include "common/wire_quantization.h"
 
+#include "connection_pool.h"
 #include "global_control_store.h"
 #include "local_store_client.h"
 #include "object_store.grpc.pb.h"
 #include "object_store_state.h"
 #include "util/ctpl_stl.h"
 
+/// A part of a stream held in a ring buffer. It holds the bytes of the stream from the progress
+/// of the stream on, so it only needs to be as large as the distance between its writer and the
+/// reducer of the stream.
+struct StreamWindow {
+  /// \param stream_size The size of the stream.
+  explicit StreamWindow(int64_t stream_size);
+
+  /// Where byte 'position' of the stream is in the window.
+  uint8_t *At(int64_t position) { return data.data() + (position - base) % data.size(); }
+
+  /// The number of bytes from 'position' to the end of the ring.
+  int64_t ContiguousSize(int64_t position) const { return data.size() - (position - base) % data.size(); }
+
+  std::vector<uint8_t> data;
+  // the position of the stream at the beginning of the ring
+  int64_t base = 0;
+  // the end of the bytes in the window
+  ProgressCounter received;
+};
+
 struct ReduceReceiverTask {
-  ReduceReceiverTask(const ObjectID &reduction_id, bool is_tree_branch,
-                     const std::shared_ptr<LocalReduceTask> &local_task, GlobalControlStoreClient &gcs_client,
+  ReduceReceiverTask(const ObjectID &reduction_id, bool is_tree_branch, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                     const WireQuantization &quantization, const std::shared_ptr<LocalReduceTask> &local_task,
+                     GlobalControlStoreClient &gcs_client, ConnectionPool &connection_pool,
                      const std::string &my_address)
-      : reduction_id_(reduction_id), is_tree_branch_(is_tree_branch), local_task_(local_task), gcs_client_(gcs_client),
-        my_address_(my_address) {}
+      : reduction_id_(reduction_id), is_tree_branch_(is_tree_branch), reduce_op_(reduce_op),
+        reduce_kernel_(GetReduceKernel(reduce_op, reduce_dtype)), element_size_(ReduceDataTypeSize(reduce_dtype)),
+        quantization_(quantization), local_task_(local_task), gcs_client_(gcs_client),
+        connection_pool_(connection_pool), my_address_(my_address) {}
 
-  int receive_reduced_object(const std::string &sender_ip, int sender_port, bool is_left_child);
+  int receive_reduced_object(const std::string &sender_ip, bool is_left_child);
 
   std::shared_ptr<Buffer> target_stream;
   std::shared_ptr<Buffer> local_object;
-  std::shared_ptr<Buffer> left_stream;
+  // a tree branch receives its left child here, and reduces it together with the right child
+  std::shared_ptr<StreamWindow> left_window;
   bool is_left_sender_leaf = false;
   ObjectID left_sender_object;
   bool is_right_sender_leaf = false;
@@ -36,15 +65,20 @@ struct ReduceReceiverTask {
   std::string right_sender_ip;
 
   void start_recv(bool is_left_child);
-  void reset_progress(bool is_left_child);
+  void reset_progress();
 
 private:
   ObjectID reduction_id_;
   const bool is_tree_branch_;
+  const ReduceOp reduce_op_;
+  const ReduceKernel reduce_kernel_;
+  const size_t element_size_;
+  const WireQuantization quantization_;
   std::thread left_recv_thread_;
   std::thread right_recv_thread_;
   std::shared_ptr<LocalReduceTask> local_task_;
   GlobalControlStoreClient &gcs_client_;
+  ConnectionPool &connection_pool_;
   const std::string &my_address_;
 };
 
@@ -60,28 +94,91 @@ public:
   /// \param object_id The object to pull.
   void pull_object(const ObjectID &object_id);
 
+  /// Pull an object whose location is known.
+  /// \param object_id The object to pull.
+  /// \param reply The location of the object, from 'GetLocationSync' with 'occupying' set.
+  void pull_object(const ObjectID &object_id, SyncReply reply);
+
+  /// Pull objects concurrently, up to HOPLITE_MAX_INFLOW_CONCURRENCY at a time.
+  /// \param object_ids The objects to pull. They must be distinct.
+  /// \param locations The locations of the objects, from 'GetLocationsSync' with 'occupying' set.
+  void pull_objects(const std::vector<ObjectID> &object_ids, const std::vector<SyncReply> &locations);
+
   /// \param object_id_to_reduce If IsNil, then we skip reducing the local object. This would happen on
   /// the reduce caller, where the receiver has no object to reduce.
+  /// \param reduce_op The element-wise operation of the reduction.
+  /// \param reduce_dtype The element type of the reduced objects.
+  /// \param quantization The format of the elements on the wire.
   void receive_and_reduce_object(const ObjectID &reduction_id, bool is_tree_branch, const std::string &sender_ip,
                                  bool from_left_child, int64_t object_size, const ObjectID &object_id_to_reduce,
                                  const ObjectID &object_id_to_pull, bool is_sender_leaf, bool reset_progress,
+                                 ReduceOp reduce_op, ReduceDataType reduce_dtype, const WireQuantization &quantization,
                                  const std::shared_ptr<LocalReduceTask> &local_task);
 
   void reset_reduced_object(const ObjectID &reduction_id, const std::string &new_sender_ip, bool from_left_child);
 
+  /// The number of other complete holders to ask the directory for, to pull from them together
+  /// with the sender.
+  int max_extra_senders() const { return n_swarm_sources_ - 1; }
+
+  /// Connect to the senders of other nodes ahead of the first transfer.
+  /// \param ip_addresses The addresses of the nodes.
+  void prewarm_connections(const std::vector<std::string> &ip_addresses);
+
 private:
   /// Receive object from the sender. This is a low-level function. The object receiving
   /// starts from the initial progress of the stream.
   /// \param sender_ip The IP address of the sender.
-  /// \param sender_port The port of the sender.
   /// \param object_id The ID of the object.
   /// \param stream The buffer for receiving the object.
+  /// \param extra_sender_ips Other nodes that hold the complete object. If the object is large
+  /// enough, we pull disjoint ranges of it from them together with the sender.
+  /// \return The error code. 0 means success, and 'kExtraSenderFailed' means that only the
+  /// transfers from the extra senders failed.
+  int receive_object(const std::string &sender_ip, const ObjectID &object_id, Buffer *stream,
+                     const std::vector<std::string> &extra_sender_ips = {});
+
+  /// Copy an object from the memory of a sender on the same host. The sender streams the
+  /// progress of the object, and we acknowledge the end of the copy.
+  /// \return The error code. 0 means success, and 'kCrossMemoryDenied' means that we are not
+  /// allowed to read the memory of the sender.
+  int copy_from_local_sender(int conn_fd, Buffer *stream);
+
+  /// Receive an object over parallel connections, one range of it on each.
+  /// \param sender_ips The sender of each range. The first one is the sender of the object,
+  /// and it sends the first range, so the stream keeps growing from its progress.
+  /// \param conn_fd A connection to the first sender, which carries the first range.
+  /// \return The error code. 0 means success, and 'kExtraSenderFailed' means that only ranges
+  /// after the first one failed.
+  int receive_object_ranges(const std::vector<std::string> &sender_ips, const ObjectID &object_id, Buffer *stream,
+                            int conn_fd);
+
+  /// Receive a range of an object.
+  /// \param conn_fd A connection to the sender, or -1 to acquire one. It is handed back to the
+  /// pool afterwards.
+  /// \param striped The ranges of the object.
+  /// \param range The index of the range to receive.
   /// \return The error code. 0 means success.
-  int receive_object(const std::string &sender_ip, int sender_port, const ObjectID &object_id, Buffer *stream);
+  int receive_range(const std::string &sender_ip, const ObjectID &object_id, Buffer *stream, int conn_fd,
+                    StripedProgress *striped, size_t range);
+
+  static constexpr int kCrossMemoryDenied = -2;
+  static constexpr int kExtraSenderFailed = -3;
 
   GlobalControlStoreClient &gcs_client_;
   LocalStoreClient &local_store_client_;
   ObjectStoreState &state_;
+  // the number of parallel connections for large objects
+  const int n_stripes_;
+  // the number of nodes that large objects are pulled from at once
+  const int n_swarm_sources_;
+  // whether objects are requested in compressed chunks
+  const bool compression_;
+  // long-lived connections to the senders of other nodes
+  ConnectionPool connection_pool_;
+  // whether objects of local senders are copied from their memory. it is disabled for good
+  // once the kernel denies it.
+  std::atomic<bool> cross_memory_attach_;
 
   const std::string &my_address_;
   struct sockaddr_in address_;
@@ -0,0 +1,256 @@
+#include "shared_object_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/logging.h"
+
+namespace {
+
+enum SlotState : uint32_t {
+  // never used, which ends the probe sequence of lookups
+  kEmpty = 0,
+  // claimed by a process that is filling it
+  kBusy = 1,
+  kReady = 2,
+  // released, and can be claimed again
+  kDeleted = 3,
+  // removed from the index while processes still map the object. lookups skip it, and the last
+  // reference releases it.
+  kRemoved = 4,
+};
+
+} // namespace
+
+struct SharedObjectStore::Slot {
+  std::atomic<uint32_t> state;
+  // the number of processes that map the object. the slot is released when it drops to 0.
+  std::atomic<int32_t> references;
+  int64_t size;
+  // the file of the object is named after the process that created it
+  int32_t pid;
+  uint32_t segment_index;
+  uint8_t object_id[kUniqueIDSize];
+};
+
+struct SharedObjectStore::Segment {
+  // keeps the index mapped while the segment is in use
+  std::shared_ptr<SharedObjectStore> store;
+  uint8_t *addr;
+  int64_t size;
+  int32_t pid;
+  uint32_t index;
+  // the slot of the object in the index, or -1 if it is not published
+  int64_t slot;
+  // created by this process
+  bool owner;
+};
+
+std::shared_ptr<SharedObjectStore> SharedObjectStore::Open(const std::string &name, int64_t n_slots) {
+  std::string path = "/dev/shm/hoplite-" + name + "-index";
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open the shared object index " << path << " (" << strerror(errno) << ").";
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  // the first process sizes the index; the files of tmpfs are zero-filled, i.e. empty slots
+  if (st.st_size < (off_t)(n_slots * sizeof(Slot)) && ftruncate(fd, n_slots * sizeof(Slot)) != 0) {
+    LOG(ERROR) << "Cannot resize the shared object index " << path << " (" << strerror(errno) << ").";
+    close(fd);
+    return nullptr;
+  }
+  n_slots = std::max<int64_t>(n_slots, st.st_size / sizeof(Slot));
+  void *slots = mmap(nullptr, n_slots * sizeof(Slot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (slots == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map the shared object index " << path << " (" << strerror(errno) << ").";
+    return nullptr;
+  }
+  return std::shared_ptr<SharedObjectStore>(new SharedObjectStore(name, (Slot *)slots, n_slots));
+}
+
+SharedObjectStore::SharedObjectStore(const std::string &name, Slot *slots, int64_t n_slots)
+    : name_(name), slots_(slots), n_slots_(n_slots), segment_index_(0) {}
+
+SharedObjectStore::~SharedObjectStore() { munmap(slots_, n_slots_ * sizeof(Slot)); }
+
+std::string SharedObjectStore::segment_path(int32_t pid, uint32_t index) const {
+  return "/dev/shm/hoplite-" + name_ + "-" + std::to_string(pid) + "-" + std::to_string(index);
+}
+
+std::shared_ptr<Buffer> SharedObjectStore::map_segment(Segment *segment, bool create) {
+  std::string path = segment_path(segment->pid, segment->index);
+  int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC), 0600);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open shared object " << path << " (" << strerror(errno) << ").";
+    return nullptr;
+  }
+  if (create && ftruncate(fd, segment->size) != 0) {
+    LOG(ERROR) << "Cannot allocate shared object " << path << " (" << strerror(errno) << ").";
+    close(fd);
+    unlink(path.c_str());
+    return nullptr;
+  }
+  // the creator fills the object in place; other processes map it privately, so they share the
+  // pages for reading, and their writes (if any) never reach the other processes
+  void *addr = mmap(nullptr, segment->size, PROT_READ | PROT_WRITE,
+                    create ? (MAP_SHARED | MAP_POPULATE) : MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map shared object " << path << " (" << strerror(errno) << ").";
+    if (create) {
+      unlink(path.c_str());
+    }
+    return nullptr;
+  }
+  segment->addr = (uint8_t *)addr;
+  return std::make_shared<Buffer>(segment->addr, segment->size, release_segment_callback, segment);
+}
+
+std::shared_ptr<Buffer> SharedObjectStore::Create(int64_t size) {
+  TIMELINE("SharedObjectStore::Create");
+  if (size <= 0) {
+    return nullptr;
+  }
+  Segment *segment = new Segment{shared_from_this(), nullptr, size, (int32_t)getpid(), segment_index_++, -1, true};
+  std::shared_ptr<Buffer> buffer = map_segment(segment, true);
+  if (!buffer) {
+    delete segment;
+    return nullptr;
+  }
+  buffer->SetProgress(0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  created_segments_[segment->addr] = segment;
+  return buffer;
+}
+
+void SharedObjectStore::Publish(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer) {
+  DCHECK(buffer->IsFinished()) << "Publishing an unfinished buffer.";
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto search = created_segments_.find(buffer->Data());
+  if (search == created_segments_.end() || search->second->slot >= 0) {
+    return;
+  }
+  Segment *segment = search->second;
+  const int64_t start = object_id.Hash() % n_slots_;
+  for (int64_t i = 0; i < n_slots_; i++) {
+    int64_t slot_index = (start + i) % n_slots_;
+    Slot &slot = slots_[slot_index];
+    uint32_t state = slot.state.load(std::memory_order_acquire);
+    if (state == kReady && std::memcmp(slot.object_id, object_id.Data(), kUniqueIDSize) == 0) {
+      // an older object with the same ID, e.g. one that was deleted before the ID was put again.
+      // the processes that map it keep it, and lookups find ours.
+      slot.state.compare_exchange_strong(state, kRemoved);
+      continue;
+    }
+    if ((state == kEmpty || state == kDeleted) && slot.state.compare_exchange_strong(state, kBusy)) {
+      std::memcpy(slot.object_id, object_id.Data(), kUniqueIDSize);
+      slot.size = segment->size;
+      slot.pid = segment->pid;
+      slot.segment_index = segment->index;
+      // the reference of this process
+      slot.references.store(1);
+      slot.state.store(kReady, std::memory_order_release);
+      segment->slot = slot_index;
+      LOG(DEBUG) << "Shared " << object_id.ToString() << " in slot " << slot_index;
+      return;
+    }
+  }
+  LOG(WARNING) << "The shared object index is full. " << object_id.ToString() << " is not shared.";
+}
+
+void SharedObjectStore::Remove(const ObjectID &object_id) {
+  const int64_t start = object_id.Hash() % n_slots_;
+  for (int64_t i = 0; i < n_slots_; i++) {
+    Slot &slot = slots_[(start + i) % n_slots_];
+    uint32_t state = slot.state.load(std::memory_order_acquire);
+    if (state == kEmpty) {
+      return;
+    }
+    if (state == kReady && std::memcmp(slot.object_id, object_id.Data(), kUniqueIDSize) == 0 &&
+        slot.state.compare_exchange_strong(state, kRemoved)) {
+      LOG(DEBUG) << "Removed " << object_id.ToString() << " from the shared index";
+    }
+  }
+}
+
+std::shared_ptr<Buffer> SharedObjectStore::Attach(const ObjectID &object_id) {
+  const int64_t start = object_id.Hash() % n_slots_;
+  for (int64_t i = 0; i < n_slots_; i++) {
+    int64_t slot_index = (start + i) % n_slots_;
+    Slot &slot = slots_[slot_index];
+    uint32_t state = slot.state.load(std::memory_order_acquire);
+    if (state == kEmpty) {
+      break;
+    }
+    if (state != kReady || std::memcmp(slot.object_id, object_id.Data(), kUniqueIDSize) != 0) {
+      continue;
+    }
+    // take a reference, unless the last one has been dropped
+    int32_t references = slot.references.load();
+    while (references > 0 && !slot.references.compare_exchange_weak(references, references + 1)) {
+    }
+    if (references <= 0) {
+      continue;
+    }
+    // the slot could have been released and claimed for another object meanwhile
+    if (slot.state.load(std::memory_order_acquire) != kReady ||
+        std::memcmp(slot.object_id, object_id.Data(), kUniqueIDSize) != 0) {
+      release_slot(slot_index);
+      continue;
+    }
+    TIMELINE("SharedObjectStore::Attach");
+    Segment *segment =
+        new Segment{shared_from_this(), nullptr, slot.size, slot.pid, slot.segment_index, slot_index, false};
+    std::shared_ptr<Buffer> buffer = map_segment(segment, false);
+    if (!buffer) {
+      release_slot(slot_index);
+      delete segment;
+    }
+    return buffer;
+  }
+  return nullptr;
+}
+
+void SharedObjectStore::release_slot(int64_t slot_index) {
+  Slot &slot = slots_[slot_index];
+  if (slot.references.fetch_sub(1) == 1) {
+    unlink(segment_path(slot.pid, slot.segment_index).c_str());
+    slot.state.store(kDeleted, std::memory_order_release);
+  }
+}
+
+void SharedObjectStore::release_segment(Segment *segment) {
+  munmap(segment->addr, segment->size);
+  int64_t slot_index;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segment->owner) {
+      created_segments_.erase(segment->addr);
+    }
+    slot_index = segment->slot;
+  }
+  if (slot_index >= 0) {
+    release_slot(slot_index);
+  } else if (segment->owner) {
+    unlink(segment_path(segment->pid, segment->index).c_str());
+  }
+}
+
+void SharedObjectStore::release_segment_callback(void *context) {
+  Segment *segment = (Segment *)context;
+  // the segment may hold the last reference to the store
+  std::shared_ptr<SharedObjectStore> store = std::move(segment->store);
+  store->release_segment(segment);
+  delete segment;
+}
@@ -0,0 +1,77 @@
+#ifndef SHARED_OBJECT_STORE_H
+#define SHARED_OBJECT_STORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "common/buffer.h"
+#include "common/id.h"
+
+/// Objects shared by the processes of a host through shared memory.
+///
+/// The data of every object is a file in /dev/shm. A fixed-size hash table in another shared
+/// file indexes the finished objects of all processes that open the store with the same name,
+/// so that a process attaches to an object received by another process instead of pulling it
+/// over the network again. Attached objects are mapped without copying.
+///
+/// Every process that maps an object holds a reference in the index. The file of an object is
+/// removed when the last reference is dropped. The index itself needs no daemon: slots are
+/// claimed and released with atomic operations on the shared memory.
+class SharedObjectStore : public std::enable_shared_from_this<SharedObjectStore> {
+public:
+  /// Open (or create) the index of a host.
+  /// \param name The name of the store. Processes with the same name share objects.
+  /// \param n_slots The number of slots of the index, i.e. the maximum number of shared objects.
+  /// \return The store, or nullptr if the index cannot be mapped.
+  static std::shared_ptr<SharedObjectStore> Open(const std::string &name, int64_t n_slots);
+
+  ~SharedObjectStore();
+
+  /// Create an unfinished buffer in shared memory. It is invisible to other processes until
+  /// it is published.
+  /// \return The buffer, or nullptr if the shared memory cannot be allocated.
+  std::shared_ptr<Buffer> Create(int64_t size);
+
+  /// Make a finished buffer returned by 'Create' visible to other processes. It does nothing
+  /// for other buffers, or if the index is full. It replaces an object with the same ID that
+  /// another buffer has published.
+  void Publish(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer);
+
+  /// Remove an object from the index, e.g. because it is deleted, so that no process attaches
+  /// it anymore. The processes that map it keep their mappings, and its file is removed once
+  /// the last of them drops it.
+  void Remove(const ObjectID &object_id);
+
+  /// Map an object published by any process of the host.
+  /// \return The finished object, or nullptr if it is not shared.
+  std::shared_ptr<Buffer> Attach(const ObjectID &object_id);
+
+private:
+  struct Slot;
+  struct Segment;
+
+  SharedObjectStore(const std::string &name, Slot *slots, int64_t n_slots);
+
+  std::string segment_path(int32_t pid, uint32_t index) const;
+  std::shared_ptr<Buffer> map_segment(Segment *segment, bool create);
+  /// Drop a reference of a slot. The last reference removes the file of the object.
+  void release_slot(int64_t slot_index);
+  /// Called when a buffer of a segment is destroyed.
+  void release_segment(Segment *segment);
+  static void release_segment_callback(void *context);
+
+  const std::string name_;
+  Slot *const slots_;
+  const int64_t n_slots_;
+  std::atomic<uint32_t> segment_index_;
+
+  std::mutex mutex_;
+  // segments created by this process by the address of their memory
+  std::unordered_map<const uint8_t *, Segment *> created_segments_;
+};
+
+#endif // SHARED_OBJECT_STORE_H
@@ -0,0 +1,131 @@
+#include "spill_store.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util/logging.h"
+
+namespace {
+
+struct FileMapping {
+  void *addr;
+  size_t size;
+};
+
+void unmap_file(void *context) {
+  FileMapping *mapping = (FileMapping *)context;
+  munmap(mapping->addr, mapping->size);
+  delete mapping;
+}
+
+} // namespace
+
+SpillStore::SpillStore(const std::string &directory, SpilledCallback on_spilled)
+    : directory_(directory), on_spilled_(std::move(on_spilled)), file_index_(0) {
+  spill_thread_ = std::thread(&SpillStore::spill_loop, this);
+}
+
+SpillStore::~SpillStore() { Shutdown(); }
+
+void SpillStore::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    queue_.clear();
+  }
+  cv_.notify_all();
+  if (spill_thread_.joinable()) {
+    spill_thread_.join();
+  }
+}
+
+void SpillStore::SpillAsync(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer) {
+  DCHECK(buffer->IsFinished()) << "Spilling an unfinished buffer.";
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.emplace_back(object_id, buffer);
+  }
+  cv_.notify_one();
+}
+
+void SpillStore::spill_loop() {
+  while (true) {
+    std::pair<ObjectID, std::shared_ptr<Buffer>> item;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+      if (stopped_) {
+        return;
+      }
+      item = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    std::string path = write_file(item.first, *item.second);
+    on_spilled_(item.first, item.second, path);
+  }
+}
+
+std::string SpillStore::write_file(const ObjectID &object_id, const Buffer &buffer) {
+  TIMELINE("SpillStore::write_file");
+  // the index keeps the files of an ID that is deleted and created again apart
+  std::string path = directory_ + "/hoplite-" + std::to_string(getpid()) + "-" + object_id.Hex() + "-" +
+                     std::to_string(file_index_++);
+  int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot create spill file " << path << " (" << strerror(errno) << ").";
+    return "";
+  }
+  const uint8_t *data = buffer.Data();
+  int64_t cursor = 0;
+  while (cursor < buffer.Size()) {
+    ssize_t n = pwrite(fd, data + cursor, buffer.Size() - cursor, cursor);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      LOG(ERROR) << "Cannot write spill file " << path << " (" << strerror(errno) << ").";
+      close(fd);
+      unlink(path.c_str());
+      return "";
+    }
+    cursor += n;
+  }
+  close(fd);
+  LOG(DEBUG) << "Spilled " << object_id.ToString() << " to " << path << ", size = " << buffer.Size();
+  return path;
+}
+
+std::shared_ptr<Buffer> SpillStore::Restore(const std::string &path, int64_t size) {
+  TIMELINE("SpillStore::Restore");
+  if (size == 0) {
+    // empty files cannot be mapped
+    auto buffer = std::make_shared<Buffer>(0);
+    buffer->Seal();
+    return buffer;
+  }
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open spill file " << path << " (" << strerror(errno) << ").";
+    return nullptr;
+  }
+  // private and writable, so that writes of the reader never reach the file
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map spill file " << path << " (" << strerror(errno) << ").";
+    return nullptr;
+  }
+  // objects are read from the front to the back, so start reading ahead right away
+  madvise(addr, size, MADV_SEQUENTIAL);
+  madvise(addr, size, MADV_WILLNEED);
+  return std::make_shared<Buffer>((uint8_t *)addr, size, unmap_file, new FileMapping{addr, (size_t)size});
+}
+
+void SpillStore::Remove(const std::string &path) {
+  if (unlink(path.c_str()) != 0) {
+    LOG(WARNING) << "Cannot remove spill file " << path << " (" << strerror(errno) << ").";
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef SPILL_STORE_H
+#define SPILL_STORE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "common/buffer.h"
+#include "common/id.h"
+
+/// Writes objects evicted from the local store to files on a local disk, and maps them back
+/// when they are read again.
+///
+/// Objects are written by a background thread, so eviction never waits for the disk. Spilled
+/// objects are restored by mapping their files, so the sender serves them to remote receivers
+/// from the page cache without copying, and the kernel reads ahead of the sequential scan.
+class SpillStore {
+public:
+  /// Called by the spill thread after an object is written. The path is empty when the
+  /// object could not be written.
+  using SpilledCallback =
+      std::function<void(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer, const std::string &path)>;
+
+  /// \param directory The directory of the spill files. It must exist.
+  /// \param on_spilled Called for every object passed to 'SpillAsync'.
+  SpillStore(const std::string &directory, SpilledCallback on_spilled);
+
+  ~SpillStore();
+
+  /// Stop the spill thread. Objects that are not written yet are dropped without calling
+  /// 'on_spilled'. It returns after the object being written (if any) is reported.
+  void Shutdown();
+
+  /// Write a finished buffer to a new file in the background.
+  void SpillAsync(const ObjectID &object_id, const std::shared_ptr<Buffer> &buffer);
+
+  /// Map a spilled object. The returned buffer is finished, and unmaps the file when it is
+  /// destroyed. Pages are read ahead asynchronously.
+  /// \param path The file of the object.
+  /// \param size The size of the object.
+  /// \return The object, or nullptr if the file cannot be mapped.
+  std::shared_ptr<Buffer> Restore(const std::string &path, int64_t size);
+
+  /// Remove a spill file.
+  void Remove(const std::string &path);
+
+private:
+  void spill_loop();
+
+  std::string write_file(const ObjectID &object_id, const Buffer &buffer);
+
+  const std::string directory_;
+  const SpilledCallback on_spilled_;
+  std::atomic<int64_t> file_index_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::pair<ObjectID, std::shared_ptr<Buffer>>> queue_;
+  bool stopped_ = false;
+  std::thread spill_thread_;
+};
+
+#endif // SPILL_STORE_H
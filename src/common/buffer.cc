@@ -1,12 +1,23 @@
 #include <algorithm>
 #include <cstring>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
 #include "util/logging.h"
 #include "common/buffer.h"
+#include "common/buffer_allocator.h"
+#include "common/chunk_compression.h"
+#include "common/stream_copy.h"
 
-Buffer::Buffer(uint8_t* data_ptr, int64_t size): progress(size), data_ptr_(data_ptr), size_(size), is_data_owner_(false) {}
+Buffer::Buffer(uint8_t* data_ptr, int64_t size): data_ptr_(data_ptr), size_(size), is_data_owner_(false),
+  progress_(size), reset_(false), reset_event_fd_(-1) {}
 
-Buffer::Buffer(int64_t size): progress(0), size_(size), is_data_owner_(true) {
-  data_ptr_ = new uint8_t[size];
+Buffer::Buffer(uint8_t* data_ptr, int64_t size, BufferReleaseCallback release_callback, void *release_context)
+  : data_ptr_(data_ptr), size_(size), is_data_owner_(false), release_callback_(release_callback),
+    release_context_(release_context), progress_(size), reset_(false), reset_event_fd_(-1) {}
+
+Buffer::Buffer(int64_t size): size_(size), is_data_owner_(true), progress_(0), reset_(false), reset_event_fd_(-1) {
+  data_ptr_ = BufferAllocator::Instance().Allocate(size);
 }
 
 uint8_t* Buffer::MutableData() { return data_ptr_; }
@@ -44,6 +55,14 @@ void Buffer::StreamCopy(const Buffer &src) {
   const uint8_t *data = src.Data();
   int64_t size = src.Size();
   DCHECK(size == Size()) << "Size mismatch for copying.";
+  uint8_t *dst = MutableData();
+  if (size >= HOPLITE_PARALLEL_STREAM_COPY_THRESHOLD) {
+    // large objects do not fit in the caches anyway, so bypass them and use more memory bandwidth
+    static const int n_threads =
+        std::max(1, std::min<int>(HOPLITE_STREAM_COPY_THREADS, std::thread::hardware_concurrency()));
+    ParallelStreamCopy(dst, data, size, n_threads, HOPLITE_STREAM_COPY_CHUNK_SIZE, &progress_);
+    return;
+  }
   size_t copy_size = size / 1024;
   // trade off 'copy_size' between performance and latency
   if (copy_size < 4096) {
@@ -54,36 +73,66 @@ void Buffer::StreamCopy(const Buffer &src) {
     // align to 64
     copy_size = (copy_size >> 6) << 6;
   }
-  uint8_t *dst = MutableData();
   size_t cursor = 0;
   while (copy_size + cursor <= size) {
     memcpy(dst + cursor, data + cursor, copy_size);
-    progress += copy_size;
     cursor += copy_size;
+    progress_.Store(cursor);
   }
   memcpy(dst + cursor, data + cursor, size - cursor);
-  progress = cursor;
+  progress_.Store(size);
 }
 
 void Buffer::Wait() {
-  std::unique_lock<std::mutex> l(notification_mutex_);
-  notification_cv_.wait(l, [this]() { return IsFinished(); });
+  while (!IsFinished()) {
+    progress_.Wait(size_);
+  }
+}
+
+void Buffer::RequestReset() {
+  std::lock_guard<std::mutex> l(reset_mutex_);
+  reset_ = true;
+  progress_.Interrupt();
+  if (reset_event_fd_ >= 0) {
+    uint64_t one = 1;
+    DCHECK(write(reset_event_fd_, &one, sizeof(one)) == sizeof(one)) << "Failed to signal the reset eventfd";
+  }
 }
 
-void Buffer::NotifyFinished() {
-  std::unique_lock<std::mutex> l(notification_mutex_);
-  DCHECK(IsFinished()) << "The buffer has not been finished";
-  notification_cv_.notify_all();
+void Buffer::ClearReset() {
+  std::lock_guard<std::mutex> l(reset_mutex_);
+  reset_ = false;
+  if (reset_event_fd_ >= 0) {
+    // drain the counter so the eventfd is no longer readable
+    uint64_t count;
+    (void)read(reset_event_fd_, &count, sizeof(count));
+  }
 }
 
-void Buffer::ShrinkForLRU() {
-  delete[] data_ptr_;
-  data_ptr_ = new uint8_t[4];
-  size_ = 4;
+int Buffer::ResetEventFd() {
+  std::lock_guard<std::mutex> l(reset_mutex_);
+  if (reset_event_fd_ < 0) {
+    reset_event_fd_ = eventfd(reset_ ? 1 : 0, EFD_NONBLOCK);
+    DCHECK(reset_event_fd_ >= 0) << "Cannot create eventfd (errno = " << errno << ").";
+  }
+  return reset_event_fd_;
+}
+
+std::shared_ptr<CompressedChunks> Buffer::GetCompressedChunks() {
+  std::lock_guard<std::mutex> l(compressed_chunks_mutex_);
+  if (!compressed_chunks_) {
+    compressed_chunks_ = std::make_shared<CompressedChunks>();
+  }
+  return compressed_chunks_;
 }
 
 Buffer::~Buffer() {
   if (is_data_owner_) {
-    delete[] data_ptr_;
+    BufferAllocator::Instance().Free(data_ptr_, size_);
+  } else if (release_callback_) {
+    release_callback_(release_context_);
+  }
+  if (reset_event_fd_ >= 0) {
+    close(reset_event_fd_);
   }
 }
@@ -6,14 +6,23 @@
 #include <atomic>
 #include <vector>
 #include <mutex>
-#include <condition_variable>
 #include "common/config.h"
+#include "common/progress_counter.h"
 #include "util/hash.h"
 
+class CompressedChunks;
+
+/// Called with the registered context once a buffer no longer references external memory.
+typedef void (*BufferReleaseCallback)(void *context);
+
 class Buffer {
   public:
     Buffer(uint8_t* data_ptr, int64_t size);
     explicit Buffer(int64_t size);
+    /// Wrap memory owned by the caller without copying it. The memory is pinned until the
+    /// buffer is destroyed, and then 'release_callback' is called with 'release_context' so
+    /// that the owner can reclaim it.
+    Buffer(uint8_t* data_ptr, int64_t size, BufferReleaseCallback release_callback, void *release_context);
 
     void CopyFrom(const std::vector<uint8_t> &data);
     void CopyFrom(const uint8_t *data, size_t size);
@@ -25,25 +34,51 @@ class Buffer {
     const uint8_t* Data() const;
     int64_t Size() const;
     uint64_t Hash() const;
-    void ShrinkForLRU();
-    void Seal() { progress = size_; }
-    bool IsFinished() const { return progress >= size_; }
+    void Seal() { progress_.Store(size_); }
+    bool IsFinished() const { return progress_.Load() >= size_; }
     ~Buffer();
 
+    /// The number of bytes from the beginning of the buffer that are ready. Loading it
+    /// acquires the data written before the progress was published.
+    int64_t Progress() const { return progress_.Load(); }
+    /// Publish the progress (with release semantics) and wake up the readers waiting for it.
+    void SetProgress(int64_t progress) { progress_.Store(progress); }
+    void AdvanceProgress(int64_t bytes) { progress_.Add(bytes); }
+    /// Sleep until the progress reaches 'target', a reset is requested or the timeout expires.
+    /// \param target The progress to wait for.
+    /// \param timeout_us The timeout in microseconds. Negative means no timeout.
+    /// \return The progress observed when returning. It can be less than 'target'.
+    int64_t WaitProgress(int64_t target, int64_t timeout_us = -1) { return progress_.Wait(target, timeout_us); }
+    /// Signal 'event_fd' (an eventfd) once the progress reaches 'target'.
+    void NotifyOnProgress(int event_fd, int64_t target) { progress_.NotifyOnProgress(event_fd, target); }
+    void CancelProgressNotification(int event_fd, int64_t target) { progress_.CancelNotification(event_fd, target); }
+    /// Wait until the buffer is finished.
     void Wait();
-    void NotifyFinished();
-#ifdef HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-    std::atomic_int64_t progress;
-#else
-    volatile int64_t progress;
-#endif
-    volatile bool reset = false;
+
+    /// Interrupt the transfers into this buffer, e.g. because its sender has failed.
+    void RequestReset();
+    /// Allow transfers into this buffer again after they have observed the reset.
+    void ClearReset();
+    bool IsReset() const { return reset_; }
+    /// An eventfd which is readable while a reset is requested, so a transfer can
+    /// wait for it together with its socket. It is created on first use.
+    int ResetEventFd();
+
+    /// The compressed chunks of this buffer for the wire. They are created on first use and
+    /// live as long as the buffer.
+    std::shared_ptr<CompressedChunks> GetCompressedChunks();
   private:
     uint8_t* data_ptr_;
     int64_t size_;
     bool is_data_owner_;
-    std::mutex notification_mutex_;
-    std::condition_variable notification_cv_;
+    BufferReleaseCallback release_callback_ = nullptr;
+    void *release_context_ = nullptr;
+    ProgressCounter progress_;
+    std::atomic<bool> reset_;
+    int reset_event_fd_;
+    std::mutex reset_mutex_;
+    std::shared_ptr<CompressedChunks> compressed_chunks_;
+    std::mutex compressed_chunks_mutex_;
 };
 
 struct ObjectBuffer {
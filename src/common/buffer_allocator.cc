@@ -0,0 +1,124 @@
+#include "common/buffer_allocator.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "common/config.h"
+#include "util/logging.h"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+namespace {
+
+constexpr size_t kHugePageSize = 2 << 20;
+constexpr size_t kPageSize = 4096;
+
+size_t round_up(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+// The size class of a large allocation. Huge page granularity would waste up to half of
+// the memory of allocations that are only a few huge pages large.
+size_t mapped_size_of(int64_t size) { return round_up(size, size >= (16 << 20) ? kHugePageSize : (64 << 10)); }
+
+} // namespace
+
+BufferAllocator &BufferAllocator::Instance() {
+  // never destroyed, so buffers can be freed during static destruction
+  static BufferAllocator *instance = new BufferAllocator(
+      (HugePageMode)get_config_from_env("HOPLITE_HUGEPAGE_MODE", HOPLITE_HUGEPAGE_MODE),
+      get_config_from_env("HOPLITE_PREFAULT_BUFFERS", HOPLITE_PREFAULT_BUFFERS),
+      get_config_from_env("HOPLITE_MAX_CACHED_BUFFER_BYTES", HOPLITE_MAX_CACHED_BUFFER_BYTES));
+  return *instance;
+}
+
+BufferAllocator::BufferAllocator(HugePageMode hugepage_mode, bool prefault, int64_t max_cached_bytes)
+    : hugepage_mode_(hugepage_mode), prefault_(prefault), max_cached_bytes_(max_cached_bytes) {}
+
+BufferAllocator::~BufferAllocator() {
+  for (auto &p : free_regions_) {
+    for (uint8_t *region : p.second) {
+      munmap(region, p.first);
+    }
+  }
+}
+
+uint8_t *BufferAllocator::Allocate(int64_t size) {
+  if (size < HOPLITE_BUFFER_ARENA_MIN_SIZE) {
+    void *ptr = aligned_alloc(kAlignment, round_up(size > 0 ? size : 1, kAlignment));
+    DCHECK(ptr != nullptr) << "Failed to allocate " << size << " bytes.";
+    return (uint8_t *)ptr;
+  }
+  size_t mapped_size = mapped_size_of(size);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto search = free_regions_.find(mapped_size);
+    if (search != free_regions_.end() && !search->second.empty()) {
+      uint8_t *region = search->second.back();
+      search->second.pop_back();
+      cached_bytes_ -= mapped_size;
+      return region;
+    }
+  }
+  return map_region(mapped_size);
+}
+
+void BufferAllocator::Free(uint8_t *ptr, int64_t size) {
+  if (size < HOPLITE_BUFFER_ARENA_MIN_SIZE) {
+    free(ptr);
+    return;
+  }
+  size_t mapped_size = mapped_size_of(size);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cached_bytes_ + (int64_t)mapped_size <= max_cached_bytes_) {
+      free_regions_[mapped_size].push_back(ptr);
+      cached_bytes_ += mapped_size;
+      return;
+    }
+  }
+  munmap(ptr, mapped_size);
+}
+
+int64_t BufferAllocator::CachedBytes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cached_bytes_;
+}
+
+uint8_t *BufferAllocator::map_region(size_t mapped_size) {
+  TIMELINE("BufferAllocator::map_region");
+  if (hugepage_mode_ == HugePageMode::EXPLICIT && mapped_size % kHugePageSize == 0) {
+    void *region = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (prefault_ ? MAP_POPULATE : 0), -1, 0);
+    if (region != MAP_FAILED) {
+      return (uint8_t *)region;
+    }
+    LOG(WARNING) << "Cannot map " << mapped_size << " bytes of explicit huge pages (" << strerror(errno)
+                 << "). Falling back to transparent huge pages.";
+  }
+  // over-allocate so that the region can start at a huge page boundary
+  size_t reserved_size = mapped_size + kHugePageSize;
+  void *reserved = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved == MAP_FAILED) {
+    LOG(FATAL) << "Failed to map " << mapped_size << " bytes (" << strerror(errno) << ").";
+  }
+  uint8_t *region = (uint8_t *)round_up((uintptr_t)reserved, kHugePageSize);
+  size_t head = region - (uint8_t *)reserved;
+  if (head > 0) {
+    munmap(reserved, head);
+  }
+  munmap(region + mapped_size, reserved_size - head - mapped_size);
+  if (hugepage_mode_ != HugePageMode::NONE) {
+    // must precede the page faults to take effect
+    madvise(region, mapped_size, MADV_HUGEPAGE);
+  }
+  if (prefault_ && madvise(region, mapped_size, MADV_POPULATE_WRITE) != 0) {
+    // older kernels: fault in every page by touching it
+    for (size_t offset = 0; offset < mapped_size; offset += kPageSize) {
+      ((volatile uint8_t *)region)[offset] = 0;
+    }
+  }
+  return region;
+}
@@ -0,0 +1,65 @@
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// How large buffers are backed by huge pages.
+enum class HugePageMode : int {
+  // regular 4 KB pages
+  NONE = 0,
+  // transparent huge pages (madvise), silently falling back to regular pages
+  TRANSPARENT = 1,
+  // explicit huge pages from the hugetlbfs pool, falling back to transparent huge pages
+  EXPLICIT = 2,
+};
+
+/// The allocator behind the memory of buffers. Every allocation is aligned to
+/// 'kAlignment' bytes.
+///
+/// Large allocations are mapped with huge pages, pre-faulted when they are mapped and
+/// recycled by size class when they are freed. Iterative workloads that allocate the same
+/// sizes every iteration therefore reuse the same mapped memory, without allocator or page
+/// fault cost on the data path. Small allocations go to the system allocator.
+class BufferAllocator {
+public:
+  static constexpr size_t kAlignment = 64;
+
+  /// The process-wide allocator. It is configured by the environment variables
+  /// HOPLITE_HUGEPAGE_MODE, HOPLITE_PREFAULT_BUFFERS and HOPLITE_MAX_CACHED_BUFFER_BYTES.
+  static BufferAllocator &Instance();
+
+  /// \param hugepage_mode How large allocations are backed by huge pages.
+  /// \param prefault Fault in the pages of large allocations when they are mapped.
+  /// \param max_cached_bytes The maximum number of freed bytes kept for recycling.
+  BufferAllocator(HugePageMode hugepage_mode, bool prefault, int64_t max_cached_bytes);
+
+  ~BufferAllocator();
+
+  /// Allocate memory for a buffer. It never returns nullptr.
+  uint8_t *Allocate(int64_t size);
+
+  /// Free memory returned by 'Allocate'.
+  /// \param ptr The memory.
+  /// \param size The size passed to 'Allocate'.
+  void Free(uint8_t *ptr, int64_t size);
+
+  /// The number of freed bytes kept for recycling.
+  int64_t CachedBytes();
+
+private:
+  uint8_t *map_region(size_t mapped_size);
+
+  const HugePageMode hugepage_mode_;
+  const bool prefault_;
+  const int64_t max_cached_bytes_;
+  std::mutex mutex_;
+  // freed regions by their mapped sizes
+  std::unordered_map<size_t, std::vector<uint8_t *>> free_regions_;
+  int64_t cached_bytes_ = 0;
+};
+
+#endif // BUFFER_ALLOCATOR_H
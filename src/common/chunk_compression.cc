@@ -0,0 +1,79 @@
+#include "chunk_compression.h"
+
+#include <algorithm>
+#include <zlib.h>
+
+#include "common/buffer.h"
+#include "common/config.h"
+#include "util/logging.h"
+
+int64_t compression_chunk_end(int64_t offset, int64_t end) {
+  return std::min((offset / HOPLITE_COMPRESSION_CHUNK_SIZE + 1) * HOPLITE_COMPRESSION_CHUNK_SIZE, end);
+}
+
+// A chunk is only compressed if a sample of its head compresses at least by this factor.
+constexpr int64_t kSampleSize = 4096;
+constexpr double kMinSampleRatio = 1.125;
+
+std::string compress_chunk(const uint8_t *data, int64_t size) {
+  if (size > 4 * kSampleSize) {
+    // skip incompressible chunks (e.g. random or already compressed data) at a fraction of the cost
+    std::string sample(compressBound(kSampleSize), '\0');
+    uLongf sample_size = sample.size();
+    if (compress2((Bytef *)&sample[0], &sample_size, data, kSampleSize, Z_BEST_SPEED) != Z_OK ||
+        sample_size * kMinSampleRatio > kSampleSize) {
+      return std::string();
+    }
+  }
+  std::string chunk(compressBound(size), '\0');
+  uLongf compressed_size = chunk.size();
+  // the fastest level, since the compression is on the critical path of the transfer
+  int ec = compress2((Bytef *)&chunk[0], &compressed_size, data, size, Z_BEST_SPEED);
+  if (ec != Z_OK || compressed_size >= (uLongf)size) {
+    return std::string();
+  }
+  chunk.resize(compressed_size);
+  return chunk;
+}
+
+int decompress_chunk(const std::string &chunk, uint8_t *data, int64_t size) {
+  uLongf decompressed_size = size;
+  int ec = uncompress(data, &decompressed_size, (const Bytef *)chunk.data(), chunk.size());
+  if (ec != Z_OK || decompressed_size != (uLongf)size) {
+    LOG(ERROR) << "[decompress_chunk] corrupted chunk (code=" << ec << ", size=" << decompressed_size
+               << ", expected=" << size << ")";
+    return -1;
+  }
+  return 0;
+}
+
+bool CompressedChunks::is_cacheable(const Buffer &buffer, int64_t begin, int64_t end) {
+  return begin % HOPLITE_COMPRESSION_CHUNK_SIZE == 0 &&
+         (end - begin == HOPLITE_COMPRESSION_CHUNK_SIZE || end == buffer.Size());
+}
+
+std::shared_ptr<const std::string> CompressedChunks::Get(const Buffer &buffer, int64_t begin, int64_t end) {
+  const bool cacheable = is_cacheable(buffer, begin, end);
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto search = chunks_.find(begin);
+    if (search != chunks_.end()) {
+      return search->second;
+    }
+  }
+  // compress without the lock. concurrent senders of the same chunk compress it twice at worst.
+  auto chunk = std::make_shared<const std::string>(compress_chunk(buffer.Data() + begin, end - begin));
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_[begin] = chunk;
+  }
+  return chunk;
+}
+
+void CompressedChunks::Put(const Buffer &buffer, int64_t begin, int64_t end,
+                           const std::shared_ptr<const std::string> &chunk) {
+  if (is_cacheable(buffer, begin, end)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_[begin] = chunk;
+  }
+}
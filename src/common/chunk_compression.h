@@ -0,0 +1,52 @@
+#ifndef CHUNK_COMPRESSION_H
+#define CHUNK_COMPRESSION_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class Buffer;
+
+/// The end of the compression chunk that starts at 'offset'. Chunks are aligned to
+/// HOPLITE_COMPRESSION_CHUNK_SIZE, so a range that starts in the middle of a chunk begins with
+/// the rest of that chunk.
+/// \param offset The beginning of the chunk.
+/// \param end The end of the range that the chunk belongs to.
+int64_t compression_chunk_end(int64_t offset, int64_t end);
+
+/// Compress a chunk.
+/// \return The compressed chunk. It is empty if the chunk does not get smaller, and then the
+/// chunk is sent as it is.
+std::string compress_chunk(const uint8_t *data, int64_t size);
+
+/// Decompress a chunk.
+/// \param chunk The compressed chunk.
+/// \param data The destination, which must hold exactly 'size' bytes of decompressed data.
+/// \return 0 on success, and -1 if the chunk is corrupted.
+int decompress_chunk(const std::string &chunk, uint8_t *data, int64_t size);
+
+/// The compressed chunks of a buffer, so that every chunk is compressed once no matter how
+/// many receivers it is sent to. A node that has received compressed chunks caches them as
+/// well, and forwards them as they are.
+class CompressedChunks {
+public:
+  /// Get the compressed chunk [begin, end) of a buffer, compressing it if it is not cached.
+  /// The bytes of the chunk must be ready.
+  /// \return The compressed chunk. It is empty if the chunk is sent as it is.
+  std::shared_ptr<const std::string> Get(const Buffer &buffer, int64_t begin, int64_t end);
+
+  /// Cache a compressed chunk received from another node.
+  void Put(const Buffer &buffer, int64_t begin, int64_t end, const std::shared_ptr<const std::string> &chunk);
+
+private:
+  /// Only aligned chunks are cached. Unaligned ones only appear in resumed transfers.
+  static bool is_cacheable(const Buffer &buffer, int64_t begin, int64_t end);
+
+  std::mutex mutex_;
+  // the chunks by their beginning
+  std::unordered_map<int64_t, std::shared_ptr<const std::string>> chunks_;
+};
+
+#endif // CHUNK_COMPRESSION_H
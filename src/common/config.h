@@ -1,11 +1,22 @@
 #ifndef _HOPLITE_COMMON_CONFIG_H_
 #define _HOPLITE_COMMON_CONFIG_H_
 
+#include <cstdint>
+#include <cstdlib>
+
 // Enable non-blocking for the socket that receiving objects.
 #define HOPLITE_ENABLE_NONBLOCKING_SOCKET_RECV
 
 constexpr int64_t STREAM_MAX_BLOCK_SIZE = 4 * (2 << 20); // 4MB
 
+// Reach the senders on the same host through Unix domain sockets instead of loopback TCP.
+#define HOPLITE_ENABLE_LOCAL_TRANSPORT
+
+// Receivers on the same host copy objects directly from the memory of the sender
+// (process_vm_readv), while the sender only streams the progress. It falls back to streaming
+// the bytes if the receiver is not allowed to read the memory of the sender.
+#define HOPLITE_ENABLE_CROSS_MEMORY_ATTACH
+
 // Enable ACK for sending/receiving buffers. Usually used for debugging.
 // FIXME(suquark): Disable ACK would cause numeric mismatch.
 #define HOPLITE_ENABLE_ACK
@@ -16,20 +27,120 @@ constexpr int64_t STREAM_MAX_BLOCK_SIZE = 4 * (2 << 20); // 4MB
 // The constanf for bandwidth (in bytes/second)
 #define HOPLITE_BANDWIDTH (9.68 * (1 << 30) / 8)
 
-// Use atomic type for buffer progress.
-// #define HOPLITE_ENABLE_ATOMIC_BUFFER_PROGRESS
-
 // Maximum inflow concurrency for a node
 #define HOPLITE_MAX_INFLOW_CONCURRENCY 2
 
-// Maximum outflow concurrency for a node
+// Maximum outflow concurrency for a node. It can be overridden at runtime with the
+// environment variable HOPLITE_MAX_OUTFLOW_CONCURRENCY.
 #define HOPLITE_MAX_OUTLOW_CONCURRENCY 2
 
+// Objects at least this large are copied into the store by multiple threads with
+// non-temporal stores (see 'ParallelStreamCopy').
+#define HOPLITE_PARALLEL_STREAM_COPY_THRESHOLD (64LL << 20)
+
+// Number of threads (including the caller) of the parallel stream copy.
+#define HOPLITE_STREAM_COPY_THREADS 4
+
+// Chunk size of the parallel stream copy. Smaller chunks publish progress earlier.
+#define HOPLITE_STREAM_COPY_CHUNK_SIZE (2LL << 20)
+
+// Total size of the objects of a node above which the least recently used objects that are
+// not in use are evicted. It can be overridden at runtime with the environment variable
+// HOPLITE_LOCAL_STORE_CAPACITY. If the environment variable HOPLITE_SPILL_DIRECTORY is set,
+// evicted objects are spilled to files in that directory instead of being dropped.
+#define HOPLITE_LOCAL_STORE_CAPACITY (16LL << 30)
+
+// Processes of a host that set the environment variable HOPLITE_SHARED_STORE_NAME to the
+// same name share their objects at least this large through shared memory.
+#define HOPLITE_SHARED_OBJECT_MIN_SIZE (1LL << 16)
+
+// Maximum number of objects shared through shared memory by the processes of a host.
+#define HOPLITE_SHARED_OBJECT_SLOTS (1LL << 16)
+
+// Number of shards of the object table of the local store.
+#define HOPLITE_LOCAL_STORE_SHARDS 16
+
+// Buffers at least this large are mapped, pre-faulted and recycled by 'BufferAllocator'
+// instead of being allocated from the heap.
+#define HOPLITE_BUFFER_ARENA_MIN_SIZE (1LL << 20)
+
+// Huge pages for large buffers: 0 = none, 1 = transparent, 2 = explicit (hugetlbfs).
+// It can be overridden at runtime with the environment variable HOPLITE_HUGEPAGE_MODE.
+#define HOPLITE_HUGEPAGE_MODE 1
+
+// Fault in the pages of large buffers when they are mapped, instead of during receiving.
+// It can be overridden at runtime with the environment variable HOPLITE_PREFAULT_BUFFERS.
+#define HOPLITE_PREFAULT_BUFFERS 1
+
+// Maximum bytes of freed large buffers kept for reuse. It can be overridden at runtime
+// with the environment variable HOPLITE_MAX_CACHED_BUFFER_BYTES.
+#define HOPLITE_MAX_CACHED_BUFFER_BYTES (8LL << 30)
+
+// Upper bound (in microseconds) of a single sleep on the progress of a stream, so that
+// waiters re-check cancellation flags that do not wake up the stream they are waiting on.
+#define HOPLITE_PROGRESS_WAIT_TIMEOUT_US 1000
+
+// Maximum number of idle data-plane connections a receiver keeps for each sender
+#define HOPLITE_MAX_IDLE_CONNECTIONS_PER_PEER 2
+
+// The number of parallel connections that carry one object. Objects of at least
+// HOPLITE_STRIPE_MIN_SIZE bytes are split into ranges, one per connection, so a transfer is
+// not limited by one TCP flow. 1 disables striping. It can be overridden by the environment
+// variable HOPLITE_TRANSFER_STRIPES. Every stripe takes an outflow slot of the sender.
+#define HOPLITE_TRANSFER_STRIPES 1
+#define HOPLITE_STRIPE_MIN_SIZE (64 << 20)
+
+// The number of nodes that a receiver pulls an object from at once. Besides its sender, the
+// receiver gets other nodes that hold the complete object from the directory, and pulls a
+// disjoint range from each of them. Only objects of at least HOPLITE_SWARM_MIN_SIZE bytes
+// are pulled in this way. 1 disables it. It can be overridden by the environment variable
+// HOPLITE_SWARM_SOURCES.
+#define HOPLITE_SWARM_SOURCES 1
+#define HOPLITE_SWARM_MIN_SIZE (16 << 20)
+
+// Compress objects on the wire. Objects are compressed in chunks of
+// HOPLITE_COMPRESSION_CHUNK_SIZE bytes, each on its own, so they still stream chunk by chunk,
+// and nodes forward the compressed chunks they have received without compressing them again.
+// It pays off for compressible objects on links that are slower than the compression. It can
+// be overridden by the environment variable HOPLITE_WIRE_COMPRESSION. All nodes must use the
+// same chunk size.
+#define HOPLITE_WIRE_COMPRESSION 0
+#define HOPLITE_COMPRESSION_CHUNK_SIZE (256 << 10)
+
+// The number of threads that prepare the chunks of compressed, quantized and sparse transfers
+// for the sender, so that its event loop only sends them. It can be overridden by the environment variable
+// HOPLITE_SENDER_ENCODE_THREADS.
+#define HOPLITE_SENDER_ENCODE_THREADS 4
+
+// The number of float32 elements in a block of a quantized reduce transfer. Blocks are sent
+// once all of their elements are ready, and INT8 blocks carry their own scale.
+#define HOPLITE_WIRE_BLOCK_ELEMENTS 4096
+
+// Sparse reduce transfers send a block as it is once more than this percentage of its 4-byte
+// words are nonzero, since the indices would cost more than the zeros they save.
+#define HOPLITE_SPARSE_MAX_DENSITY_PERCENT 50
+
 // The thread pool size for the distributed store to launch
 // RPCs like `InvokeReduceTo` and `InvokeRedirectReduce`.
 #define HOPLITE_THREADPOOL_SIZE_FOR_RPC 10
 
-#define HOPLITE_MULTITHREAD_REDUCE_SIZE (1 << 28)
+// The number of threads that run the asynchronous Get and Put calls. Further calls are
+// queued. Puts have their own threads, so they never wait behind Gets of objects that are
+// not created yet.
+#define HOPLITE_ASYNC_GET_THREADS 8
+#define HOPLITE_ASYNC_PUT_THREADS 2
+
+// Large reductions are split into chunks of HOPLITE_REDUCE_CHUNK_SIZE bytes, which stay in the
+// L2 cache, and reduced by the calling thread together with HOPLITE_REDUCE_WORKERS worker
+// threads on its NUMA node. Negative means one less than the number of CPUs of the node (at
+// most 7). It can be overridden by the environment variable HOPLITE_REDUCE_WORKERS.
+#define HOPLITE_REDUCE_WORKERS -1
+#define HOPLITE_REDUCE_CHUNK_SIZE (256 << 10)
+
+// Tree branch nodes receive their left child into a ring window of this many bytes instead of
+// a copy of the whole object, and reduce both children and the local object into the target
+// in one pass. The left child waits for room when it runs ahead of the right child.
+#define HOPLITE_FUSED_REDUCE_WINDOW (16 << 20)
 
 // Make the Put() call blocking on 'WriteLocation'
 #ifndef HOPLITE_PUT_BLOCKING
@@ -44,4 +155,12 @@ constexpr int64_t STREAM_MAX_BLOCK_SIZE = 4 * (2 << 20); // 4MB
 #define OBJECT_DIRECTORY_PORT 7777
 #define OBJECT_DIRECTORY_LISTENER_PORT 8888
 
+/// Read an integer setting from the environment.
+/// \param name The name of the environment variable.
+/// \param default_value The value to use when the variable is not set.
+inline int64_t get_config_from_env(const char *name, int64_t default_value) {
+  const char *value = std::getenv(name);
+  return value != nullptr ? std::strtoll(value, nullptr, 10) : default_value;
+}
+
 #endif  // _HOPLITE_COMMON_CONFIG_H_
@@ -0,0 +1,91 @@
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+
+#include <cstdint>
+#include <cstring>
+
+// Conversions between float32 and the 16-bit float formats, rounding to nearest even.
+// They are inlined into the vectorized reduce kernels.
+
+#define HOPLITE_HALF_FLOAT_INLINE inline __attribute__((always_inline))
+
+HOPLITE_HALF_FLOAT_INLINE float bf16_to_float(uint16_t h) {
+  uint32_t u = (uint32_t)h << 16;
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+HOPLITE_HALF_FLOAT_INLINE uint16_t float_to_bf16(float f) {
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  if (f != f) {
+    // keep NaNs quiet instead of letting the rounding carry turn them into infinities
+    return (u >> 16) | 0x40;
+  }
+  return (u + 0x7fff + ((u >> 16) & 1)) >> 16;
+}
+
+HOPLITE_HALF_FLOAT_INLINE float fp16_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t u;
+  if (exponent == 0x1f) {
+    u = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    u = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    u = sign;
+  } else {
+    // subnormal half: normalize it
+    exponent = 127 - 15 + 1;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    u = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+HOPLITE_HALF_FLOAT_INLINE uint16_t float_to_fp16(float f) {
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  uint32_t sign = (u >> 16) & 0x8000;
+  uint32_t float_exponent = (u >> 23) & 0xff;
+  uint32_t mantissa = u & 0x7fffff;
+  if (float_exponent == 0xff) {
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  int32_t exponent = (int32_t)float_exponent - 127 + 15;
+  if (exponent >= 0x1f) {
+    return sign | 0x7c00;
+  }
+  if (exponent <= 0) {
+    // the result is a subnormal half (or zero)
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t midpoint = 1u << (shift - 1);
+    if (remainder > midpoint || (remainder == midpoint && (half & 1))) {
+      half++;
+    }
+    return sign | half;
+  }
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1fff;
+  // a carry out of the mantissa correctly bumps the exponent (up to infinity)
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    half++;
+  }
+  return half;
+}
+
+#endif // HALF_FLOAT_H
@@ -0,0 +1,126 @@
+#include "common/progress_counter.h"
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util/logging.h"
+
+namespace {
+
+int futex_wait(std::atomic<uint32_t> *addr, uint32_t expected, const struct timespec *timeout) {
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+void futex_wake_all(std::atomic<uint32_t> *addr) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+int64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void signal_eventfd(int event_fd) {
+  uint64_t one = 1;
+  DCHECK(write(event_fd, &one, sizeof(one)) == sizeof(one)) << "Failed to signal eventfd " << event_fd;
+}
+
+} // namespace
+
+ProgressCounter::ProgressCounter(int64_t value)
+    : value_(value), epoch_(0), interrupts_(0), n_waiters_(0), n_listeners_(0) {}
+
+void ProgressCounter::Store(int64_t value) {
+  // sequentially consistent, so that either the writer sees the waiters, or the waiters see the value
+  value_.store(value);
+  publish(value);
+}
+
+void ProgressCounter::Add(int64_t delta) { publish(value_.fetch_add(delta) + delta); }
+
+int64_t ProgressCounter::Wait(int64_t target, int64_t timeout_us) {
+  int64_t value = Load();
+  if (value >= target) {
+    return value;
+  }
+  const uint32_t interrupts = interrupts_.load();
+  const int64_t deadline = timeout_us >= 0 ? now_us() + timeout_us : -1;
+  while (true) {
+    n_waiters_.fetch_add(1);
+    uint32_t epoch = epoch_.load();
+    value = value_.load();
+    if (value >= target || interrupts_.load() != interrupts) {
+      n_waiters_.fetch_sub(1);
+      return value;
+    }
+    if (deadline < 0) {
+      futex_wait(&epoch_, epoch, nullptr);
+    } else {
+      int64_t remaining_us = deadline - now_us();
+      if (remaining_us <= 0) {
+        n_waiters_.fetch_sub(1);
+        return value;
+      }
+      struct timespec timeout;
+      timeout.tv_sec = remaining_us / 1000000;
+      timeout.tv_nsec = (remaining_us % 1000000) * 1000;
+      futex_wait(&epoch_, epoch, &timeout);
+    }
+    n_waiters_.fetch_sub(1);
+  }
+}
+
+void ProgressCounter::Interrupt() {
+  interrupts_.fetch_add(1);
+  wake_waiters();
+}
+
+void ProgressCounter::NotifyOnProgress(int event_fd, int64_t target) {
+  std::lock_guard<std::mutex> lock(listeners_mutex_);
+  n_listeners_.fetch_add(1);
+  if (value_.load() >= target) {
+    n_listeners_.fetch_sub(1);
+    signal_eventfd(event_fd);
+    return;
+  }
+  listeners_.emplace_back(event_fd, target);
+}
+
+void ProgressCounter::CancelNotification(int event_fd, int64_t target) {
+  std::lock_guard<std::mutex> lock(listeners_mutex_);
+  for (auto it = listeners_.begin(); it != listeners_.end(); ++it) {
+    if (it->first == event_fd && it->second == target) {
+      listeners_.erase(it);
+      n_listeners_.fetch_sub(1);
+      return;
+    }
+  }
+}
+
+void ProgressCounter::publish(int64_t value) {
+  if (n_waiters_.load() > 0) {
+    wake_waiters();
+  }
+  if (n_listeners_.load() > 0) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    for (auto it = listeners_.begin(); it != listeners_.end();) {
+      if (value >= it->second) {
+        signal_eventfd(it->first);
+        it = listeners_.erase(it);
+        n_listeners_.fetch_sub(1);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void ProgressCounter::wake_waiters() {
+  epoch_.fetch_add(1);
+  futex_wake_all(&epoch_);
+}
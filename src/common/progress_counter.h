@@ -0,0 +1,58 @@
+#ifndef PROGRESS_COUNTER_H
+#define PROGRESS_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/// The number of bytes that are ready in a stream. A writer publishes progress with release
+/// semantics, and readers can either load it, sleep on it (futex) until it reaches a target, or
+/// ask for an eventfd to be signaled when it does (for event loops).
+///
+/// Waking is only paid for when somebody waits: a writer without waiters or listeners does one
+/// atomic store and two atomic loads.
+class ProgressCounter {
+public:
+  explicit ProgressCounter(int64_t value = 0);
+
+  int64_t Load() const { return value_.load(std::memory_order_acquire); }
+
+  void Store(int64_t value);
+
+  void Add(int64_t delta);
+
+  /// Block until the progress reaches 'target', 'Interrupt' is called or the timeout expires.
+  /// \param target The progress to wait for.
+  /// \param timeout_us The timeout in microseconds. Negative means no timeout.
+  /// \return The progress observed when returning. It can be less than 'target'.
+  int64_t Wait(int64_t target, int64_t timeout_us = -1);
+
+  /// Wake up all blocked 'Wait' calls regardless of the progress.
+  void Interrupt();
+
+  /// Signal 'event_fd' (an eventfd) once when the progress reaches 'target'. It is signaled
+  /// immediately if the progress has already reached it.
+  void NotifyOnProgress(int event_fd, int64_t target);
+
+  /// Remove a pending notification registered with the same arguments.
+  void CancelNotification(int event_fd, int64_t target);
+
+private:
+  void publish(int64_t value);
+
+  void wake_waiters();
+
+  std::atomic<int64_t> value_;
+  // the futex word. it changes whenever the waiters should re-check the progress.
+  std::atomic<uint32_t> epoch_;
+  std::atomic<uint32_t> interrupts_;
+  std::atomic<int32_t> n_waiters_;
+  std::atomic<int32_t> n_listeners_;
+  std::mutex listeners_mutex_;
+  // (eventfd, target progress)
+  std::vector<std::pair<int, int64_t>> listeners_;
+};
+
+#endif // PROGRESS_COUNTER_H
@@ -0,0 +1,184 @@
+#include "reduce_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+#include "common/progress_counter.h"
+#include "util/ctpl_stl.h"
+#include "util/logging.h"
+
+namespace {
+
+// the most workers to start without an explicit number. a few cores saturate the memory
+// bandwidth of a node, and more of them only compete with the rest of the process.
+constexpr int kMaxDefaultWorkers = 7;
+// starting a thread and waking it up takes about this long
+constexpr double kOverlapCostSeconds = 100e-6;
+// shorter measurements are dominated by the noise of the clock and the scheduler
+constexpr int64_t kMinReduceSample = 64 << 10;
+constexpr int64_t kMinLinkSample = 1 << 20;
+// larger than the caches, so that the first estimate is bound by the memory like large reductions
+constexpr int64_t kCalibrationElements = 1 << 20;
+// the weight of a new sample in the moving averages
+constexpr double kSampleWeight = 0.25;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void update_average(std::atomic<double> *average, double sample) {
+  // concurrent updates may lose a sample, which is fine for an estimate
+  double value = average->load(std::memory_order_relaxed);
+  average->store(value * (1 - kSampleWeight) + sample * kSampleWeight, std::memory_order_relaxed);
+}
+
+// Parse a sysfs CPU list like "0-15,32-47".
+std::vector<int> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    size_t dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::exception &) {
+      return {};
+    }
+  }
+  return cpus;
+}
+
+// The CPUs of the NUMA node that the calling thread runs on, or an empty list if it is unknown.
+std::vector<int> local_node_cpus() {
+  int current = sched_getcpu();
+  if (current < 0) {
+    return {};
+  }
+  for (int node = 0;; node++) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+      return {};
+    }
+    std::vector<int> cpus = parse_cpu_list(list);
+    if (std::find(cpus.begin(), cpus.end(), current) != cpus.end()) {
+      return cpus;
+    }
+  }
+}
+
+// The progress of a 'ParallelFor'. The workers that pick it up after all chunks are taken only
+// touch this state, which they keep alive.
+struct ParallelForState {
+  std::atomic<int64_t> next_chunk{0};
+  ProgressCounter done_chunks;
+};
+
+} // namespace
+
+ReduceEngine::ReduceEngine(int n_workers) : reduce_throughput_(0), link_throughput_(HOPLITE_BANDWIDTH) {
+  std::vector<int> cpus = local_node_cpus();
+  if (n_workers < 0) {
+    int n_cpus = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+    n_workers = std::min(std::max(n_cpus - 1, 0), kMaxDefaultWorkers);
+  }
+  n_workers_ = n_workers;
+  pool_.reset(new ctpl::thread_pool(n_workers_));
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    for (int i = 0; i < n_workers_; i++) {
+      // the workers stay on the node, and the scheduler balances them across its cores
+      pthread_setaffinity_np(pool_->get_thread(i).native_handle(), sizeof(cpu_set), &cpu_set);
+    }
+  }
+  // start from the throughput of a float32 sum, which is the most common reduction
+  std::vector<float> dst(kCalibrationElements), src(kCalibrationElements, 1.0f);
+  ReduceKernel kernel = GetReduceKernel(ReduceOp::SUM, ReduceDataType::FLOAT32);
+  kernel(dst.data(), src.data(), dst.size());
+  auto start = std::chrono::steady_clock::now();
+  kernel(dst.data(), src.data(), dst.size());
+  reduce_throughput_ = dst.size() * sizeof(float) / std::max(seconds_since(start), 1e-9);
+  LOG(DEBUG) << "[ReduceEngine] " << n_workers_ << " workers, " << cpus.size() << " CPUs on the node, "
+             << ReduceThroughput() * 8 / 1e9 << " Gb/s per thread";
+}
+
+ReduceEngine::~ReduceEngine() = default;
+
+ReduceEngine &ReduceEngine::Get() {
+  static ReduceEngine engine(get_config_from_env("HOPLITE_REDUCE_WORKERS", HOPLITE_REDUCE_WORKERS));
+  return engine;
+}
+
+void ReduceEngine::ParallelFor(int64_t size, int64_t alignment,
+                               const std::function<void(int64_t, int64_t)> &func) {
+  const int64_t chunk_size = std::max<int64_t>(HOPLITE_REDUCE_CHUNK_SIZE / alignment, 1) * alignment;
+  const int64_t n_chunks = (size + chunk_size - 1) / chunk_size;
+  if (n_chunks <= 1 || n_workers_ == 0) {
+    if (size > 0) {
+      func(0, size);
+    }
+    return;
+  }
+  auto state = std::make_shared<ParallelForState>();
+  const auto *func_ptr = &func;
+  // 'func' is only called for the chunks taken before all of them are done, so it outlives the calls
+  auto work = [state, func_ptr, n_chunks, chunk_size, size]() {
+    int64_t chunk;
+    while ((chunk = state->next_chunk.fetch_add(1)) < n_chunks) {
+      (*func_ptr)(chunk * chunk_size, std::min(size, (chunk + 1) * chunk_size));
+      state->done_chunks.Add(1);
+    }
+  };
+  const int64_t n_helpers = std::min<int64_t>(n_workers_, n_chunks - 1);
+  for (int64_t i = 0; i < n_helpers; i++) {
+    pool_->push([work](int id) { work(); });
+  }
+  work();
+  while (state->done_chunks.Wait(n_chunks) < n_chunks) {
+  }
+}
+
+void ReduceEngine::Reduce(ReduceKernel reduce_kernel, uint8_t *dst, const uint8_t *src, int64_t n_elements,
+                          size_t element_size) {
+  ParallelFor(n_elements * element_size, element_size, [&](int64_t begin, int64_t end) {
+    auto start = std::chrono::steady_clock::now();
+    reduce_kernel(dst + begin, src + begin, (end - begin) / element_size);
+    if (end - begin >= kMinReduceSample) {
+      record_reduce(end - begin, seconds_since(start));
+    }
+  });
+}
+
+bool ReduceEngine::ShouldOverlap(int64_t size) const {
+  // receiving and reducing in one thread takes size / link + size / reduce, and overlapping them
+  // takes size / min(link, reduce)
+  return size / std::max(LinkThroughput(), ReduceThroughput()) > kOverlapCostSeconds;
+}
+
+void ReduceEngine::RecordLink(int64_t bytes, double seconds) {
+  if (bytes >= kMinLinkSample && seconds > 0) {
+    update_average(&link_throughput_, bytes / seconds);
+  }
+}
+
+void ReduceEngine::record_reduce(int64_t bytes, double seconds) {
+  if (seconds > 0) {
+    update_average(&reduce_throughput_, bytes / seconds);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef REDUCE_ENGINE_H
+#define REDUCE_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "common/reduce_kernels.h"
+
+namespace ctpl {
+class thread_pool;
+}
+
+/// Reduces large ranges on a bounded pool of worker threads. A range is split into chunks of
+/// HOPLITE_REDUCE_CHUNK_SIZE bytes, which the workers and the calling thread take one by one, so
+/// the calling thread makes progress even when the workers are busy with other reductions.
+/// The workers are pinned to the NUMA node the engine is created on, if it can be found.
+///
+/// The engine also measures the throughput of the reduce kernels and of the links that the
+/// reduced streams come from, to decide when receiving and reducing should overlap.
+class ReduceEngine {
+public:
+  /// \param n_workers The number of worker threads. Negative means one less than the number of
+  /// CPUs of the NUMA node, and 0 reduces on the calling threads only.
+  explicit ReduceEngine(int n_workers);
+
+  ~ReduceEngine();
+
+  /// The engine shared by the reductions of this process. Its number of workers is
+  /// HOPLITE_REDUCE_WORKERS, which the environment variable of the same name overrides.
+  static ReduceEngine &Get();
+
+  int NumWorkers() const { return n_workers_; }
+
+  /// Call 'func' on the chunks of [0, size) in parallel, and return when all of them are done.
+  /// \param alignment The chunk boundaries are multiples of it.
+  /// \param func Called with the beginning and the end of a chunk.
+  void ParallelFor(int64_t size, int64_t alignment, const std::function<void(int64_t, int64_t)> &func);
+
+  /// Compute dst[i] = op(dst[i], src[i]) for i in [0, n_elements) like the kernel, in parallel
+  /// if the range spans multiple chunks.
+  void Reduce(ReduceKernel reduce_kernel, uint8_t *dst, const uint8_t *src, int64_t n_elements, size_t element_size);
+
+  /// Whether a stream of 'size' bytes should be received and reduced by separate threads.
+  /// Overlapping saves the time of the faster of the two, which has to outweigh the cost of
+  /// starting and waking the other thread.
+  bool ShouldOverlap(int64_t size) const;
+
+  /// Record a transfer of a reduced stream.
+  void RecordLink(int64_t bytes, double seconds);
+
+  /// The measured throughput of a reduce kernel on one thread in bytes per second.
+  double ReduceThroughput() const { return reduce_throughput_.load(std::memory_order_relaxed); }
+
+  /// The measured throughput of the links in bytes per second.
+  double LinkThroughput() const { return link_throughput_.load(std::memory_order_relaxed); }
+
+private:
+  void record_reduce(int64_t bytes, double seconds);
+
+  int n_workers_;
+  std::unique_ptr<ctpl::thread_pool> pool_;
+  // moving averages of the measured throughputs
+  std::atomic<double> reduce_throughput_;
+  std::atomic<double> link_throughput_;
+};
+
+#endif // REDUCE_ENGINE_H
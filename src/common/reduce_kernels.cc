@@ -0,0 +1,330 @@
+#include "common/reduce_kernels.h"
+
+#include <cstring>
+
+#include "common/half_float.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOPLITE_X86_KERNELS
+#endif
+
+// Every kernel is a template over (op, element type) and is instantiated once per
+// instruction set level. The levels are compiled with per-function target
+// attributes, so the library itself does not require any '-m' flags and stays
+// runnable on older CPUs. The vectorized bodies use GCC vector extensions, which
+// are lowered to the instruction set of the enclosing function.
+
+#define HOPLITE_KERNEL_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+// Vectors are passed by reference so that the operators do not depend on the
+// vector calling convention of the enclosing target.
+struct SumOp {
+  template <typename V> static HOPLITE_KERNEL_INLINE void Apply(V &a, const V &b) { a = a + b; }
+};
+
+struct MinOp {
+  template <typename V> static HOPLITE_KERNEL_INLINE void Apply(V &a, const V &b) { a = a < b ? a : b; }
+};
+
+struct MaxOp {
+  template <typename V> static HOPLITE_KERNEL_INLINE void Apply(V &a, const V &b) { a = a > b ? a : b; }
+};
+
+struct ProdOp {
+  template <typename V> static HOPLITE_KERNEL_INLINE void Apply(V &a, const V &b) { a = a * b; }
+};
+
+// Storage types of 16-bit floats.
+struct Float16 {
+  uint16_t bits;
+};
+
+struct BFloat16 {
+  uint16_t bits;
+};
+
+// How a stored element is converted into the type we compute with.
+template <typename T> struct Scalar {
+  typedef T compute_type;
+  static HOPLITE_KERNEL_INLINE T Load(const T &x) { return x; }
+  static HOPLITE_KERNEL_INLINE void Store(T &x, T value) { x = value; }
+};
+
+template <> struct Scalar<Float16> {
+  typedef float compute_type;
+  static HOPLITE_KERNEL_INLINE float Load(const Float16 &x) { return fp16_to_float(x.bits); }
+  static HOPLITE_KERNEL_INLINE void Store(Float16 &x, float value) { x.bits = float_to_fp16(value); }
+};
+
+template <> struct Scalar<BFloat16> {
+  typedef float compute_type;
+  static HOPLITE_KERNEL_INLINE float Load(const BFloat16 &x) { return bf16_to_float(x.bits); }
+  static HOPLITE_KERNEL_INLINE void Store(BFloat16 &x, float value) { x.bits = float_to_bf16(value); }
+};
+
+template <typename Op, typename T> HOPLITE_KERNEL_INLINE void reduce_tail(T *dst, const T *src, int64_t n) {
+  for (int64_t i = 0; i < n; i++) {
+    typename Scalar<T>::compute_type a = Scalar<T>::Load(dst[i]);
+    Op::Apply(a, Scalar<T>::Load(src[i]));
+    Scalar<T>::Store(dst[i], a);
+  }
+}
+
+template <typename T, int kBytes> struct Vector {
+  typedef T type __attribute__((vector_size(kBytes)));
+};
+
+/// The vectorized body for element types the vector extensions support natively.
+template <typename Op, typename T, int kBytes> struct Block {
+  static HOPLITE_KERNEL_INLINE void Run(T *dst, const T *src, int64_t n) {
+    typedef typename Vector<T, kBytes>::type V;
+    constexpr int64_t kLanes = kBytes / sizeof(T);
+    int64_t i = 0;
+    // unrolled by four to keep enough loads in flight
+    for (; i + 4 * kLanes <= n; i += 4 * kLanes) {
+      V a[4], b[4];
+      std::memcpy(a, dst + i, sizeof(a));
+      std::memcpy(b, src + i, sizeof(b));
+      Op::Apply(a[0], b[0]);
+      Op::Apply(a[1], b[1]);
+      Op::Apply(a[2], b[2]);
+      Op::Apply(a[3], b[3]);
+      std::memcpy(dst + i, a, sizeof(a));
+    }
+    for (; i + kLanes <= n; i += kLanes) {
+      V a, b;
+      std::memcpy(&a, dst + i, kBytes);
+      std::memcpy(&b, src + i, kBytes);
+      Op::Apply(a, b);
+      std::memcpy(dst + i, &a, kBytes);
+    }
+    reduce_tail<Op, T>(dst + i, src + i, n - i);
+  }
+};
+
+/// bfloat16 is widened to float32 with shifts, so it is vectorized at every level.
+template <typename Op, int kBytes> struct Block<Op, BFloat16, kBytes> {
+  static HOPLITE_KERNEL_INLINE void Run(BFloat16 *dst, const BFloat16 *src, int64_t n) {
+    typedef typename Vector<float, kBytes>::type VF;
+    typedef typename Vector<uint32_t, kBytes>::type VU;
+    typedef typename Vector<uint16_t, kBytes / 2>::type VH;
+    constexpr int64_t kLanes = kBytes / sizeof(float);
+    int64_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+      VH ha, hb;
+      std::memcpy(&ha, dst + i, sizeof(ha));
+      std::memcpy(&hb, src + i, sizeof(hb));
+      VF a = (VF)(__builtin_convertvector(ha, VU) << 16);
+      VF b = (VF)(__builtin_convertvector(hb, VU) << 16);
+      Op::Apply(a, b);
+      VU u = (VU)a;
+      VU rounded = (u + 0x7fff + ((u >> 16) & 1)) >> 16;
+      VU quiet_nan = (u >> 16) | 0x40;
+      VU result = a != a ? quiet_nan : rounded;
+      ha = __builtin_convertvector(result, VH);
+      std::memcpy(dst + i, &ha, sizeof(ha));
+    }
+    reduce_tail<Op, BFloat16>(dst + i, src + i, n - i);
+  }
+};
+
+/// float16 needs F16C (or AVX-512) for the conversion; without it we convert one by one.
+template <typename Op, int kBytes> struct Block<Op, Float16, kBytes> {
+  static HOPLITE_KERNEL_INLINE void Run(Float16 *dst, const Float16 *src, int64_t n) {
+    reduce_tail<Op, Float16>(dst, src, n);
+  }
+};
+
+#ifdef HOPLITE_X86_KERNELS
+
+template <typename Op> struct Block<Op, Float16, 32> {
+  __attribute__((target("avx2,f16c"))) static HOPLITE_KERNEL_INLINE void Run(Float16 *dst, const Float16 *src,
+                                                                             int64_t n) {
+    typedef typename Vector<float, 32>::type VF;
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      VF a = (VF)_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(dst + i)));
+      VF b = (VF)_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i)));
+      Op::Apply(a, b);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm256_cvtps_ph((__m256)a, _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_tail<Op, Float16>(dst + i, src + i, n - i);
+  }
+};
+
+template <typename Op> struct Block<Op, Float16, 64> {
+  __attribute__((target("avx512f"))) static HOPLITE_KERNEL_INLINE void Run(Float16 *dst, const Float16 *src,
+                                                                           int64_t n) {
+    typedef typename Vector<float, 64>::type VF;
+    int64_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      // the zero-masked forms avoid a spurious uninitialized warning in GCC's headers
+      VF a = (VF)_mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256((const __m256i *)(dst + i)));
+      VF b = (VF)_mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256((const __m256i *)(src + i)));
+      Op::Apply(a, b);
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm512_maskz_cvtps_ph(0xffff, (__m512)a, _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_tail<Op, Float16>(dst + i, src + i, n - i);
+  }
+};
+
+#endif // HOPLITE_X86_KERNELS
+
+template <typename Op, typename T> void reduce_scalar(void *dst, const void *src, int64_t n) {
+  reduce_tail<Op, T>((T *)dst, (const T *)src, n);
+}
+
+#ifdef HOPLITE_X86_KERNELS
+
+template <typename Op, typename T>
+__attribute__((target("sse2"))) void reduce_sse(void *dst, const void *src, int64_t n) {
+  Block<Op, T, 16>::Run((T *)dst, (const T *)src, n);
+}
+
+template <typename Op, typename T>
+__attribute__((target("avx2,f16c"))) void reduce_avx2(void *dst, const void *src, int64_t n) {
+  Block<Op, T, 32>::Run((T *)dst, (const T *)src, n);
+}
+
+template <typename Op, typename T>
+__attribute__((target("avx512f"))) void reduce_avx512(void *dst, const void *src, int64_t n) {
+  Block<Op, T, 64>::Run((T *)dst, (const T *)src, n);
+}
+
+#endif // HOPLITE_X86_KERNELS
+
+template <typename Op, typename T> ReduceKernel select_level(SimdLevel level) {
+#ifdef HOPLITE_X86_KERNELS
+  switch (level) {
+  case SimdLevel::AVX512:
+    return reduce_avx512<Op, T>;
+  case SimdLevel::AVX2:
+    return reduce_avx2<Op, T>;
+  case SimdLevel::SSE:
+    return reduce_sse<Op, T>;
+  default:
+    break;
+  }
+#endif
+  return reduce_scalar<Op, T>;
+}
+
+template <typename Op> ReduceKernel select_dtype(ReduceDataType dtype, SimdLevel level) {
+  switch (dtype) {
+  case ReduceDataType::FLOAT32:
+    return select_level<Op, float>(level);
+  case ReduceDataType::FLOAT64:
+    return select_level<Op, double>(level);
+  case ReduceDataType::INT32:
+    return select_level<Op, int32_t>(level);
+  case ReduceDataType::INT64:
+    return select_level<Op, int64_t>(level);
+  case ReduceDataType::FLOAT16:
+    return select_level<Op, Float16>(level);
+  case ReduceDataType::BFLOAT16:
+    return select_level<Op, BFloat16>(level);
+  }
+  return nullptr;
+}
+
+} // namespace
+
+SimdLevel DetectSimdLevel() {
+#ifdef HOPLITE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+    return SimdLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SimdLevel::SSE;
+  }
+#endif
+  return SimdLevel::SCALAR;
+}
+
+const char *SimdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::SCALAR:
+    return "scalar";
+  case SimdLevel::SSE:
+    return "sse";
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+const char *ReduceOpName(ReduceOp op) {
+  switch (op) {
+  case ReduceOp::SUM:
+    return "sum";
+  case ReduceOp::MIN:
+    return "min";
+  case ReduceOp::MAX:
+    return "max";
+  case ReduceOp::PROD:
+    return "prod";
+  }
+  return "unknown";
+}
+
+const char *ReduceDataTypeName(ReduceDataType dtype) {
+  switch (dtype) {
+  case ReduceDataType::FLOAT32:
+    return "float32";
+  case ReduceDataType::FLOAT64:
+    return "float64";
+  case ReduceDataType::INT32:
+    return "int32";
+  case ReduceDataType::INT64:
+    return "int64";
+  case ReduceDataType::FLOAT16:
+    return "float16";
+  case ReduceDataType::BFLOAT16:
+    return "bfloat16";
+  }
+  return "unknown";
+}
+
+size_t ReduceDataTypeSize(ReduceDataType dtype) {
+  switch (dtype) {
+  case ReduceDataType::FLOAT32:
+  case ReduceDataType::INT32:
+    return 4;
+  case ReduceDataType::FLOAT64:
+  case ReduceDataType::INT64:
+    return 8;
+  case ReduceDataType::FLOAT16:
+  case ReduceDataType::BFLOAT16:
+    return 2;
+  }
+  return 0;
+}
+
+ReduceKernel GetReduceKernel(ReduceOp op, ReduceDataType dtype, SimdLevel level) {
+  switch (op) {
+  case ReduceOp::SUM:
+    return select_dtype<SumOp>(dtype, level);
+  case ReduceOp::MIN:
+    return select_dtype<MinOp>(dtype, level);
+  case ReduceOp::MAX:
+    return select_dtype<MaxOp>(dtype, level);
+  case ReduceOp::PROD:
+    return select_dtype<ProdOp>(dtype, level);
+  }
+  return nullptr;
+}
+
+ReduceKernel GetReduceKernel(ReduceOp op, ReduceDataType dtype) {
+  // resolved once, on the first reduction of the process
+  static const SimdLevel level = DetectSimdLevel();
+  return GetReduceKernel(op, dtype, level);
+}
@@ -0,0 +1,42 @@
+#ifndef REDUCE_KERNELS_H
+#define REDUCE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Element-wise reduce operations. The values match 'objectstore::ReduceOp'.
+enum class ReduceOp : int { SUM = 0, MIN = 1, MAX = 2, PROD = 3 };
+
+/// Element types of reduced objects. The values match 'objectstore::ReduceDataType'.
+/// FLOAT16 is IEEE half precision; BFLOAT16 is the upper half of a float32. Both are
+/// computed in float32 and rounded to nearest even when stored back.
+enum class ReduceDataType : int { FLOAT32 = 0, FLOAT64 = 1, INT32 = 2, INT64 = 3, FLOAT16 = 4, BFLOAT16 = 5 };
+
+/// Instruction set levels a reduce kernel can be built for. Higher levels are
+/// only used when the running CPU supports them.
+enum class SimdLevel : int { SCALAR = 0, SSE = 1, AVX2 = 2, AVX512 = 3 };
+
+/// Detect the highest instruction set level supported by the running CPU.
+SimdLevel DetectSimdLevel();
+
+const char *SimdLevelName(SimdLevel level);
+
+const char *ReduceOpName(ReduceOp op);
+
+const char *ReduceDataTypeName(ReduceDataType dtype);
+
+/// The size of one element in bytes.
+size_t ReduceDataTypeSize(ReduceDataType dtype);
+
+/// A kernel computing dst[i] = op(dst[i], src[i]) for i in [0, n_elements).
+/// 'dst' and 'src' must not overlap.
+typedef void (*ReduceKernel)(void *dst, const void *src, int64_t n_elements);
+
+/// Return the kernel of 'op' over 'dtype' built for the given level. The caller must
+/// make sure the level is supported by the running CPU (see 'DetectSimdLevel').
+ReduceKernel GetReduceKernel(ReduceOp op, ReduceDataType dtype, SimdLevel level);
+
+/// Return the kernel of 'op' over 'dtype' for the best level of the running CPU.
+ReduceKernel GetReduceKernel(ReduceOp op, ReduceDataType dtype);
+
+#endif // REDUCE_KERNELS_H
@@ -0,0 +1,124 @@
+#include "sparse_chunk.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "common/config.h"
+
+namespace {
+
+constexpr int64_t kWordSize = sizeof(uint32_t);
+constexpr int64_t kMaxWords = int64_t(UINT16_MAX) + 1;
+
+inline uint64_t load_u64(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+} // namespace
+
+uint32_t sparse_chunk_encode(const uint8_t *data, int64_t size, std::string *chunk) {
+  chunk->clear();
+  const int64_t n_words = size / kWordSize;
+  if (size % kWordSize != 0 || n_words > kMaxWords) {
+    return kSparseDenseChunk;
+  }
+  const int64_t max_nonzero = n_words * HOPLITE_SPARSE_MAX_DENSITY_PERCENT / 100;
+  // the words of a chunk are appended after all of its indices, so collect them apart first
+  std::vector<uint16_t> indices(max_nonzero + 2);
+  std::vector<uint32_t> words(max_nonzero + 2);
+  int64_t n_nonzero = 0;
+  int64_t i = 0;
+  // skip zeros two words at a time
+  for (; i + 1 < n_words; i += 2) {
+    if (load_u64(data + i * kWordSize) == 0) {
+      continue;
+    }
+    for (int64_t j = i; j < i + 2; j++) {
+      uint32_t word;
+      std::memcpy(&word, data + j * kWordSize, kWordSize);
+      if (word != 0) {
+        indices[n_nonzero] = j;
+        words[n_nonzero++] = word;
+      }
+    }
+    if (n_nonzero > max_nonzero) {
+      return kSparseDenseChunk;
+    }
+  }
+  if (i < n_words) {
+    uint32_t word;
+    std::memcpy(&word, data + i * kWordSize, kWordSize);
+    if (word != 0) {
+      indices[n_nonzero] = i;
+      words[n_nonzero++] = word;
+    }
+  }
+  if (n_nonzero > max_nonzero) {
+    return kSparseDenseChunk;
+  }
+  chunk->resize(sparse_chunk_size(n_nonzero));
+  std::memcpy(&(*chunk)[0], indices.data(), n_nonzero * sizeof(uint16_t));
+  std::memcpy(&(*chunk)[n_nonzero * sizeof(uint16_t)], words.data(), n_nonzero * kWordSize);
+  return n_nonzero;
+}
+
+int64_t sparse_chunk_size(uint32_t n_nonzero) { return int64_t(n_nonzero) * (sizeof(uint16_t) + kWordSize); }
+
+int sparse_chunk_decode(const uint8_t *chunk, uint32_t n_nonzero, uint8_t *data, int64_t size) {
+  const int64_t n_words = size / kWordSize;
+  if (size % kWordSize != 0 || n_nonzero > n_words) {
+    return -1;
+  }
+  std::memset(data, 0, size);
+  const uint8_t *words = chunk + n_nonzero * sizeof(uint16_t);
+  int64_t previous = -1;
+  for (uint32_t k = 0; k < n_nonzero; k++) {
+    uint16_t index;
+    std::memcpy(&index, chunk + k * sizeof(uint16_t), sizeof(index));
+    if (index <= previous || index >= n_words) {
+      return -1;
+    }
+    std::memcpy(data + index * kWordSize, words + k * kWordSize, kWordSize);
+    previous = index;
+  }
+  return 0;
+}
+
+int sparse_chunk_reduce(const uint8_t *chunk, uint32_t n_nonzero, ReduceKernel reduce_kernel, size_t element_size,
+                        uint8_t *data, int64_t size) {
+  const int64_t n_words = size / kWordSize;
+  // the kernel runs on whole elements, and on pairs of 2-byte elements
+  const int64_t unit_size = std::max<int64_t>(element_size, kWordSize);
+  const int64_t unit_words = unit_size / kWordSize;
+  if (size % unit_size != 0 || unit_size % kWordSize != 0 || unit_size > 8 || n_nonzero > n_words) {
+    return -1;
+  }
+  const uint8_t *words = chunk + n_nonzero * sizeof(uint16_t);
+  int64_t previous = -1;
+  uint32_t k = 0;
+  while (k < n_nonzero) {
+    // gather the nonzero words of a unit; its other words are zeros
+    alignas(8) uint8_t operand[8] = {0};
+    int64_t first = -1;
+    for (; k < n_nonzero; k++) {
+      uint16_t index;
+      std::memcpy(&index, chunk + k * sizeof(uint16_t), sizeof(index));
+      if (index <= previous || index >= n_words) {
+        return -1;
+      }
+      if (first >= 0 && index >= first + unit_words) {
+        break;
+      }
+      if (first < 0) {
+        first = index / unit_words * unit_words;
+      }
+      std::memcpy(operand + (index - first) * kWordSize, words + k * kWordSize, kWordSize);
+      previous = index;
+    }
+    reduce_kernel(data + first * kWordSize, operand, unit_size / element_size);
+  }
+  return 0;
+}
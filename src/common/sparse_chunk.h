@@ -0,0 +1,38 @@
+#ifndef SPARSE_CHUNK_H
+#define SPARSE_CHUNK_H
+
+#include <cstdint>
+#include <string>
+
+#include "common/reduce_kernels.h"
+
+/// Sparse chunks carry the nonzero 4-byte words of a range of an object: the uint16 indices of
+/// the words in ascending order, followed by the words. The words are bit patterns, so the
+/// encoding is exact for every element type. A range of up to 65536 words fits in a chunk.
+
+/// The number of nonzero words of a chunk that is sent as it is, because it is too dense.
+constexpr uint32_t kSparseDenseChunk = UINT32_MAX;
+
+/// Encode a range as a sparse chunk.
+/// \param chunk The encoded chunk. It is empty if the range is too dense.
+/// \return The number of nonzero words, or 'kSparseDenseChunk' if the range has more than
+/// HOPLITE_SPARSE_MAX_DENSITY_PERCENT percent nonzero words or is not made of whole words.
+uint32_t sparse_chunk_encode(const uint8_t *data, int64_t size, std::string *chunk);
+
+/// The size of a sparse chunk with 'n_nonzero' words.
+int64_t sparse_chunk_size(uint32_t n_nonzero);
+
+/// Decode a sparse chunk.
+/// \param data The destination, which must hold exactly 'size' bytes.
+/// \return 0 on success, and -1 if the chunk is corrupted.
+int sparse_chunk_decode(const uint8_t *chunk, uint32_t n_nonzero, uint8_t *data, int64_t size);
+
+/// Reduce a sparse chunk into a range without expanding it. Only the elements with nonzero words
+/// are reduced, so it is exact for operations where zero is the identity (SUM).
+/// \param element_size The size of the elements. The words of an element are reduced together.
+/// \param data The destination, which must hold exactly 'size' bytes.
+/// \return 0 on success, and -1 if the chunk is corrupted.
+int sparse_chunk_reduce(const uint8_t *chunk, uint32_t n_nonzero, ReduceKernel reduce_kernel, size_t element_size,
+                        uint8_t *data, int64_t size);
+
+#endif // SPARSE_CHUNK_H
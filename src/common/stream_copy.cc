@@ -0,0 +1,117 @@
+#include "common/stream_copy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HOPLITE_X86_STREAM_COPY
+#endif
+
+namespace {
+
+#ifdef HOPLITE_X86_STREAM_COPY
+
+// Both variants copy an unaligned head with memcpy, so that the streaming stores are aligned,
+// and copy 4 vectors per iteration to keep enough loads in flight.
+
+void nt_copy_sse2(uint8_t *dst, const uint8_t *src, size_t size) {
+  size_t head = std::min(size, (size_t)((16 - ((uintptr_t)dst & 15)) & 15));
+  std::memcpy(dst, src, head);
+  size_t i = head;
+  for (; i + 64 <= size; i += 64) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+    __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+    _mm_stream_si128((__m128i *)(dst + i), a);
+    _mm_stream_si128((__m128i *)(dst + i + 16), b);
+    _mm_stream_si128((__m128i *)(dst + i + 32), c);
+    _mm_stream_si128((__m128i *)(dst + i + 48), d);
+  }
+  std::memcpy(dst + i, src + i, size - i);
+  _mm_sfence();
+}
+
+__attribute__((target("avx"))) void nt_copy_avx(uint8_t *dst, const uint8_t *src, size_t size) {
+  size_t head = std::min(size, (size_t)((32 - ((uintptr_t)dst & 31)) & 31));
+  std::memcpy(dst, src, head);
+  size_t i = head;
+  for (; i + 128 <= size; i += 128) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+    __m256i d = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+    _mm256_stream_si256((__m256i *)(dst + i), a);
+    _mm256_stream_si256((__m256i *)(dst + i + 32), b);
+    _mm256_stream_si256((__m256i *)(dst + i + 64), c);
+    _mm256_stream_si256((__m256i *)(dst + i + 96), d);
+  }
+  std::memcpy(dst + i, src + i, size - i);
+  _mm_sfence();
+}
+
+typedef void (*CopyFunction)(uint8_t *dst, const uint8_t *src, size_t size);
+
+CopyFunction select_nt_copy() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx") ? nt_copy_avx : nt_copy_sse2;
+}
+
+#endif
+
+} // namespace
+
+void NonTemporalCopy(uint8_t *dst, const uint8_t *src, size_t size) {
+#ifdef HOPLITE_X86_STREAM_COPY
+  static const CopyFunction nt_copy = select_nt_copy();
+  nt_copy(dst, src, size);
+#else
+  std::memcpy(dst, src, size);
+  std::atomic_thread_fence(std::memory_order_release);
+#endif
+}
+
+void ParallelStreamCopy(uint8_t *dst, const uint8_t *src, int64_t size, int n_threads, int64_t chunk_size,
+                        ProgressCounter *progress) {
+  const int64_t n_chunks = (size + chunk_size - 1) / chunk_size;
+  std::atomic<int64_t> next_chunk(0);
+  // the chunks that have been copied, and the end of the contiguous prefix of them
+  std::vector<bool> finished(n_chunks, false);
+  int64_t n_prefix_chunks = 0;
+  std::mutex mutex;
+
+  auto worker = [&]() {
+    while (true) {
+      int64_t chunk = next_chunk.fetch_add(1);
+      if (chunk >= n_chunks) {
+        return;
+      }
+      int64_t offset = chunk * chunk_size;
+      NonTemporalCopy(dst + offset, src + offset, std::min(chunk_size, size - offset));
+      std::lock_guard<std::mutex> lock(mutex);
+      finished[chunk] = true;
+      if (chunk != n_prefix_chunks) {
+        // an earlier chunk is still being copied. it will publish this one as well.
+        continue;
+      }
+      while (n_prefix_chunks < n_chunks && finished[n_prefix_chunks]) {
+        n_prefix_chunks++;
+      }
+      progress->Store(std::min(n_prefix_chunks * chunk_size, size));
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min<int64_t>(n_threads, n_chunks); i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
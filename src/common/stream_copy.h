@@ -0,0 +1,27 @@
+#ifndef STREAM_COPY_H
+#define STREAM_COPY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "common/progress_counter.h"
+
+/// Copy 'size' bytes with non-temporal (streaming) stores, which bypass the caches for the
+/// destination. It only pays off for copies much larger than the last level cache. The stores
+/// are fenced before returning, so the copied bytes can be published to other threads.
+void NonTemporalCopy(uint8_t *dst, const uint8_t *src, size_t size);
+
+/// Copy 'size' bytes in chunks with 'n_threads' threads (including the calling one), using
+/// non-temporal stores. Chunks can finish out of order, but 'progress' only advances over the
+/// contiguous prefix that has been copied, so readers can stream the destination while it is
+/// being written.
+/// \param dst The destination. It must not overlap with 'src'.
+/// \param src The source.
+/// \param size The number of bytes to copy.
+/// \param n_threads The number of copying threads.
+/// \param chunk_size The number of bytes copied at a time by each thread.
+/// \param progress The progress of 'dst'. It is stored at most once per chunk.
+void ParallelStreamCopy(uint8_t *dst, const uint8_t *src, int64_t size, int n_threads, int64_t chunk_size,
+                        ProgressCounter *progress);
+
+#endif // STREAM_COPY_H
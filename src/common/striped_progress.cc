@@ -0,0 +1,37 @@
+#include "striped_progress.h"
+
+#include <algorithm>
+
+#include "util/logging.h"
+
+StripedProgress::StripedProgress(Buffer *buffer, std::vector<int64_t> bounds)
+    : buffer_(buffer), bounds_(std::move(bounds)), progress_(bounds_.begin(), bounds_.end() - 1),
+      n_prefix_ranges_(0) {
+  DCHECK(bounds_.size() >= 2) << "There must be at least one range.";
+}
+
+void StripedProgress::Update(size_t range, int64_t progress) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  progress_[range] = progress;
+  if (range != n_prefix_ranges_) {
+    // a range after a gap. the buffer advances once the gap is filled.
+    return;
+  }
+  while (n_prefix_ranges_ < Size() && progress_[n_prefix_ranges_] >= End(n_prefix_ranges_)) {
+    n_prefix_ranges_++;
+  }
+  buffer_->SetProgress(n_prefix_ranges_ < Size() ? progress_[n_prefix_ranges_] : bounds_.back());
+}
+
+std::vector<int64_t> StripedProgress::Split(int64_t begin, int64_t end, int n_ranges, int64_t alignment) {
+  std::vector<int64_t> bounds{begin};
+  for (int i = 1; i < n_ranges; i++) {
+    int64_t bound = begin + (end - begin) * i / n_ranges;
+    bound = begin + (bound - begin) / alignment * alignment;
+    if (bound > bounds.back()) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(end);
+  return bounds;
+}
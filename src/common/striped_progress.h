@@ -0,0 +1,44 @@
+#ifndef STRIPED_PROGRESS_H
+#define STRIPED_PROGRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "common/buffer.h"
+
+/// Merges the progress of ranges of a buffer that are written in parallel (e.g. received over
+/// several connections) into the progress of the buffer. Ranges can advance in any order, but
+/// the buffer only advances over the contiguous prefix that has been written, so readers can
+/// stream it as usual.
+class StripedProgress {
+public:
+  /// \param buffer The buffer. Its progress must be 'bounds.front()'.
+  /// \param bounds The boundaries of the ranges: range i is [bounds[i], bounds[i + 1]).
+  StripedProgress(Buffer *buffer, std::vector<int64_t> bounds);
+
+  /// The number of ranges.
+  size_t Size() const { return bounds_.size() - 1; }
+
+  int64_t Begin(size_t range) const { return bounds_[range]; }
+
+  int64_t End(size_t range) const { return bounds_[range + 1]; }
+
+  /// Publish the progress of a range, i.e. the end of the written prefix of the range.
+  void Update(size_t range, int64_t progress);
+
+  /// Split [begin, end) into ranges of about the same size.
+  /// \param alignment The alignment of the boundaries relative to 'begin', e.g. the element size.
+  static std::vector<int64_t> Split(int64_t begin, int64_t end, int n_ranges, int64_t alignment);
+
+private:
+  Buffer *const buffer_;
+  const std::vector<int64_t> bounds_;
+  std::mutex mutex_;
+  std::vector<int64_t> progress_;
+  // the first range that is not finished
+  size_t n_prefix_ranges_;
+};
+
+#endif // STRIPED_PROGRESS_H
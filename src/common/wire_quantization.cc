@@ -0,0 +1,144 @@
+#include "wire_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common/config.h"
+#include "common/half_float.h"
+#include "util/logging.h"
+
+namespace {
+
+constexpr int64_t kWireBlockBytes = HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float);
+
+// Encode the elements one by one. With a residual, every element is compensated with its
+// residual first, and the residual becomes the error of the encoded element.
+template <typename Encode, typename Decode>
+void encode_elements(const float *src, int64_t n_elements, float *residual, Encode encode, Decode decode) {
+  if (!residual) {
+    for (int64_t i = 0; i < n_elements; i++) {
+      encode(i, src[i]);
+    }
+    return;
+  }
+  for (int64_t i = 0; i < n_elements; i++) {
+    float value = src[i] + residual[i];
+    residual[i] = value - decode(encode(i, value));
+  }
+}
+
+} // namespace
+
+const char *WireFormatName(WireFormat format) {
+  switch (format) {
+  case WireFormat::RAW:
+    return "raw";
+  case WireFormat::FLOAT16:
+    return "float16";
+  case WireFormat::BFLOAT16:
+    return "bfloat16";
+  case WireFormat::INT8:
+    return "int8";
+  case WireFormat::SPARSE:
+    return "sparse";
+  }
+  return "unknown";
+}
+
+int64_t wire_block_end(int64_t offset, int64_t cursor, int64_t end) {
+  return std::min(offset + ((cursor - offset) / kWireBlockBytes + 1) * kWireBlockBytes, end);
+}
+
+int64_t wire_block_size(WireFormat format, int64_t n_elements) {
+  switch (format) {
+  case WireFormat::FLOAT16:
+  case WireFormat::BFLOAT16:
+    return n_elements * sizeof(uint16_t);
+  case WireFormat::INT8:
+    return sizeof(float) + n_elements;
+  default:
+    return n_elements * sizeof(float);
+  }
+}
+
+void wire_encode(WireFormat format, const float *src, int64_t n_elements, uint8_t *dst, float *residual) {
+  switch (format) {
+  case WireFormat::FLOAT16: {
+    uint16_t *out = (uint16_t *)dst;
+    encode_elements(
+        src, n_elements, residual, [out](int64_t i, float x) { return out[i] = float_to_fp16(x); },
+        [](uint16_t h) { return fp16_to_float(h); });
+  } break;
+  case WireFormat::BFLOAT16: {
+    uint16_t *out = (uint16_t *)dst;
+    encode_elements(
+        src, n_elements, residual, [out](int64_t i, float x) { return out[i] = float_to_bf16(x); },
+        [](uint16_t h) { return bf16_to_float(h); });
+  } break;
+  case WireFormat::INT8: {
+    float max_magnitude = 0;
+    for (int64_t i = 0; i < n_elements; i++) {
+      max_magnitude = std::max(max_magnitude, std::fabs(residual ? src[i] + residual[i] : src[i]));
+    }
+    const float scale = max_magnitude / 127;
+    const float inverse_scale = scale > 0 ? 1 / scale : 0;
+    std::memcpy(dst, &scale, sizeof(scale));
+    int8_t *out = (int8_t *)(dst + sizeof(scale));
+    encode_elements(
+        src, n_elements, residual,
+        [out, inverse_scale](int64_t i, float x) {
+          return out[i] = (int8_t)std::max(-127.0f, std::min(127.0f, std::nearbyint(x * inverse_scale)));
+        },
+        [scale](int8_t q) { return q * scale; });
+  } break;
+  default: {
+    float *out = (float *)dst;
+    encode_elements(
+        src, n_elements, residual, [out](int64_t i, float x) { return out[i] = x; }, [](float x) { return x; });
+  }
+  }
+}
+
+void wire_decode(WireFormat format, const uint8_t *src, int64_t n_elements, float *dst) {
+  switch (format) {
+  case WireFormat::FLOAT16: {
+    const uint16_t *in = (const uint16_t *)src;
+    for (int64_t i = 0; i < n_elements; i++) {
+      dst[i] = fp16_to_float(in[i]);
+    }
+  } break;
+  case WireFormat::BFLOAT16: {
+    const uint16_t *in = (const uint16_t *)src;
+    for (int64_t i = 0; i < n_elements; i++) {
+      dst[i] = bf16_to_float(in[i]);
+    }
+  } break;
+  case WireFormat::INT8: {
+    float scale;
+    std::memcpy(&scale, src, sizeof(scale));
+    const int8_t *in = (const int8_t *)(src + sizeof(scale));
+    for (int64_t i = 0; i < n_elements; i++) {
+      dst[i] = in[i] * scale;
+    }
+  } break;
+  default:
+    std::memcpy(dst, src, n_elements * sizeof(float));
+  }
+}
+
+void ErrorFeedback::Encode(WireFormat format, const ObjectID &transfer_id, const float *src, int64_t begin,
+                           int64_t n_elements, uint8_t *dst) {
+  DCHECK(begin + n_elements <= Size()) << "The block is out of the residual.";
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (transfer_id != transfer_id_) {
+    transfer_id_ = transfer_id;
+    applied_end_ = 0;
+  }
+  if (begin < applied_end_) {
+    wire_encode(format, src, n_elements, dst, nullptr);
+    return;
+  }
+  wire_encode(format, src, n_elements, dst, residual_.data() + begin);
+  applied_end_ = begin + n_elements;
+}
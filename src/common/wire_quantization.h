@@ -0,0 +1,75 @@
+#ifndef WIRE_QUANTIZATION_H
+#define WIRE_QUANTIZATION_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "common/id.h"
+
+/// Formats of float32 elements on the wire. The values match 'objectstore::WireFormat'.
+/// FLOAT16 and BFLOAT16 round every element to nearest even. INT8 stores a float32 scale per
+/// block, and every element as round(x / scale) with the scale mapping the largest magnitude
+/// of the block to 127. The elements must be finite.
+/// SPARSE is exact and works for every element type: blocks that are mostly zeros are sent as
+/// sparse chunks (see 'common/sparse_chunk.h'), and the other blocks as they are.
+enum class WireFormat : int { RAW = 0, FLOAT16 = 1, BFLOAT16 = 2, INT8 = 3, SPARSE = 4 };
+
+const char *WireFormatName(WireFormat format);
+
+/// How the partial results of a reduction are sent between the nodes of the reduce tree. The
+/// receivers decode them before reducing, so the reduction itself is always computed in the
+/// element type of the reduction. Only SPARSE applies to types other than float32.
+struct WireQuantization {
+  WireFormat format = WireFormat::RAW;
+  /// The senders keep the quantization error of what they send under this id, and add it to
+  /// what they send for the next reduction with the same id (error feedback). 0 disables it.
+  /// SPARSE has no error to keep.
+  int64_t error_feedback_id = 0;
+};
+
+/// The end of the wire block that contains 'cursor'. Blocks hold HOPLITE_WIRE_BLOCK_ELEMENTS
+/// elements from the beginning of the transfer.
+/// \param offset The beginning of the transfer in bytes.
+/// \param cursor A position of the transfer in bytes.
+/// \param end The end of the transfer in bytes.
+int64_t wire_block_end(int64_t offset, int64_t cursor, int64_t end);
+
+/// The number of bytes that 'n_elements' float32 elements take on the wire. For INT8, the
+/// elements must be one block. For SPARSE, it is the size of a dense block.
+int64_t wire_block_size(WireFormat format, int64_t n_elements);
+
+/// Encode a block of float32 elements.
+/// \param residual The error feedback of the elements, or nullptr. It is added to the elements
+/// before they are quantized, and replaced by the new quantization error.
+void wire_encode(WireFormat format, const float *src, int64_t n_elements, uint8_t *dst, float *residual);
+
+/// Decode a block of float32 elements.
+void wire_decode(WireFormat format, const uint8_t *src, int64_t n_elements, float *dst);
+
+/// The quantization error that a sender carries over between the reductions with the same
+/// error feedback id.
+class ErrorFeedback {
+public:
+  explicit ErrorFeedback(int64_t n_elements) : residual_(n_elements, 0.0f) {}
+
+  /// The number of elements.
+  int64_t Size() const { return residual_.size(); }
+
+  /// Encode a block of a transfer with the residual.
+  /// \param transfer_id The object or reduction being sent. A block that is sent again in the
+  /// same transfer, e.g. after its receiver has failed, is encoded without the residual,
+  /// because the block has consumed it already.
+  /// \param begin The index of the first element of the block.
+  void Encode(WireFormat format, const ObjectID &transfer_id, const float *src, int64_t begin, int64_t n_elements,
+              uint8_t *dst);
+
+private:
+  std::mutex mutex_;
+  std::vector<float> residual_;
+  ObjectID transfer_id_;
+  // the end of the elements of the current transfer that have consumed the residual
+  int64_t applied_end_ = 0;
+};
+
+#endif // WIRE_QUANTIZATION_H
@@ -56,6 +56,25 @@ bool ObjectDependency::Get(const std::string &receiver, bool occupying, int64_t
   return get_impl_(receiver, occupying, object_size, sender, inband_data, on_fail);
 }
 
+std::vector<std::string> ObjectDependency::GetCompleteHolders(const std::string &receiver, const std::string &sender,
+                                                              size_t max_holders) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // the first node of a chain may still be writing the object, so only the finished copies are
+  // used. ranges pulled from an unfinished copy would wait for its progress.
+  std::vector<std::string> candidates;
+  for (const auto &node : finished_holders_) {
+    if (node != receiver && node != sender) {
+      candidates.push_back(node);
+    }
+  }
+  std::vector<std::string> holders;
+  for (size_t i = 0; i < candidates.size() && holders.size() < max_holders; i++) {
+    holders.push_back(candidates[(holder_rotation_ + i) % candidates.size()]);
+  }
+  holder_rotation_ += holders.size();
+  return holders;
+}
+
 bool ObjectDependency::Available() const { return !inband_data_.empty() || !available_keys_.empty(); }
 
 bool ObjectDependency::get_impl_(const std::string &receiver, bool occupying, int64_t *object_size, std::string *sender,
@@ -102,7 +121,7 @@ bool ObjectDependency::get_impl_(const std::string &receiver, bool occupying, in
   return true;
 }
 
-void ObjectDependency::HandleCompletion(const std::string &receiver, int64_t object_size) {
+void ObjectDependency::HandleCompletion(const std::string &receiver, int64_t object_size, bool finished) {
   TIMELINE("ObjectDependency::HandleCompletion");
   LOG(DEBUG) << "[Dependency] handles completion for " << object_id_.ToString() << ", size=" << object_size;
   std::unique_lock<std::mutex> lock(mutex_);
@@ -111,6 +130,9 @@ void ObjectDependency::HandleCompletion(const std::string &receiver, int64_t obj
   } else {
     DCHECK(object_size_ == object_size) << "Size of object " << object_id_.Hex() << " has changed.";
   }
+  if (finished) {
+    finished_holders_.insert(receiver);
+  }
   if (!node_to_chain_.count(receiver)) {
     LOG(DEBUG) << "[Dependency] handles completion for the initial object of " << object_id_.ToString()
                << " created by " << receiver;
@@ -143,6 +165,10 @@ void ObjectDependency::HandleCompletion(const std::string &receiver, int64_t obj
       c->pop_front();
       updated = true;
       create_new_chain(n);
+      if (finished) {
+        // the receiver got every byte through them, so their copies are finished as well
+        finished_holders_.insert(n);
+      }
     }
     DCHECK(!c->empty()) << "We assume that each chain should have length >= 1. (node=" << receiver << ")."
                         << DebugPrint();
@@ -189,6 +215,7 @@ bool ObjectDependency::HandleFailure(const std::string &receiver, std::string *a
   int64_t key = reversed_map_[c];
   // erase the sender
   node_to_chain_.erase(sender);
+  finished_holders_.erase(sender);
   recevier_to_sender_.erase(receiver);
 
   // remove the sender in the middle of the chain and connect both side
@@ -9,6 +9,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/id.h"
 
@@ -43,6 +44,16 @@ public:
   bool Get(const std::string &receiver, bool occupying, int64_t *object_size, std::string *sender,
            std::string *inband_data, const std::function<void()>& on_fail = nullptr);
 
+  /// Get other nodes whose copy of the object is known to be finished, so that a receiver can
+  /// pull disjoint ranges of it from all of them at once without waiting for their progress.
+  /// The nodes are rotated across calls, so that receivers spread over the holders.
+  /// \param[in] receiver The receiver, which is never returned.
+  /// \param[in] sender The sender returned by 'Get' for the receiver, which is never returned.
+  /// \param[in] max_holders The maximum number of nodes to return.
+  /// \return The nodes.
+  std::vector<std::string> GetCompleteHolders(const std::string &receiver, const std::string &sender,
+                                              size_t max_holders);
+
   /// A shortcut check of the availability.
   bool Available() const;
 
@@ -50,7 +61,10 @@ public:
   /// receivers.
   /// \param[in] receiver The receiver that has the complete object.
   /// \param[in] object_size The size of the complete object.
-  void HandleCompletion(const std::string &receiver, int64_t object_size);
+  /// \param[in] finished Whether the copy of the receiver is finished. A streaming Put or the root of
+  /// a reduction is located while it is still being written, and only becomes a complete holder
+  /// once a node that received from it has finished.
+  void HandleCompletion(const std::string &receiver, int64_t object_size, bool finished);
 
   /// The receiver declares it has got a complete object. The object is so small that we directly keeps it here.
   /// \param[in] inband_data The complete small object.
@@ -92,14 +106,16 @@ private:
 
   ObjectID object_id_;
   int64_t object_size_ = -1;
-  // TODO: We should implement LRU gabage collection for the inband data
-  // storage. But it doesn't matter now because these data take too few
-  // space.
+  // The inband data is dropped together with the dependency when the object is deleted.
   std::string inband_data_;
   std::function<void(const ObjectID &)> object_ready_callback_;
 
   std::mutex mutex_;
   std::atomic<int64_t> index_;
+  // rotates the holders returned by 'GetCompleteHolders'
+  size_t holder_rotation_ = 0;
+  // the nodes whose copy is finished
+  std::unordered_set<std::string> finished_holders_;
 
   std::unordered_map<std::string, std::shared_ptr<chain_type>> node_to_chain_;
   std::unordered_map<int64_t, std::shared_ptr<chain_type>> chains_;
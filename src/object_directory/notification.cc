@@ -19,6 +19,8 @@
 #include "util/logging.h"
 #include "util/socket_utils.h"
 
+using objectstore::AddObjectsToGroupReply;
+using objectstore::AddObjectsToGroupRequest;
 using objectstore::BarrierReply;
 using objectstore::BarrierRequest;
 using objectstore::ConnectListenerReply;
@@ -27,10 +29,16 @@ using objectstore::ConnectReply;
 using objectstore::ConnectRequest;
 using objectstore::CreateReduceTaskReply;
 using objectstore::CreateReduceTaskRequest;
+using objectstore::DeleteLocalObjectsReply;
+using objectstore::DeleteLocalObjectsRequest;
+using objectstore::DeleteObjectsReply;
+using objectstore::DeleteObjectsRequest;
 using objectstore::ExitReply;
 using objectstore::ExitRequest;
 using objectstore::GetLocationSyncReply;
 using objectstore::GetLocationSyncRequest;
+using objectstore::GetLocationsSyncReply;
+using objectstore::GetLocationsSyncRequest;
 using objectstore::GetReducedObjectsReply;
 using objectstore::GetReducedObjectsRequest;
 using objectstore::HandlePullObjectFailureReply;
@@ -41,6 +49,8 @@ using objectstore::PullAndReduceObjectReply;
 using objectstore::PullAndReduceObjectRequest;
 using objectstore::ReduceInbandObjectReply;
 using objectstore::ReduceInbandObjectRequest;
+using objectstore::UpdateObjectReferencesReply;
+using objectstore::UpdateObjectReferencesRequest;
 using objectstore::WriteLocationReply;
 using objectstore::WriteLocationRequest;
 
@@ -58,6 +68,9 @@ public:
   grpc::Status GetLocationSync(grpc::ServerContext *context, const GetLocationSyncRequest *request,
                                GetLocationSyncReply *reply) override;
 
+  grpc::Status GetLocationsSync(grpc::ServerContext *context, const GetLocationsSyncRequest *request,
+                                GetLocationsSyncReply *reply) override;
+
   grpc::Status HandlePullObjectFailure(grpc::ServerContext *context, const HandlePullObjectFailureRequest *request,
                                        HandlePullObjectFailureReply *reply) override;
 
@@ -65,7 +78,8 @@ public:
                                 CreateReduceTaskReply *reply) override;
 
   void InvokePullAndReduceObject(Node *receiver_node, const Node *sender_node, const ObjectID &reduction_id,
-                                 int64_t object_size, bool reset_progress);
+                                 int64_t object_size, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                                 const WireQuantization &quantization, bool reset_progress);
 
   void InvokeReduceInbandObject(const std::string &receiver_ip, const ObjectID &reduction_id,
                                 const std::string &inband_data);
@@ -79,6 +93,15 @@ public:
   grpc::Status GetReducedObjects(grpc::ServerContext *context, const GetReducedObjectsRequest *request,
                                  GetReducedObjectsReply *reply) override;
 
+  grpc::Status UpdateObjectReferences(grpc::ServerContext *context, const UpdateObjectReferencesRequest *request,
+                                      UpdateObjectReferencesReply *reply) override;
+
+  grpc::Status AddObjectsToGroup(grpc::ServerContext *context, const AddObjectsToGroupRequest *request,
+                                 AddObjectsToGroupReply *reply) override;
+
+  grpc::Status DeleteObjects(grpc::ServerContext *context, const DeleteObjectsRequest *request,
+                             DeleteObjectsReply *reply) override;
+
 private:
   objectstore::NotificationListener::Stub *
   create_or_get_notification_listener_stub(const std::string &remote_grpc_address);
@@ -90,6 +113,13 @@ private:
   void add_object_for_reduce(const ObjectID &object_id, int64_t object_size, const std::string &owner_ip,
                              const std::string &inband_data);
 
+  /// Forget objects in the directory and delete them on every node.
+  void delete_objects(const std::vector<ObjectID> &object_ids);
+
+  /// Forget the references and the group of an object. It must be called with
+  /// 'object_lifetime_mutex_' held.
+  void forget_object_lifetime_unsafe(const ObjectID &object_id);
+
   std::atomic<int> barrier_arrive_counter_;
   std::atomic<int> barrier_leave_counter_;
 
@@ -120,7 +150,13 @@ private:
     }
     std::queue<ReceiverQueueElement> PopQueue(const ObjectID &object_id) {
       std::lock_guard<std::mutex> lock(mutex_);
-      return std::move(pending_objects_[object_id]);
+      auto search = pending_objects_.find(object_id);
+      if (search == pending_objects_.end()) {
+        return {};
+      }
+      std::queue<ReceiverQueueElement> q = std::move(search->second);
+      pending_objects_.erase(search);
+      return q;
     }
 
   private:
@@ -135,12 +171,22 @@ private:
       notification_listener_stub_pool_;
   std::mutex channel_pool_mutex_;
 
+  // nodes that have connected to the directory
+  std::unordered_set<std::string> connected_nodes_;
+  std::mutex connected_nodes_mutex_;
+
   // thread pool for launching tasks
   ctpl::thread_pool thread_pool_;
 
   std::mutex object_dependencies_mutex_;
   std::unordered_map<ObjectID, std::shared_ptr<ObjectDependency>> object_dependencies_;
 
+  // for object lifetime. objects without an entry in 'object_references_' have one reference.
+  std::mutex object_lifetime_mutex_;
+  std::unordered_map<ObjectID, int64_t> object_references_;
+  std::unordered_map<int64_t, std::unordered_set<ObjectID>> object_groups_;
+  std::unordered_map<ObjectID, int64_t> group_of_object_;
+
   // for reduce tasks
   ReduceManager reduce_manager_;
   std::mutex reduce_manager_mutex_;
@@ -178,6 +224,15 @@ grpc::Status NotificationServiceImpl::Connect(grpc::ServerContext *context, cons
   auto status = notification_listener_stub_pool_[sender_address]->ConnectListener(&client_context, connect_request,
                                                                                   &connect_reply);
   DCHECK(status.ok()) << "Connect to " << sender_address << " failed: " << status.error_message();
+  {
+    std::lock_guard<std::mutex> lock(connected_nodes_mutex_);
+    for (const auto &node : connected_nodes_) {
+      if (node != request->sender_ip()) {
+        reply->add_peer_ips(node);
+      }
+    }
+    connected_nodes_.insert(request->sender_ip());
+  }
 
   LOG(INFO) << "Create succeeds on the notification server";
   return grpc::Status::OK;
@@ -207,10 +262,15 @@ void NotificationServiceImpl::add_object_for_reduce(const ObjectID &object_id, i
         RecoverReduceTaskFromFailure(reduction_id, n);
         continue;
       }
+      std::shared_ptr<ReduceTask> task = reduce_manager_.GetReduceTask(reduction_id);
+      ReduceOp reduce_op = task->GetReduceOp();
+      ReduceDataType reduce_dtype = task->GetReduceDataType();
+      WireQuantization quantization = task->GetWireQuantization();
       // check if we have a child dependency
       if (n->left_child && n->left_child->location_known()) {
-        thread_pool_.push([this, n, reduction_id, object_size](int id) {
-          InvokePullAndReduceObject(n, n->left_child, reduction_id, object_size, false);
+        thread_pool_.push([this, n, reduction_id, object_size, reduce_op, reduce_dtype, quantization](int id) {
+          InvokePullAndReduceObject(n, n->left_child, reduction_id, object_size, reduce_op, reduce_dtype,
+                                    quantization, false);
         });
       }
       if (n->right_child && n->right_child->location_known()) {
@@ -219,15 +279,17 @@ void NotificationServiceImpl::add_object_for_reduce(const ObjectID &object_id, i
       // check if we have a parent dependency
       // FIXME: should we consider this code path in `RecoverReduceTaskFromFailure`?
       if (n->parent && n->parent->location_known()) {
-        thread_pool_.push([this, n, reduction_id, object_size](int id) {
-          InvokePullAndReduceObject(n->parent, n, reduction_id, object_size, false);
+        thread_pool_.push([this, n, reduction_id, object_size, reduce_op, reduce_dtype, quantization](int id) {
+          InvokePullAndReduceObject(n->parent, n, reduction_id, object_size, reduce_op, reduce_dtype, quantization,
+                                    false);
         });
         // now we can publish the reduction id
         if (n->parent->is_root()) {
           auto dep = get_dependency(reduction_id);
           // the root could be registered twice, so we check the availability first
           if (!dep->Available()) {
-            dep->HandleCompletion(n->parent->owner_ip, object_size);
+            // the root is located before the reduction is finished
+            dep->HandleCompletion(n->parent->owner_ip, object_size, /*finished=*/false);
           }
         }
       }
@@ -291,13 +353,11 @@ grpc::Status NotificationServiceImpl::WriteLocation(grpc::ServerContext *context
   TIMELINE("NotificationServiceImpl::WriteLocation");
   ObjectID object_id = ObjectID::FromBinary(request->object_id());
   const std::string &sender_ip = request->sender_ip();
-  // bool finished = request->finished();
-  // TODO(siyuan): deal with 'finished' property
   std::shared_ptr<ObjectDependency> dep = get_dependency(object_id);
   if (request->has_inband_data_case() == WriteLocationRequest::kInbandData) {
     dep->HandleInbandCompletion(request->inband_data());
   } else {
-    dep->HandleCompletion(sender_ip, request->object_size());
+    dep->HandleCompletion(sender_ip, request->object_size(), request->finished());
   }
   reply->set_ok(true);
   return grpc::Status::OK;
@@ -334,6 +394,11 @@ grpc::Status NotificationServiceImpl::GetLocationSync(grpc::ServerContext *conte
   } else {
     LOG(DEBUG) << "The location of " << object_id.ToString() << " is already know. "
                << "sender_ip = " << sender_ip << ", object_size = " << object_size;
+    if (inband_data.empty() && request->max_extra_senders() > 0) {
+      for (auto &holder : dep->GetCompleteHolders(receiver_ip, sender_ip, request->max_extra_senders())) {
+        reply->add_extra_sender_ips(std::move(holder));
+      }
+    }
     reply->set_sender_ip(std::move(sender_ip));
     reply->set_object_size(object_size);
     reply->set_inband_data(std::move(inband_data));
@@ -341,6 +406,51 @@ grpc::Status NotificationServiceImpl::GetLocationSync(grpc::ServerContext *conte
   return grpc::Status::OK;
 }
 
+grpc::Status NotificationServiceImpl::GetLocationsSync(grpc::ServerContext *context,
+                                                       const GetLocationsSyncRequest *request,
+                                                       GetLocationsSyncReply *reply) {
+  TIMELINE("NotificationServiceImpl::GetLocationsSync");
+  const std::string &receiver_ip = request->receiver_ip();
+  // the replies must not move while they are pending
+  for (int i = 0; i < request->object_ids_size(); i++) {
+    reply->add_locations();
+  }
+  // locate all objects first, so that the objects that are not ready are waited for together
+  std::vector<std::shared_ptr<std::mutex>> sync_mutexes;
+  for (int i = 0; i < request->object_ids_size(); i++) {
+    ObjectID object_id = ObjectID::FromBinary(request->object_ids(i));
+    GetLocationSyncReply *location = reply->mutable_locations(i);
+    int64_t object_size;
+    std::string inband_data;
+    std::string sender_ip;
+    std::shared_ptr<std::mutex> sync_mutex;
+    std::shared_ptr<ObjectDependency> dep = get_dependency(object_id);
+    bool success = dep->Get(receiver_ip, request->occupying(), &object_size, &sender_ip, &inband_data, [&]() {
+      sync_mutex = std::make_shared<std::mutex>();
+      sync_mutex->lock();
+      pending_queue_.EnqueueGetLocationSync(object_id, sync_mutex, location, receiver_ip, request->occupying());
+    });
+    if (!success) {
+      sync_mutexes.push_back(sync_mutex);
+    } else {
+      if (inband_data.empty() && request->max_extra_senders() > 0) {
+        for (auto &holder : dep->GetCompleteHolders(receiver_ip, sender_ip, request->max_extra_senders())) {
+          location->add_extra_sender_ips(std::move(holder));
+        }
+      }
+      location->set_sender_ip(std::move(sender_ip));
+      location->set_object_size(object_size);
+      location->set_inband_data(std::move(inband_data));
+    }
+  }
+  LOG(DEBUG) << "The locations of " << sync_mutexes.size() << " out of " << request->object_ids_size()
+             << " objects are unavailable yet. Waiting for further notification.";
+  for (auto &sync_mutex : sync_mutexes) {
+    sync_mutex->lock();
+  }
+  return grpc::Status::OK;
+}
+
 grpc::Status NotificationServiceImpl::HandlePullObjectFailure(grpc::ServerContext *context,
                                                               const HandlePullObjectFailureRequest *request,
                                                               HandlePullObjectFailureReply *reply) {
@@ -362,10 +472,19 @@ grpc::Status NotificationServiceImpl::CreateReduceTask(grpc::ServerContext *cont
   for (auto &object_id_it : request->objects_to_reduce()) {
     objects_to_reduce.push_back(ObjectID::FromBinary(object_id_it));
   }
+  bool created;
   {
     std::lock_guard<std::mutex> lock(reduce_manager_mutex_);
-    reduce_manager_.CreateReduceTask(request->reduce_dst(), objects_to_reduce, reduction_id,
-                                     request->num_reduce_objects());
+    created = reduce_manager_.CreateReduceTask(
+        request->reduce_dst(), objects_to_reduce, reduction_id, request->num_reduce_objects(),
+        static_cast<ReduceOp>(request->reduce_op()), static_cast<ReduceDataType>(request->reduce_dtype()),
+        {static_cast<WireFormat>(request->quantization().format()), request->quantization().error_feedback_id()});
+  }
+  reply->set_created(created);
+  if (!created) {
+    LOG(ERROR) << request->reduce_dst() << " creates a reduce task for " << reduction_id.ToString()
+               << ", which is already being reduced.";
+    return grpc::Status::OK;
   }
 
   for (auto &object_id : objects_to_reduce) {
@@ -402,6 +521,118 @@ grpc::Status NotificationServiceImpl::GetReducedObjects(grpc::ServerContext *con
   return grpc::Status::OK;
 }
 
+grpc::Status NotificationServiceImpl::UpdateObjectReferences(grpc::ServerContext *context,
+                                                             const UpdateObjectReferencesRequest *request,
+                                                             UpdateObjectReferencesReply *reply) {
+  TIMELINE("NotificationServiceImpl::UpdateObjectReferences");
+  std::vector<ObjectID> released_objects;
+  {
+    std::lock_guard<std::mutex> lock(object_lifetime_mutex_);
+    for (const auto &object_id_str : request->object_ids()) {
+      ObjectID object_id = ObjectID::FromBinary(object_id_str);
+      int64_t &references = object_references_.emplace(object_id, 1).first->second;
+      references += request->delta();
+      if (references <= 0) {
+        released_objects.push_back(object_id);
+        forget_object_lifetime_unsafe(object_id);
+      }
+    }
+  }
+  if (!released_objects.empty()) {
+    delete_objects(released_objects);
+  }
+  return grpc::Status::OK;
+}
+
+grpc::Status NotificationServiceImpl::AddObjectsToGroup(grpc::ServerContext *context,
+                                                        const AddObjectsToGroupRequest *request,
+                                                        AddObjectsToGroupReply *reply) {
+  TIMELINE("NotificationServiceImpl::AddObjectsToGroup");
+  std::lock_guard<std::mutex> lock(object_lifetime_mutex_);
+  for (const auto &object_id_str : request->object_ids()) {
+    ObjectID object_id = ObjectID::FromBinary(object_id_str);
+    auto search = group_of_object_.find(object_id);
+    if (search != group_of_object_.end()) {
+      object_groups_[search->second].erase(object_id);
+    }
+    group_of_object_[object_id] = request->group();
+    object_groups_[request->group()].insert(object_id);
+  }
+  return grpc::Status::OK;
+}
+
+grpc::Status NotificationServiceImpl::DeleteObjects(grpc::ServerContext *context, const DeleteObjectsRequest *request,
+                                                    DeleteObjectsReply *reply) {
+  TIMELINE("NotificationServiceImpl::DeleteObjects");
+  std::vector<ObjectID> object_ids;
+  for (const auto &object_id_str : request->object_ids()) {
+    object_ids.push_back(ObjectID::FromBinary(object_id_str));
+  }
+  {
+    std::lock_guard<std::mutex> lock(object_lifetime_mutex_);
+    for (int64_t group : request->groups()) {
+      auto search = object_groups_.find(group);
+      if (search != object_groups_.end()) {
+        object_ids.insert(object_ids.end(), search->second.begin(), search->second.end());
+      }
+    }
+    for (const auto &object_id : object_ids) {
+      forget_object_lifetime_unsafe(object_id);
+    }
+  }
+  if (!object_ids.empty()) {
+    delete_objects(object_ids);
+  }
+  return grpc::Status::OK;
+}
+
+void NotificationServiceImpl::forget_object_lifetime_unsafe(const ObjectID &object_id) {
+  object_references_.erase(object_id);
+  auto search = group_of_object_.find(object_id);
+  if (search != group_of_object_.end()) {
+    auto group = object_groups_.find(search->second);
+    group->second.erase(object_id);
+    if (group->second.empty()) {
+      object_groups_.erase(group);
+    }
+    group_of_object_.erase(search);
+  }
+}
+
+void NotificationServiceImpl::delete_objects(const std::vector<ObjectID> &object_ids) {
+  TIMELINE("notification delete_objects");
+  {
+    // on-going requests keep their references to the dependencies, so they are not affected
+    std::lock_guard<std::mutex> lock(object_dependencies_mutex_);
+    for (const auto &object_id : object_ids) {
+      object_dependencies_.erase(object_id);
+    }
+  }
+  DeleteLocalObjectsRequest request;
+  for (const auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  std::vector<std::string> nodes;
+  {
+    std::lock_guard<std::mutex> lock(connected_nodes_mutex_);
+    nodes.assign(connected_nodes_.begin(), connected_nodes_.end());
+  }
+  // we do not track which nodes hold copies, so every node is asked to delete the objects
+  for (const auto &node : nodes) {
+    thread_pool_.push([this, node, request](int id) {
+      TIMELINE("notification DeleteLocalObjects");
+      auto remote_address = node + ":" + std::to_string(notification_listener_port_);
+      objectstore::NotificationListener::Stub *stub = create_or_get_notification_listener_stub(remote_address);
+      grpc::ClientContext context;
+      DeleteLocalObjectsReply reply;
+      auto status = stub->DeleteLocalObjects(&context, request, &reply);
+      if (!status.ok()) {
+        LOG(ERROR) << "DeleteLocalObjects failed for " << node << ": " << status.error_message();
+      }
+    });
+  }
+}
+
 grpc::Status
 NotificationServiceImpl::HandleReceiveReducedObjectFailure(grpc::ServerContext *context,
                                                            const HandleReceiveReducedObjectFailureRequest *request,
@@ -433,19 +664,25 @@ void NotificationServiceImpl::RecoverReduceTaskFromFailure(const ObjectID &reduc
   DCHECK(failed_node->failed);
   std::shared_ptr<ReduceTask> task = reduce_manager_.GetReduceTask(reduction_id);
   const int64_t object_size = task->GetObjectSize();
+  const ReduceOp reduce_op = task->GetReduceOp();
+  const ReduceDataType reduce_dtype = task->GetReduceDataType();
+  const WireQuantization quantization = task->GetWireQuantization();
   LOG(DEBUG) << "RecoverReduceTaskFromFailure: " << task->DebugString();
   // check if we have a child dependency
   if (failed_node->left_child && failed_node->left_child->location_known()) {
-    InvokePullAndReduceObject(failed_node, failed_node->left_child, reduction_id, object_size, false);
+    InvokePullAndReduceObject(failed_node, failed_node->left_child, reduction_id, object_size, reduce_op,
+                              reduce_dtype, quantization, false);
   }
   if (failed_node->right_child && failed_node->right_child->location_known()) {
-    InvokePullAndReduceObject(failed_node, failed_node->right_child, reduction_id, object_size, false);
+    InvokePullAndReduceObject(failed_node, failed_node->right_child, reduction_id, object_size, reduce_op,
+                              reduce_dtype, quantization, false);
   }
   // FIXME: should we invoke it in reversed order?
   Node *prev_node = failed_node;
   for (Node *cursor = failed_node->parent; cursor && cursor->location_known(); cursor = cursor->parent) {
     LOG(DEBUG) << "Resetting node " << cursor->owner_ip;
-    InvokePullAndReduceObject(cursor, prev_node, reduction_id, object_size, true);
+    InvokePullAndReduceObject(cursor, prev_node, reduction_id, object_size, reduce_op, reduce_dtype, quantization,
+                              true);
     prev_node = cursor;
   }
   failed_node->failed = false;
@@ -453,7 +690,8 @@ void NotificationServiceImpl::RecoverReduceTaskFromFailure(const ObjectID &reduc
 
 void NotificationServiceImpl::InvokePullAndReduceObject(Node *receiver_node, const Node *sender_node,
                                                         const ObjectID &reduction_id, int64_t object_size,
-                                                        bool reset_progress) {
+                                                        ReduceOp reduce_op, ReduceDataType reduce_dtype,
+                                                        const WireQuantization &quantization, bool reset_progress) {
   TIMELINE("notification InvokePullAndReduceObject");
   auto remote_address = receiver_node->owner_ip + ":" + std::to_string(notification_listener_port_);
   objectstore::NotificationListener::Stub *stub = create_or_get_notification_listener_stub(remote_address);
@@ -468,6 +706,10 @@ void NotificationServiceImpl::InvokePullAndReduceObject(Node *receiver_node, con
   request.set_object_id_to_pull(sender_node->object_id.Binary());
   request.set_is_sender_leaf(sender_node->is_leaf());
   request.set_reset_progress(reset_progress);
+  request.set_reduce_op(static_cast<objectstore::ReduceOp>(reduce_op));
+  request.set_reduce_dtype(static_cast<objectstore::ReduceDataType>(reduce_dtype));
+  request.mutable_quantization()->set_format(static_cast<objectstore::WireFormat>(quantization.format));
+  request.mutable_quantization()->set_error_feedback_id(quantization.error_feedback_id);
   PullAndReduceObjectReply reply;
   auto status = stub->PullAndReduceObject(&context, request, &reply);
   if (!status.ok()) {
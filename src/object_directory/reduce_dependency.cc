@@ -157,8 +157,12 @@ std::string ReduceTreeChain::DebugString() {
 
 Node *ReduceTask::AddObject(const ObjectID &object_id, int64_t object_size, const std::string &owner_ip) {
   if (!rtc_) {
-    // we intialize it now because previously we do not know the object size
-    int64_t maximum_chain_length = round(double(object_size) / double(HOPLITE_BANDWIDTH * HOPLITE_RPC_LATENCY));
+    // we intialize it now because previously we do not know the object size.
+    // the bandwidth term counts the bytes on the wire, which quantized reductions shrink.
+    double wire_ratio = double(wire_block_size(quantization_.format, HOPLITE_WIRE_BLOCK_ELEMENTS)) /
+                        double(HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float));
+    int64_t maximum_chain_length =
+        round(double(object_size) * wire_ratio / double(HOPLITE_BANDWIDTH * HOPLITE_RPC_LATENCY));
     // add one for the reduction result receiver
     rtc_ = std::make_unique<ReduceTreeChain>(num_reduce_objects_ + 1, maximum_chain_length);
     // we initialize the root node here, because it could be skipped later
@@ -206,18 +210,16 @@ Node *ReduceTask::AddObject(const ObjectID &object_id, int64_t object_size, cons
 }
 
 InbandDataNode *ReduceTask::AddInbandObject(const ObjectID &object_id, const std::string &inband_data) {
-  auto *data = (float *)inband_data.data();
-  size_t size = inband_data.size() / sizeof(float);
   if (reduced_inband_dst_.reduced_inband_data.empty()) {
-    reduced_inband_dst_.reduced_inband_data = std::vector<float>(data, data + size);
+    reduced_inband_dst_.reduced_inband_data = inband_data;
     reduced_inband_dst_.object_id = reduction_id_;
     reduced_inband_dst_.owner_ip = reduce_dst_;
   } else {
     // if we have got enough objects, skip reducing
     if (num_ready_objects_ < num_reduce_objects_) {
-      for (size_t i = 0; i < size; i++) {
-        reduced_inband_dst_.reduced_inband_data[i] += data[i];
-      }
+      int64_t n_elements = inband_data.size() / ReduceDataTypeSize(reduce_dtype_);
+      GetReduceKernel(reduce_op_, reduce_dtype_)(&reduced_inband_dst_.reduced_inband_data[0], inband_data.data(),
+                                                 n_elements);
     }
   }
   num_ready_objects_++;
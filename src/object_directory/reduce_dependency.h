@@ -10,6 +10,8 @@
 #include <vector>
 
 #include "common/id.h"
+#include "common/reduce_kernels.h"
+#include "common/wire_quantization.h"
 
 struct Node {
   // assotiated with the reduced object
@@ -67,10 +69,9 @@ struct Node {
 };
 
 struct InbandDataNode : Node {
-  std::vector<float> reduced_inband_data;
-  std::string get_inband_data() {
-    return std::string((char *)reduced_inband_data.data(), reduced_inband_data.size() * sizeof(float));
-  }
+  // raw bytes of the reduced elements
+  std::string reduced_inband_data;
+  std::string get_inband_data() { return reduced_inband_data; }
 };
 
 class ReduceTreeChain {
@@ -108,13 +109,14 @@ private:
   int64_t maximum_chain_length_;
 };
 
-// TODO(siyuan): support more reduce types
 class ReduceTask {
 public:
   ReduceTask(const std::string &reduce_dst, const std::vector<ObjectID> &remote_objects_for_reduce,
-             const ObjectID &reduction_id, int num_reduce_objects)
+             const ObjectID &reduction_id, int num_reduce_objects, ReduceOp reduce_op, ReduceDataType reduce_dtype,
+             const WireQuantization &quantization)
       : reduce_dst_(reduce_dst), remote_objects_for_reduce_(remote_objects_for_reduce), reduction_id_(reduction_id),
-        num_reduce_objects_(num_reduce_objects) {}
+        num_reduce_objects_(num_reduce_objects), reduce_op_(reduce_op), reduce_dtype_(reduce_dtype),
+        quantization_(quantization) {}
 
   Node *AddObject(const ObjectID &object_id, int64_t object_size, const std::string &owner_ip);
 
@@ -129,10 +131,16 @@ public:
   /// \return The destination node.
   InbandDataNode *AddInbandObject(const ObjectID &object_id, const std::string &inband_data);
 
-  std::vector<float> &GetInbandReducedData() { return reduced_inband_data_; }
+  const std::string &GetInbandReducedData() const { return reduced_inband_dst_.reduced_inband_data; }
 
   ObjectID GetReductionID() const { return reduction_id_; }
 
+  ReduceOp GetReduceOp() const { return reduce_op_; }
+
+  ReduceDataType GetReduceDataType() const { return reduce_dtype_; }
+
+  const WireQuantization &GetWireQuantization() const { return quantization_; }
+
   std::vector<ObjectID> GetReducedObjects() const {
     std::vector<ObjectID> object_ids;
     if (rtc_) {
@@ -186,6 +194,9 @@ private:
   ObjectID reduction_id_;
   int64_t object_size_ = -1;
   int num_reduce_objects_;
+  ReduceOp reduce_op_;
+  ReduceDataType reduce_dtype_;
+  WireQuantization quantization_;
   int num_ready_objects_ = 0;
   std::unique_ptr<ReduceTreeChain> rtc_;
   std::unordered_map<std::string, Node *> owner_to_node_;
@@ -193,19 +204,28 @@ private:
   std::unordered_set<ObjectID> ready_ids_;
   std::queue<Node *> suspended_nodes_;
   // for inband data
-  std::vector<float> reduced_inband_data_;
   InbandDataNode reduced_inband_dst_;
 };
 
 class ReduceManager {
 public:
-  void CreateReduceTask(const std::string &reduce_dst, const std::vector<ObjectID> &objects_to_reduce,
-                        const ObjectID &reduction_id, int num_reduce_objects) {
-    auto task = std::make_shared<ReduceTask>(reduce_dst, objects_to_reduce, reduction_id, num_reduce_objects);
+  /// Create the reduce task of a reduction.
+  /// \return False if the reduction ID has a task already. Two reduce trees must never run under
+  /// one ID, so the existing task is kept.
+  bool CreateReduceTask(const std::string &reduce_dst, const std::vector<ObjectID> &objects_to_reduce,
+                        const ObjectID &reduction_id, int num_reduce_objects, ReduceOp reduce_op,
+                        ReduceDataType reduce_dtype, const WireQuantization &quantization) {
+    auto search = tasks_.find(reduction_id);
+    if (search != tasks_.end() && search->second) {
+      return false;
+    }
+    auto task = std::make_shared<ReduceTask>(reduce_dst, objects_to_reduce, reduction_id, num_reduce_objects,
+                                             reduce_op, reduce_dtype, quantization);
     tasks_[reduction_id] = task;
     for (auto &id : objects_to_reduce) {
       object_id_to_tasks_[id].push_back(task);
     }
+    return true;
   }
 
   /// Mark one object is available for reduce.
@@ -50,12 +50,15 @@ int main(int argc, char **argv) {
 
     put_random_buffer<float>(store, rank_object_id, object_size);
     MPI_Barrier(MPI_COMM_WORLD);
+    if (world_rank == world_size - 1 && world_rank != 0) {
+      // a participant that holds a copy of the first object must not drive the reduction as well
+      std::shared_ptr<Buffer> copy;
+      store.Get(object_ids[0], &copy);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
 
     auto start = std::chrono::system_clock::now();
-    if (world_rank == 0) {
-      store.Reduce(object_ids, reduction_id);
-    }
-    store.Get(reduction_id, &reduction_result);
+    store.AllReduce(object_ids, reduction_id, &reduction_result, /*is_root=*/world_rank == 0);
     auto end = std::chrono::system_clock::now();
     std::chrono::duration<double> duration = end - start;
     LOG(INFO) << reduction_id.ToString() << " is reduced. duration = " << duration.count();
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/buffer.h"
+#include "common/chunk_compression.h"
+#include "util/logging.h"
+
+// Fill a buffer with one kind of payload.
+void fill_payload(const std::string &kind, Buffer *buffer) {
+  std::mt19937_64 rng(0);
+  uint8_t *data = buffer->MutableData();
+  const int64_t size = buffer->Size();
+  if (kind == "zeros") {
+    std::memset(data, 0, size);
+  } else if (kind == "sparse") {
+    // float32 embeddings with 90% zeros
+    float *values = (float *)data;
+    std::uniform_real_distribution<float> value(-1, 1);
+    for (int64_t i = 0; i < size / (int64_t)sizeof(float); i++) {
+      values[i] = rng() % 10 == 0 ? value(rng) : 0.0f;
+    }
+  } else if (kind == "mask") {
+    // runs of 0 and 1 bytes
+    int64_t i = 0;
+    uint8_t bit = 0;
+    while (i < size) {
+      int64_t run = std::min<int64_t>(size - i, 1 + rng() % 256);
+      std::memset(data + i, bit, run);
+      i += run;
+      bit ^= 1;
+    }
+  } else {
+    for (int64_t i = 0; i < size; i++) {
+      data[i] = rng();
+    }
+  }
+  buffer->Seal();
+}
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+  std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+// Compress 'object' chunk by chunk from 'offset' like the sender, and decompress it into 'received'
+// like the receiver. Return the number of bytes on the wire, or -1 if the object is corrupted.
+int64_t transfer(Buffer *object, int64_t offset, Buffer *received, double *compress_seconds,
+                 double *decompress_seconds) {
+  std::vector<std::shared_ptr<const std::string>> chunks;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int64_t begin = offset; begin < object->Size(); begin = compression_chunk_end(begin, object->Size())) {
+    chunks.push_back(
+        object->GetCompressedChunks()->Get(*object, begin, compression_chunk_end(begin, object->Size())));
+  }
+  *compress_seconds = seconds_since(start);
+  int64_t wire_size = 0;
+  start = std::chrono::high_resolution_clock::now();
+  int64_t begin = offset;
+  for (const auto &chunk : chunks) {
+    int64_t end = compression_chunk_end(begin, object->Size());
+    wire_size += sizeof(uint32_t);
+    if (chunk->empty()) {
+      std::memcpy(received->MutableData() + begin, object->Data() + begin, end - begin);
+      wire_size += end - begin;
+    } else if (decompress_chunk(*chunk, received->MutableData() + begin, end - begin)) {
+      return -1;
+    } else {
+      wire_size += chunk->size();
+    }
+    begin = end;
+  }
+  *decompress_seconds = seconds_since(start);
+  if (std::memcmp(received->Data() + offset, object->Data() + offset, object->Size() - offset) != 0) {
+    LOG(ERROR) << "the received object differs from the sent object";
+    return -1;
+  }
+  return wire_size;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, object_size
+  int64_t object_size = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (256LL << 20);
+  ::hoplite::RayLog::StartRayLog("compression_test", ::hoplite::RayLogLevel::INFO);
+  LOG(INFO) << "object_size = " << object_size << ", chunk_size = " << HOPLITE_COMPRESSION_CHUNK_SIZE;
+
+  bool ok = true;
+  for (const std::string kind : {"zeros", "sparse", "mask", "random"}) {
+    Buffer object(object_size);
+    Buffer received(object_size);
+    fill_payload(kind, &object);
+    double compress_seconds, decompress_seconds;
+    int64_t wire_size = transfer(&object, 0, &received, &compress_seconds, &decompress_seconds);
+    if (wire_size < 0) {
+      ok = false;
+      continue;
+    }
+    // forwarding reuses the cached chunks
+    double forward_seconds, unused;
+    ok = transfer(&object, 0, &received, &forward_seconds, &unused) == wire_size && ok;
+    // a resumed transfer starts in the middle of a chunk
+    ok = transfer(&object, object_size / 3 + 1, &received, &unused, &unused) >= 0 && ok;
+
+    double ratio = (double)object_size / wire_size;
+    double compress_gbps = object_size * 8 / compress_seconds / 1e9;
+    double decompress_gbps = object_size * 8 / decompress_seconds / 1e9;
+    LOG(INFO) << kind << ": ratio = " << ratio << ", compress = " << compress_gbps
+              << " Gb/s, decompress = " << decompress_gbps
+              << " Gb/s, forward = " << object_size * 8 / forward_seconds / 1e9 << " Gb/s";
+    // the chunks are compressed, sent and decompressed in a pipeline, so the slowest stage bounds
+    // the effective throughput of the object
+    for (double link_gbps : {1.0, 10.0, 25.0, 100.0}) {
+      double effective_gbps = std::min(std::min(compress_gbps, decompress_gbps), link_gbps * ratio);
+      LOG(INFO) << "  " << link_gbps << " Gb/s link: effective " << effective_gbps << " Gb/s, speedup = "
+                << effective_gbps / link_gbps;
+    }
+  }
+  return ok ? 0 : 1;
+}
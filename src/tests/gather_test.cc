@@ -1,4 +1,5 @@
 #include <chrono>
+#include <cstring>
 #include <memory>
 #include <mpi.h>
 #include <string>
@@ -29,6 +30,9 @@ int main(int argc, char **argv) {
   TIMELINE("main");
 
   DistributedObjectStore store(object_directory_address);
+  // the output is reused by all trials, like a training loop does
+  std::shared_ptr<Buffer> gather_result;
+  std::vector<ObjectID> previous_object_ids;
 
   for (int trial = 0; trial < n_trials; trial++) {
     std::vector<ObjectID> object_ids;
@@ -42,7 +46,7 @@ int main(int argc, char **argv) {
     DCHECK(object_size % sizeof(float) == 0);
 
     ObjectID rank_object_id = object_ids[world_rank];
-    std::unordered_map<ObjectID, std::shared_ptr<Buffer>> gather_result;
+    std::vector<int64_t> offsets;
 
     put_random_buffer<float>(store, rank_object_id, object_size);
 
@@ -50,18 +54,30 @@ int main(int argc, char **argv) {
 
     if (world_rank == 0) {
       auto start = std::chrono::system_clock::now();
-      for (auto &object_id : object_ids) {
-        store.Get(object_id, &gather_result[object_id]);
-      }
+      store.Gather(object_ids, &gather_result, &offsets);
       auto end = std::chrono::system_clock::now();
       std::chrono::duration<double> duration = end - start;
       LOG(INFO) << "Objects gathered. duration = " << duration.count();
 
+      DCHECK(gather_result->IsFinished()) << "The gathered buffer is not finished.";
       uint32_t sum_crc = 0;
-      for (auto &object_id : object_ids) {
-        sum_crc += gather_result[object_id]->Hash();
+      for (size_t i = 0; i < object_ids.size(); i++) {
+        uint64_t hash = Buffer(gather_result->MutableData() + offsets[i], object_size).Hash();
+        uint64_t expected = get_random_float_buffer(object_size / sizeof(float), object_ids[i].Hex())->Hash();
+        DCHECK(hash == expected) << "Object " << object_ids[i].ToString() << " is gathered incorrectly.";
+        sum_crc += hash;
       }
       LOG(INFO) << "Hash for objects is " << sum_crc;
+      // the objects of the previous trial are still served from our copies, which gathering
+      // into the same output and overwriting it must leave intact
+      for (const auto &object_id : previous_object_ids) {
+        std::shared_ptr<Buffer> buffer;
+        store.Get(object_id, &buffer);
+        DCHECK(buffer->Hash() == get_random_float_buffer(object_size / sizeof(float), object_id.Hex())->Hash())
+            << "Object " << object_id.ToString() << " is overwritten by a later gather.";
+      }
+      std::memset(gather_result->MutableData(), 0, gather_result->Size());
+      previous_object_ids = object_ids;
     }
     MPI_Barrier(MPI_COMM_WORLD);
   }
@@ -0,0 +1,357 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "client/local_store_client.h"
+#include "util/logging.h"
+
+#define CHECK_TRUE(cond)                                                                                               \
+  if (!(cond)) {                                                                                                       \
+    LOG(ERROR) << "check failed: " #cond;                                                                              \
+    return false;                                                                                                      \
+  }
+
+bool test_eviction() {
+  // a single shard, so the LRU order is global
+  LocalStoreClient store(300, 1);
+  std::vector<ObjectID> ids;
+  for (int i = 0; i < 5; i++) {
+    ids.push_back(ObjectID::FromRandom());
+  }
+  std::shared_ptr<Buffer> buffer;
+  for (int i = 0; i < 3; i++) {
+    store.Create(ids[i], 100, &buffer);
+    store.Seal(ids[i]);
+  }
+  buffer.reset();
+  // touch the oldest one, so the second one is the least recently used
+  ObjectBuffer object_buffer;
+  store.Get(ids[0], &object_buffer);
+  store.Create(ids[3], 100, &buffer);
+  buffer.reset();
+  CHECK_TRUE(store.ObjectExists(ids[0]) && !store.ObjectExists(ids[1], false) && store.ObjectExists(ids[2], false));
+  // ids[0] is referenced by 'object_buffer' and ids[2] is pinned, so only ids[3] can be evicted
+  CHECK_TRUE(store.Pin(ids[2]).ok());
+  std::shared_ptr<Buffer> in_use;
+  store.Create(ids[4], 100, &in_use);
+  CHECK_TRUE(store.ObjectExists(ids[0]) && store.ObjectExists(ids[2], false) && !store.ObjectExists(ids[3], false));
+  // all objects are in use, so the store exceeds its capacity
+  store.Create(ObjectID::FromRandom(), 100, &buffer);
+  CHECK_TRUE(store.TotalSize() == 400);
+  // unpinning lets the store shrink back
+  CHECK_TRUE(store.Unpin(ids[2]).ok());
+  CHECK_TRUE(!store.Unpin(ids[2]).ok());
+  CHECK_TRUE(store.TotalSize() == 300 && !store.ObjectExists(ids[2], false));
+  return true;
+}
+
+bool test_delete() {
+  LocalStoreClient store(1LL << 40, 4);
+  ObjectID object_id = ObjectID::FromRandom();
+  std::shared_ptr<Buffer> buffer;
+  store.Create(object_id, 100, &buffer);
+  store.Seal(object_id);
+  // pinned objects and objects in use can still be deleted
+  CHECK_TRUE(store.Pin(object_id).ok());
+  CHECK_TRUE(store.Delete(object_id).ok());
+  CHECK_TRUE(!store.ObjectExists(object_id, false) && store.TotalSize() == 0);
+  CHECK_TRUE(buffer->Size() == 100 && buffer.use_count() == 1);
+  CHECK_TRUE(!store.Delete(object_id).ok());
+  // the ID can be reused
+  store.Create(object_id, 50, &buffer);
+  CHECK_TRUE(store.ObjectExists(object_id, false) && store.TotalSize() == 50);
+  return true;
+}
+
+int count_files(const std::string &directory) {
+  int n_files = 0;
+  DIR *dir = opendir(directory.c_str());
+  while (struct dirent *entry = readdir(dir)) {
+    n_files += entry->d_name[0] != '.';
+  }
+  closedir(dir);
+  return n_files;
+}
+
+bool test_spill() {
+  char directory[] = "/tmp/hoplite-spill-XXXXXX";
+  CHECK_TRUE(mkdtemp(directory) != nullptr);
+  {
+    LocalStoreClient store(300, 1, directory);
+    std::vector<ObjectID> ids;
+    for (int i = 0; i < 5; i++) {
+      ids.push_back(ObjectID::FromRandom());
+      std::shared_ptr<Buffer> buffer;
+      store.Create(ids[i], 100, &buffer);
+      std::memset(buffer->MutableData(), i + 1, 100);
+      store.Seal(ids[i]);
+    }
+    // the two oldest objects are spilled in the background
+    CHECK_TRUE(store.TotalSize() == 300);
+    for (int trial = 0; trial < 1000 && count_files(directory) < 2; trial++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK_TRUE(count_files(directory) == 2);
+    // spilled objects still exist, and are restored when they are read
+    for (int i = 0; i < 5; i++) {
+      CHECK_TRUE(store.ObjectExists(ids[i]));
+      ObjectBuffer object_buffer;
+      store.Get(ids[i], &object_buffer);
+      CHECK_TRUE(object_buffer.data && object_buffer.data->IsFinished() && object_buffer.data->Size() == 100);
+      for (int j = 0; j < 100; j++) {
+        CHECK_TRUE(object_buffer.data->Data()[j] == i + 1);
+      }
+    }
+    CHECK_TRUE(store.TotalSize() == 300);
+    // deleting a spilled object removes its file
+    store.Delete(ids[0]);
+    for (int trial = 0; trial < 1000 && count_files(directory) != 4; trial++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK_TRUE(count_files(directory) == 4);
+  }
+  // the store removes its files when it is destroyed
+  CHECK_TRUE(count_files(directory) == 0);
+  rmdir(directory);
+  return true;
+}
+
+int count_shared_objects(const std::string &name) {
+  int n_objects = 0;
+  std::string prefix = "hoplite-" + name + "-";
+  DIR *dir = opendir("/dev/shm");
+  while (struct dirent *entry = readdir(dir)) {
+    std::string file = entry->d_name;
+    n_objects += file.compare(0, prefix.size(), prefix) == 0 && file != prefix + "index";
+  }
+  closedir(dir);
+  return n_objects;
+}
+
+bool test_shared_store() {
+  const std::string name = "test-" + std::to_string(getpid());
+  const int64_t size = HOPLITE_SHARED_OBJECT_MIN_SIZE * 4;
+  ObjectID object_id = ObjectID::FromRandom();
+  {
+    LocalStoreClient store(1LL << 40, 4, "", name);
+    std::shared_ptr<Buffer> buffer;
+    store.Create(object_id, size, &buffer);
+    std::memset(buffer->MutableData(), 7, size);
+    // objects are shared once they are sealed
+    pid_t child = fork();
+    if (child == 0) {
+      bool attached = LocalStoreClient(1LL << 40, 4, "", name).AttachShared(object_id);
+      _exit(attached ? 1 : 0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    CHECK_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    store.Seal(object_id);
+    child = fork();
+    if (child == 0) {
+      int code = 0;
+      {
+        LocalStoreClient other(1LL << 40, 4, "", name);
+        ObjectBuffer object_buffer;
+        if (other.AttachShared(object_id) && other.ObjectExists(object_id)) {
+          other.Get(object_id, &object_buffer);
+          for (int64_t i = 0; i < size && code == 0; i++) {
+            code = object_buffer.data->Data()[i] != 7 ? 2 : 0;
+          }
+          // writes of readers are private
+          object_buffer.data->MutableData()[0] = 8;
+        } else {
+          code = 1;
+        }
+      }
+      // the reference of this process is dropped with its store
+      _exit(code);
+    }
+    waitpid(child, &status, 0);
+    CHECK_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK_TRUE(buffer->Data()[0] == 7);
+    CHECK_TRUE(count_shared_objects(name) == 1);
+  }
+  // the last process that maps the object removes it
+  CHECK_TRUE(count_shared_objects(name) == 0);
+  unlink(("/dev/shm/hoplite-" + name + "-index").c_str());
+  return true;
+}
+
+// Whether a new process attaches the shared object with all bytes equal to 'value'.
+bool attached_in_child(const std::string &name, const ObjectID &object_id, uint8_t value) {
+  pid_t child = fork();
+  if (child == 0) {
+    int code = 0;
+    {
+      LocalStoreClient other(1LL << 40, 4, "", name);
+      ObjectBuffer object_buffer;
+      if (other.AttachShared(object_id)) {
+        other.Get(object_id, &object_buffer);
+        for (int64_t i = 0; i < object_buffer.data->Size() && code == 0; i++) {
+          code = object_buffer.data->Data()[i] != value ? 2 : 0;
+        }
+      } else {
+        code = 1;
+      }
+    }
+    _exit(code);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool test_shared_delete() {
+  const std::string name = "test-delete-" + std::to_string(getpid());
+  const int64_t size = HOPLITE_SHARED_OBJECT_MIN_SIZE * 4;
+  ObjectID object_id = ObjectID::FromRandom();
+  {
+    LocalStoreClient store(1LL << 40, 4, "", name);
+    std::shared_ptr<Buffer> old_buffer;
+    store.Create(object_id, size, &old_buffer);
+    std::memset(old_buffer->MutableData(), 7, size);
+    store.Seal(object_id);
+    CHECK_TRUE(attached_in_child(name, object_id, 7));
+    // a deleted object is not attached anymore, even while a transfer still holds it
+    CHECK_TRUE(store.Delete(object_id).ok());
+    CHECK_TRUE(!attached_in_child(name, object_id, 7));
+    CHECK_TRUE(count_shared_objects(name) == 1);
+    // the ID can be put again, and then the new object is attached
+    std::shared_ptr<Buffer> new_buffer;
+    store.Create(object_id, size, &new_buffer);
+    std::memset(new_buffer->MutableData(), 9, size);
+    store.Seal(object_id);
+    CHECK_TRUE(attached_in_child(name, object_id, 9));
+    CHECK_TRUE(old_buffer->Data()[0] == 7);
+    old_buffer.reset();
+    CHECK_TRUE(count_shared_objects(name) == 1);
+    // another process that puts the same ID replaces our object in the index
+    pid_t child = fork();
+    if (child == 0) {
+      bool ok;
+      {
+        LocalStoreClient other(1LL << 40, 4, "", name);
+        std::shared_ptr<Buffer> buffer;
+        other.Create(object_id, size, &buffer);
+        std::memset(buffer->MutableData(), 5, size);
+        other.Seal(object_id);
+        ok = attached_in_child(name, object_id, 5);
+      }
+      _exit(ok ? 0 : 1);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    CHECK_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK_TRUE(new_buffer->Data()[0] == 9);
+  }
+  CHECK_TRUE(count_shared_objects(name) == 0);
+  unlink(("/dev/shm/hoplite-" + name + "-index").c_str());
+  return true;
+}
+
+bool test_concurrent_create(int n_shards) {
+  LocalStoreClient store(1LL << 40, n_shards);
+  const int n_threads = 8;
+  const int n_objects = 256;
+  std::vector<ObjectID> ids;
+  for (int i = 0; i < n_objects; i++) {
+    ids.push_back(ObjectID::FromRandom());
+  }
+  // every thread creates or gets every object, so all of them must agree on the buffers
+  std::vector<std::vector<Buffer *>> seen(n_threads, std::vector<Buffer *>(n_objects));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < n_objects; i++) {
+        std::shared_ptr<Buffer> buffer;
+        store.GetBufferOrCreate(ids[(i + t * 31) % n_objects], 64, &buffer);
+        seen[t][(i + t * 31) % n_objects] = buffer.get();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (int t = 1; t < n_threads; t++) {
+    CHECK_TRUE(seen[t] == seen[0]);
+  }
+  CHECK_TRUE(store.TotalSize() == 64 * n_objects);
+  return true;
+}
+
+/// Mixed store operations, similar to the ones of senders, receivers and 'Get' for many
+/// small objects. Returns million operations per second.
+double benchmark(int n_shards, int n_threads, int64_t n_operations) {
+  LocalStoreClient store(1LL << 40, n_shards);
+  const int n_objects = 1024;
+  std::vector<ObjectID> ids;
+  for (int i = 0; i < n_objects; i++) {
+    ids.push_back(ObjectID::FromRandom());
+    std::shared_ptr<Buffer> buffer;
+    store.Create(ids.back(), 64, &buffer);
+    store.Seal(ids.back());
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; t++) {
+    threads.emplace_back([&, t]() {
+      uint64_t x = t * 7919 + 1;
+      for (int64_t i = 0; i < n_operations; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        const ObjectID &object_id = ids[(x >> 33) % n_objects];
+        switch (i % 4) {
+        case 0: {
+          store.ObjectExists(object_id);
+        } break;
+        case 1: {
+          ObjectBuffer object_buffer;
+          store.Get(object_id, &object_buffer);
+        } break;
+        case 2: {
+          std::shared_ptr<Buffer> buffer;
+          store.GetBufferOrCreate(object_id, 64, &buffer);
+        } break;
+        default: {
+          store.Seal(object_id);
+        } break;
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end - start;
+  return n_threads * n_operations / duration.count() / 1e6;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, n_operations_per_thread
+  int64_t n_operations = argc > 1 ? std::strtoll(argv[1], NULL, 10) : 1000000;
+  ::hoplite::RayLog::StartRayLog("local_store_test", ::hoplite::RayLogLevel::INFO);
+
+  bool ok = test_eviction();
+  ok = test_delete() && ok;
+  ok = test_spill() && ok;
+  ok = test_shared_store() && ok;
+  ok = test_shared_delete() && ok;
+  for (int n_shards : {1, HOPLITE_LOCAL_STORE_SHARDS}) {
+    ok = test_concurrent_create(n_shards) && ok;
+  }
+  LOG(INFO) << "hardware concurrency = " << std::thread::hardware_concurrency();
+  for (int n_threads : {1, 2, 4, 8, 16}) {
+    double single = benchmark(1, n_threads, n_operations);
+    double sharded = benchmark(HOPLITE_LOCAL_STORE_SHARDS, n_threads, n_operations);
+    LOG(INFO) << n_threads << " threads: 1 shard " << single << " Mops/s, " << HOPLITE_LOCAL_STORE_SHARDS
+              << " shards " << sharded << " Mops/s, speedup = " << sharded / single;
+  }
+  return ok ? 0 : 1;
+}
@@ -6,5 +6,23 @@ int main() {
   std::cout << ReduceTreeChain(152, 24).DebugString();
   std::cout << ReduceTreeChain(61, 2).DebugString();
   std::cout << ReduceTreeChain(32, 44).DebugString();
+
+  // a second task under the same reduction ID is rejected, e.g. from another node holding a copy
+  ReduceManager manager;
+  ObjectID reduction_id = ObjectID::FromRandom();
+  std::vector<ObjectID> objects = {ObjectID::FromRandom(), ObjectID::FromRandom()};
+  WireQuantization quantization;
+  if (!manager.CreateReduceTask("10.0.0.1", objects, reduction_id, 2, ReduceOp::SUM, ReduceDataType::FLOAT32,
+                                quantization)) {
+    std::cout << "failed to create a reduce task" << std::endl;
+    return 1;
+  }
+  std::shared_ptr<ReduceTask> task = manager.GetReduceTask(reduction_id);
+  if (manager.CreateReduceTask("10.0.0.2", objects, reduction_id, 2, ReduceOp::SUM, ReduceDataType::FLOAT32,
+                               quantization) ||
+      manager.GetReduceTask(reduction_id) != task) {
+    std::cout << "created two reduce tasks under one reduction ID" << std::endl;
+    return 1;
+  }
   return 0;
 }
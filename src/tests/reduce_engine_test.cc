@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+#include "common/reduce_engine.h"
+#include "common/reduce_kernels.h"
+#include "util/logging.h"
+
+constexpr ReduceDataType kReduceDataTypes[] = {ReduceDataType::FLOAT32, ReduceDataType::FLOAT64,
+                                               ReduceDataType::INT32, ReduceDataType::INT64,
+                                               ReduceDataType::FLOAT16};
+
+// Small integers, which every data type sums exactly.
+void fill(std::vector<uint8_t> &data, ReduceDataType dtype, std::mt19937 &rng) {
+  size_t element_size = ReduceDataTypeSize(dtype);
+  std::memset(data.data(), 0, data.size());
+  for (size_t i = 0; i < data.size() / element_size; i++) {
+    uint8_t *p = data.data() + i * element_size;
+    int value = rng() % 8;
+    switch (dtype) {
+    case ReduceDataType::FLOAT32: {
+      float f = value;
+      std::memcpy(p, &f, sizeof(f));
+    } break;
+    case ReduceDataType::FLOAT64: {
+      double d = value;
+      std::memcpy(p, &d, sizeof(d));
+    } break;
+    case ReduceDataType::INT32: {
+      int32_t v = value;
+      std::memcpy(p, &v, sizeof(v));
+    } break;
+    case ReduceDataType::INT64: {
+      int64_t v = value;
+      std::memcpy(p, &v, sizeof(v));
+    } break;
+    default: {
+      // half precision: 1.0 or 0
+      uint16_t h = value % 2 ? 0x3c00 : 0;
+      std::memcpy(p, &h, sizeof(h));
+    }
+    }
+  }
+}
+
+// Reduce with the engine and with a single kernel call, and compare the results bit by bit.
+bool check(ReduceEngine &engine, ReduceDataType dtype, int64_t n_elements, std::mt19937 &rng) {
+  const size_t element_size = ReduceDataTypeSize(dtype);
+  std::vector<uint8_t> dst(n_elements * element_size), src(dst.size());
+  fill(dst, dtype, rng);
+  fill(src, dtype, rng);
+  std::vector<uint8_t> expected(dst);
+  ReduceKernel kernel = GetReduceKernel(ReduceOp::SUM, dtype);
+  kernel(expected.data(), src.data(), n_elements);
+  engine.Reduce(kernel, dst.data(), src.data(), n_elements, element_size);
+  if (dst != expected) {
+    LOG(ERROR) << ReduceDataTypeName(dtype) << " with " << n_elements << " elements differs from the kernel";
+    return false;
+  }
+  return true;
+}
+
+double measure(ReduceEngine &engine, std::vector<uint8_t> &dst, const std::vector<uint8_t> &src, int64_t n_trials) {
+  ReduceKernel kernel = GetReduceKernel(ReduceOp::SUM, ReduceDataType::FLOAT32);
+  int64_t n_elements = dst.size() / sizeof(float);
+  // warm up the workers and the page tables
+  engine.Reduce(kernel, dst.data(), src.data(), n_elements, sizeof(float));
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int64_t trial = 0; trial < n_trials; trial++) {
+    engine.Reduce(kernel, dst.data(), src.data(), n_elements, sizeof(float));
+  }
+  std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+  return duration.count() / n_trials;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, object_size, n_trials
+  int64_t object_size = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (256LL << 20);
+  int64_t n_trials = argc > 2 ? std::strtoll(argv[2], NULL, 10) : 10;
+  ::hoplite::RayLog::StartRayLog("reduce_engine_test", ::hoplite::RayLogLevel::INFO);
+  LOG(INFO) << "object_size = " << object_size << ", chunk_size = " << HOPLITE_REDUCE_CHUNK_SIZE
+            << ", hardware threads = " << std::thread::hardware_concurrency();
+
+  bool ok = true;
+  std::mt19937 rng(0);
+  ReduceEngine engine(3);
+  // sizes around the chunk boundaries, and ranges that leave a partial chunk
+  for (ReduceDataType dtype : kReduceDataTypes) {
+    int64_t chunk_elements = HOPLITE_REDUCE_CHUNK_SIZE / ReduceDataTypeSize(dtype);
+    for (int64_t n_elements : {int64_t(1), chunk_elements - 1, chunk_elements, chunk_elements + 1,
+                               7 * chunk_elements + 3}) {
+      ok = check(engine, dtype, n_elements, rng) && ok;
+    }
+  }
+  // concurrent callers share the workers
+  {
+    std::vector<std::thread> callers;
+    std::vector<char> results(4);
+    for (size_t i = 0; i < results.size(); i++) {
+      callers.emplace_back([&, i]() {
+        std::mt19937 caller_rng(i);
+        results[i] = check(engine, ReduceDataType::FLOAT32, 5 * (HOPLITE_REDUCE_CHUNK_SIZE / 4) + 1, caller_rng);
+      });
+    }
+    for (auto &caller : callers) {
+      caller.join();
+    }
+    ok = std::all_of(results.begin(), results.end(), [](char result) { return result; }) && ok;
+  }
+  // an engine without workers reduces on the caller
+  {
+    ReduceEngine serial(0);
+    ok = check(serial, ReduceDataType::INT64, 9 * (HOPLITE_REDUCE_CHUNK_SIZE / 8), rng) && ok;
+  }
+
+  std::vector<uint8_t> dst(object_size), src(object_size);
+  fill(dst, ReduceDataType::FLOAT32, rng);
+  fill(src, ReduceDataType::FLOAT32, rng);
+  double serial_seconds = 0;
+  int max_workers = std::max<int>(std::thread::hardware_concurrency() - 1, 1);
+  for (int n_workers = 0; n_workers <= max_workers; n_workers = n_workers ? n_workers * 2 : 1) {
+    ReduceEngine scaling(n_workers);
+    double seconds = measure(scaling, dst, src, n_trials);
+    if (n_workers == 0) {
+      serial_seconds = seconds;
+    }
+    LOG(INFO) << n_workers << " workers: " << object_size * 8 / seconds / 1e9
+              << " Gb/s, speedup = " << serial_seconds / seconds;
+  }
+
+  ReduceEngine &shared = ReduceEngine::Get();
+  LOG(INFO) << "shared engine: " << shared.NumWorkers() << " workers, reduce = " << shared.ReduceThroughput() * 8 / 1e9
+            << " Gb/s per thread, link = " << shared.LinkThroughput() * 8 / 1e9 << " Gb/s";
+  for (int64_t size : {64LL << 10, 1LL << 20, 16LL << 20, 256LL << 20}) {
+    LOG(INFO) << "  overlap receiving and reducing " << size << " bytes: " << shared.ShouldOverlap(size);
+  }
+  return ok ? 0 : 1;
+}
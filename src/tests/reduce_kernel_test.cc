@@ -0,0 +1,145 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/reduce_kernels.h"
+#include "util/logging.h"
+
+constexpr ReduceOp kReduceOps[] = {ReduceOp::SUM, ReduceOp::MIN, ReduceOp::MAX, ReduceOp::PROD};
+constexpr ReduceDataType kReduceDataTypes[] = {ReduceDataType::FLOAT32, ReduceDataType::FLOAT64,
+                                               ReduceDataType::INT32,   ReduceDataType::INT64,
+                                               ReduceDataType::FLOAT16, ReduceDataType::BFLOAT16};
+
+// The loop used by the reduce paths before vectorized kernels were introduced.
+// 'noinline' keeps the compiler from specializing it at the call site.
+__attribute__((noinline)) void baseline_reduce(void *dst, const void *src, int64_t n) {
+  float *cursor = (float *)dst;
+  const float *own_data_cursor = (const float *)src;
+  for (int64_t i = 0; i < n; i++) {
+    cursor[i] += own_data_cursor[i];
+  }
+}
+
+double measure(ReduceKernel kernel, std::vector<uint8_t> &dst, const std::vector<uint8_t> &src, size_t element_size,
+               int64_t n_trials) {
+  int64_t n_elements = dst.size() / element_size;
+  // warm up the caches and page tables
+  kernel(dst.data(), src.data(), n_elements);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int64_t trial = 0; trial < n_trials; trial++) {
+    kernel(dst.data(), src.data(), n_elements);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end - start;
+  return duration.count() / n_trials;
+}
+
+// Fill with small integers that every data type represents exactly, so the results
+// of all levels must be identical bit by bit (products stay in range as well).
+void fill(std::vector<uint8_t> &data, ReduceDataType dtype, std::mt19937 &rng) {
+  size_t element_size = ReduceDataTypeSize(dtype);
+  for (size_t i = 0; i < data.size() / element_size; i++) {
+    int value = (int)(rng() % 15) - 7;
+    uint8_t *p = data.data() + i * element_size;
+    switch (dtype) {
+    case ReduceDataType::FLOAT32: {
+      float f = value;
+      std::memcpy(p, &f, sizeof(f));
+    } break;
+    case ReduceDataType::FLOAT64: {
+      double d = value;
+      std::memcpy(p, &d, sizeof(d));
+    } break;
+    case ReduceDataType::INT32: {
+      int32_t v = value;
+      std::memcpy(p, &v, sizeof(v));
+    } break;
+    case ReduceDataType::INT64: {
+      int64_t v = value;
+      std::memcpy(p, &v, sizeof(v));
+    } break;
+    case ReduceDataType::FLOAT16: {
+      // small integers in half precision: sign, exponent and the top mantissa bits
+      float f = value;
+      uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      uint16_t h = value == 0 ? 0 : (((u >> 16) & 0x8000) | ((((u >> 23) & 0xff) - 112) << 10) | ((u >> 13) & 0x3ff));
+      std::memcpy(p, &h, sizeof(h));
+    } break;
+    case ReduceDataType::BFLOAT16: {
+      float f = value;
+      uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      uint16_t h = u >> 16;
+      std::memcpy(p, &h, sizeof(h));
+    } break;
+    }
+  }
+}
+
+bool verify(ReduceOp op, ReduceDataType dtype, SimdLevel level, int64_t n_elements, std::mt19937 &rng) {
+  size_t element_size = ReduceDataTypeSize(dtype);
+  // odd sizes exercise the tail handling of the vectorized kernels
+  for (int64_t n : {n_elements, n_elements + 1, n_elements + 15, (int64_t)7}) {
+    std::vector<uint8_t> dst(n * element_size), src(n * element_size);
+    fill(dst, dtype, rng);
+    fill(src, dtype, rng);
+    std::vector<uint8_t> expected = dst;
+    GetReduceKernel(op, dtype, SimdLevel::SCALAR)(expected.data(), src.data(), n);
+    GetReduceKernel(op, dtype, level)(dst.data(), src.data(), n);
+    if (dst != expected) {
+      LOG(ERROR) << ReduceOpName(op) << "/" << ReduceDataTypeName(dtype) << "/" << SimdLevelName(level)
+                 << " differs from the scalar kernel (n = " << n << ")";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, object_size, n_trials
+  int64_t object_size = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (64 << 20);
+  int64_t n_trials = argc > 2 ? std::strtoll(argv[2], NULL, 10) : 10;
+  ::hoplite::RayLog::StartRayLog("reduce_kernel_test", ::hoplite::RayLogLevel::INFO);
+
+  SimdLevel best = DetectSimdLevel();
+  LOG(INFO) << "object_size = " << object_size << ", n_trials = " << n_trials
+            << ", detected level: " << SimdLevelName(best);
+
+  bool ok = true;
+  std::mt19937 rng(0);
+  for (ReduceOp op : kReduceOps) {
+    for (ReduceDataType dtype : kReduceDataTypes) {
+      for (int level = (int)SimdLevel::SSE; level <= (int)best; level++) {
+        ok = verify(op, dtype, (SimdLevel)level, 1 << 10, rng) && ok;
+      }
+    }
+  }
+
+  std::vector<uint8_t> dst(object_size), src(object_size);
+  fill(dst, ReduceDataType::FLOAT32, rng);
+  fill(src, ReduceDataType::FLOAT32, rng);
+  double baseline = measure(baseline_reduce, dst, src, sizeof(float), n_trials);
+  // The throughput counts the bytes of the reduced stream, which is what the
+  // reduce paths have to keep up with compared to the link bandwidth.
+  LOG(INFO) << "baseline sum/float32: " << object_size / baseline / (1 << 30) << " GB/s";
+  for (int level = (int)SimdLevel::SCALAR; level <= (int)best; level++) {
+    double duration =
+        measure(GetReduceKernel(ReduceOp::SUM, ReduceDataType::FLOAT32, (SimdLevel)level), dst, src, 4, n_trials);
+    LOG(INFO) << "sum/float32/" << SimdLevelName((SimdLevel)level) << ": " << object_size / duration / (1 << 30)
+              << " GB/s, speedup = " << baseline / duration;
+  }
+  for (ReduceOp op : kReduceOps) {
+    for (ReduceDataType dtype : kReduceDataTypes) {
+      fill(dst, dtype, rng);
+      fill(src, dtype, rng);
+      double duration = measure(GetReduceKernel(op, dtype), dst, src, ReduceDataTypeSize(dtype), n_trials);
+      LOG(INFO) << ReduceOpName(op) << "/" << ReduceDataTypeName(dtype) << ": "
+                << object_size / duration / (1 << 30) << " GB/s";
+    }
+  }
+  return ok ? 0 : 1;
+}
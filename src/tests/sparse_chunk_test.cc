@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "common/reduce_kernels.h"
+#include "common/sparse_chunk.h"
+#include "common/wire_quantization.h"
+#include "util/logging.h"
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+  std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+// Float32 gradients of an embedding table where only a fraction of the rows are touched.
+std::vector<float> sparse_gradient(int64_t n_elements, double density, int64_t row_size, std::mt19937_64 *rng) {
+  std::vector<float> gradient(n_elements, 0.0f);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::normal_distribution<float> normal(0, 1);
+  for (int64_t row = 0; row < n_elements; row += row_size) {
+    if (uniform(*rng) < density) {
+      for (int64_t i = row; i < std::min(n_elements, row + row_size); i++) {
+        gradient[i] = normal(*rng);
+      }
+    }
+  }
+  return gradient;
+}
+
+// Send 'src' block by block like a sparse transfer from 'offset'. Return the number of bytes on
+// the wire, or -1 if the received bytes differ.
+int64_t transfer(const uint8_t *src, int64_t size, int64_t offset, int64_t *n_dense_blocks) {
+  std::vector<uint8_t> received(size, 0xff);
+  std::string chunk;
+  int64_t wire_size = 0;
+  *n_dense_blocks = 0;
+  for (int64_t begin = offset; begin < size; begin = wire_block_end(offset, begin, size)) {
+    int64_t end = wire_block_end(offset, begin, size);
+    uint32_t n_nonzero = sparse_chunk_encode(src + begin, end - begin, &chunk);
+    wire_size += sizeof(n_nonzero);
+    if (n_nonzero == kSparseDenseChunk) {
+      std::memcpy(received.data() + begin, src + begin, end - begin);
+      wire_size += end - begin;
+      (*n_dense_blocks)++;
+    } else {
+      if ((int64_t)chunk.size() != sparse_chunk_size(n_nonzero) ||
+          sparse_chunk_decode((const uint8_t *)chunk.data(), n_nonzero, received.data() + begin, end - begin)) {
+        LOG(ERROR) << "failed to decode the sparse chunk of [" << begin << ", " << end << ")";
+        return -1;
+      }
+      wire_size += chunk.size();
+    }
+  }
+  if (std::memcmp(received.data() + offset, src + offset, size - offset) != 0) {
+    LOG(ERROR) << "the received object differs from the sent object";
+    return -1;
+  }
+  return wire_size;
+}
+
+// Reduce 'src' into 'dst' block by block like a sparse transfer, with the nonzero words reduced
+// in place. Return false if the result differs from the dense reduction.
+bool sparse_reduce(const uint8_t *src, const uint8_t *dst, int64_t size, ReduceDataType dtype) {
+  ReduceKernel kernel = GetReduceKernel(ReduceOp::SUM, dtype);
+  const size_t element_size = ReduceDataTypeSize(dtype);
+  std::vector<uint8_t> expected(dst, dst + size);
+  kernel(expected.data(), src, size / element_size);
+  std::vector<uint8_t> reduced(dst, dst + size);
+  std::string chunk;
+  for (int64_t begin = 0; begin < size; begin = wire_block_end(0, begin, size)) {
+    int64_t end = wire_block_end(0, begin, size);
+    uint32_t n_nonzero = sparse_chunk_encode(src + begin, end - begin, &chunk);
+    if (n_nonzero == kSparseDenseChunk) {
+      kernel(reduced.data() + begin, src + begin, (end - begin) / element_size);
+    } else if (sparse_chunk_reduce((const uint8_t *)chunk.data(), n_nonzero, kernel, element_size,
+                                   reduced.data() + begin, end - begin)) {
+      LOG(ERROR) << "failed to reduce the sparse chunk of [" << begin << ", " << end << ")";
+      return false;
+    }
+  }
+  if (reduced != expected) {
+    LOG(ERROR) << "the sparse reduction of dtype " << (int)dtype << " differs from the dense reduction";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, n_elements
+  int64_t n_elements = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (64LL << 20);
+  ::hoplite::RayLog::StartRayLog("sparse_chunk_test", ::hoplite::RayLogLevel::INFO);
+  LOG(INFO) << "n_elements = " << n_elements << ", max_density = " << HOPLITE_SPARSE_MAX_DENSITY_PERCENT << "%";
+
+  std::mt19937_64 rng(0);
+  bool ok = true;
+  for (double density : {0.0, 0.001, 0.01, 0.1, 1.0}) {
+    std::vector<float> gradient = sparse_gradient(n_elements, density, 64, &rng);
+    const uint8_t *data = (const uint8_t *)gradient.data();
+    const int64_t size = n_elements * sizeof(float);
+    int64_t n_dense_blocks;
+    auto start = std::chrono::high_resolution_clock::now();
+    int64_t wire_size = transfer(data, size, 0, &n_dense_blocks);
+    double seconds = seconds_since(start);
+    if (wire_size < 0) {
+      ok = false;
+      continue;
+    }
+    // a resumed transfer starts in the middle of a block
+    int64_t unused;
+    ok = transfer(data, size, size / 3 + 4, &unused) >= 0 && ok;
+    LOG(INFO) << "density " << density << ": ratio = " << (double)size / wire_size << ", dense blocks = "
+              << n_dense_blocks << ", encode + decode = " << size * 8 / seconds / 1e9 << " Gb/s";
+  }
+
+  // any element type goes through the chunks exactly, and blocks that are not whole words are
+  // sent as they are
+  {
+    std::vector<uint8_t> bytes(3 * HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float) + 6, 0);
+    for (size_t i = 0; i < bytes.size(); i += 97) {
+      bytes[i] = 1 + rng() % 255;
+    }
+    int64_t n_dense_blocks;
+    ok = transfer(bytes.data(), bytes.size(), 0, &n_dense_blocks) >= 0 && n_dense_blocks == 1 && ok;
+    ok = transfer(bytes.data(), bytes.size(), 2, &n_dense_blocks) >= 0 && ok;
+  }
+
+  // a sparse reduction matches the dense one, also for elements with zero words (small int64)
+  for (double density : {0.0, 0.01, 0.1}) {
+    const int64_t size = 4 * HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float) + 64;
+    std::vector<float> gradient = sparse_gradient(size / sizeof(float), density, 16, &rng);
+    std::vector<uint8_t> local(size);
+    for (int64_t i = 0; i < size; i++) {
+      local[i] = rng() % 64;
+    }
+    for (ReduceDataType dtype : {ReduceDataType::FLOAT32, ReduceDataType::FLOAT64, ReduceDataType::INT32,
+                                 ReduceDataType::INT64}) {
+      ok = sparse_reduce((const uint8_t *)gradient.data(), local.data(), size, dtype) && ok;
+    }
+    // the halves of float32 bit patterns can be NaN, whose payloads depend on the kernel path
+    std::vector<uint16_t> halves(size / sizeof(uint16_t));
+    std::memcpy(halves.data(), gradient.data(), size);
+    for (uint16_t &half : halves) {
+      half &= ~(1 << 14);
+    }
+    ok = sparse_reduce((const uint8_t *)halves.data(), local.data(), size, ReduceDataType::FLOAT16) && ok;
+    std::vector<int64_t> counters(size / sizeof(int64_t), 0);
+    for (size_t i = 0; i < counters.size(); i += 7) {
+      counters[i] = rng() % 1000;
+    }
+    ok = sparse_reduce((const uint8_t *)counters.data(), local.data(), size, ReduceDataType::INT64) && ok;
+  }
+
+  // corrupted chunks are rejected
+  {
+    std::vector<uint8_t> block(HOPLITE_WIRE_BLOCK_ELEMENTS * sizeof(float), 0);
+    block[8] = block[4] = 1;
+    std::string chunk;
+    uint32_t n_nonzero = sparse_chunk_encode(block.data(), block.size(), &chunk);
+    std::swap(chunk[0], chunk[2]);
+    std::vector<uint8_t> received(block.size());
+    if (n_nonzero != 2 ||
+        sparse_chunk_decode((const uint8_t *)chunk.data(), n_nonzero, received.data(), received.size()) != -1) {
+      LOG(ERROR) << "an unsorted sparse chunk is accepted";
+      ok = false;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
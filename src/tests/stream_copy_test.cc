@@ -0,0 +1,136 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "common/buffer.h"
+#include "common/stream_copy.h"
+#include "util/logging.h"
+
+// The copy loop of Buffer::StreamCopy before the parallel copy was introduced.
+__attribute__((noinline)) void baseline_stream_copy(uint8_t *dst, const uint8_t *data, int64_t size,
+                                                    ProgressCounter *progress) {
+  size_t copy_size = size / 1024;
+  if (copy_size < 4096) {
+    copy_size = 4096;
+  } else if (copy_size > 2 << 20) {
+    copy_size = 2 << 20;
+  } else {
+    copy_size = (copy_size >> 6) << 6;
+  }
+  size_t cursor = 0;
+  while (copy_size + cursor <= (size_t)size) {
+    memcpy(dst + cursor, data + cursor, copy_size);
+    progress->Add(copy_size);
+    cursor += copy_size;
+  }
+  memcpy(dst + cursor, data + cursor, size - cursor);
+  progress->Store(size);
+}
+
+template <typename F> double measure(F copy, int64_t n_trials) {
+  // warm up the page tables
+  copy();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int64_t trial = 0; trial < n_trials; trial++) {
+    copy();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end - start;
+  return duration.count() / n_trials;
+}
+
+bool verify_non_temporal_copy() {
+  std::vector<uint8_t> src(4096 + 64), dst(4096 + 64);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = i * 7 + 3;
+  }
+  // unaligned heads and tails of every length
+  for (size_t offset = 0; offset < 33; offset++) {
+    for (size_t size : {(size_t)0, (size_t)1, (size_t)31, (size_t)127, (size_t)129, (size_t)4000}) {
+      std::memset(dst.data(), 0, dst.size());
+      NonTemporalCopy(dst.data() + offset, src.data() + 1, size);
+      if (std::memcmp(dst.data() + offset, src.data() + 1, size) != 0 || dst[offset + size] != 0) {
+        LOG(ERROR) << "NonTemporalCopy is wrong (offset = " << offset << ", size = " << size << ")";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Copy with a reader streaming behind the progress, which must be monotonic and only cover
+// copied bytes.
+bool verify_parallel_copy(int64_t size, int n_threads, int64_t chunk_size) {
+  std::vector<uint8_t> src(size), dst(size, 0);
+  for (int64_t i = 0; i < size; i++) {
+    src[i] = (i % 251) + 1;
+  }
+  ProgressCounter progress(0);
+  std::atomic<bool> ok(true);
+  std::thread reader([&]() {
+    int64_t checked = 0;
+    while (checked < size) {
+      int64_t current = progress.Wait(checked + 1);
+      if (current < checked) {
+        LOG(ERROR) << "progress moved backwards: " << checked << " -> " << current;
+        ok = false;
+        return;
+      }
+      if (std::memcmp(dst.data() + checked, src.data() + checked, current - checked) != 0) {
+        LOG(ERROR) << "published bytes in [" << checked << ", " << current << ") are not copied";
+        ok = false;
+        return;
+      }
+      checked = current;
+    }
+  });
+  ParallelStreamCopy(dst.data(), src.data(), size, n_threads, chunk_size, &progress);
+  reader.join();
+  if (progress.Load() != size || dst != src) {
+    LOG(ERROR) << "ParallelStreamCopy is wrong (size = " << size << ", n_threads = " << n_threads << ")";
+    return false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, object_size, n_trials
+  int64_t object_size = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (1LL << 30);
+  int64_t n_trials = argc > 2 ? std::strtoll(argv[2], NULL, 10) : 5;
+  ::hoplite::RayLog::StartRayLog("stream_copy_test", ::hoplite::RayLogLevel::INFO);
+  LOG(INFO) << "object_size = " << object_size << ", n_trials = " << n_trials;
+
+  bool ok = verify_non_temporal_copy();
+  for (int n_threads : {1, 2, 4, 7}) {
+    ok = verify_parallel_copy((8 << 20) + 13, n_threads, 64 << 10) && ok;
+  }
+
+  auto src = std::make_shared<Buffer>(object_size);
+  std::memset(src->MutableData(), 1, object_size);
+  src->Seal();
+  auto dst = std::make_shared<Buffer>(object_size);
+  double baseline = measure(
+      [&]() {
+        ProgressCounter progress(0);
+        baseline_stream_copy(dst->MutableData(), src->Data(), object_size, &progress);
+      },
+      n_trials);
+  LOG(INFO) << "baseline StreamCopy: " << object_size / baseline / (1 << 30) << " GB/s";
+  for (int n_threads : {1, 2, 4, 8}) {
+    double duration = measure(
+        [&]() {
+          ProgressCounter progress(0);
+          ParallelStreamCopy(dst->MutableData(), src->Data(), object_size, n_threads, HOPLITE_STREAM_COPY_CHUNK_SIZE,
+                             &progress);
+        },
+        n_trials);
+    LOG(INFO) << "ParallelStreamCopy with " << n_threads << " threads: " << object_size / duration / (1 << 30)
+              << " GB/s, speedup = " << baseline / duration;
+  }
+  double duration = measure([&]() { Buffer(object_size).StreamCopy(*src); }, n_trials);
+  LOG(INFO) << "Buffer::StreamCopy (including allocation): " << object_size / duration / (1 << 30) << " GB/s";
+  return ok ? 0 : 1;
+}
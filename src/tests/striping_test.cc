@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "common/buffer.h"
+#include "common/striped_progress.h"
+#include "util/logging.h"
+#include "util/socket_utils.h"
+
+// A port apart from the ports of the object store, so it can run next to it.
+constexpr int kBenchmarkPort = 20310;
+
+// Serve ranges of 'data' to a connection. Every request is a pair of int64 (begin, end).
+void serve_connection(int conn_fd, const std::vector<uint8_t> *data) {
+  int64_t range[2];
+  while (recv_all(conn_fd, range, sizeof(range)) == 0) {
+    if (range[0] < 0 || range[1] > (int64_t)data->size() || range[0] > range[1]) {
+      break;
+    }
+    if (send_all(conn_fd, data->data() + range[0], range[1] - range[0])) {
+      break;
+    }
+  }
+  close(conn_fd);
+}
+
+void serve(int64_t object_size) {
+  std::vector<uint8_t> *data = new std::vector<uint8_t>(object_size);
+  for (int64_t i = 0; i < object_size; i++) {
+    (*data)[i] = i % 251;
+  }
+  struct sockaddr_in address;
+  int server_fd;
+  tcp_bind_and_listen(kBenchmarkPort, &address, &server_fd);
+  while (true) {
+    socklen_t addrlen = sizeof(address);
+    int conn_fd = accept(server_fd, (struct sockaddr *)&address, &addrlen);
+    if (conn_fd < 0) {
+      continue;
+    }
+    std::thread(serve_connection, conn_fd, data).detach();
+  }
+}
+
+// Receive the object over one connection per range, merging the progress like the receiver.
+bool receive_striped(const std::vector<int> &connections, Buffer *buffer) {
+  StripedProgress striped(buffer, StripedProgress::Split(0, buffer->Size(), connections.size(), 64));
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> threads;
+  for (size_t range = 0; range < striped.Size(); range++) {
+    threads.emplace_back([&, range]() {
+      int64_t request[2] = {striped.Begin(range), striped.End(range)};
+      send_all(connections[range], request, sizeof(request));
+      int64_t progress = striped.Begin(range);
+      while (progress < striped.End(range)) {
+        int64_t block = std::min(striped.End(range) - progress, STREAM_MAX_BLOCK_SIZE);
+        ssize_t n = recv(connections[range], buffer->MutableData() + progress, block, 0);
+        if (n <= 0) {
+          LOG(ERROR) << "recv error (" << strerror(errno) << ")";
+          ok = false;
+          return;
+        }
+        progress += n;
+        striped.Update(range, progress);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  return ok;
+}
+
+// Stream the merged progress of a striped transfer and check the bytes behind it.
+bool verify_striped(const std::vector<int> &connections, int64_t object_size) {
+  Buffer buffer(object_size);
+  buffer.SetProgress(0);
+  std::atomic<bool> ok(true);
+  std::thread reader([&]() {
+    int64_t checked = 0;
+    while (checked < object_size) {
+      int64_t current = buffer.WaitProgress(checked + 1);
+      if (current < checked) {
+        LOG(ERROR) << "progress moved backwards: " << checked << " -> " << current;
+        ok = false;
+        return;
+      }
+      for (int64_t i = checked; i < current; i++) {
+        if (buffer.Data()[i] != i % 251) {
+          LOG(ERROR) << "published byte " << i << " is not received";
+          ok = false;
+          return;
+        }
+      }
+      checked = current;
+    }
+  });
+  ok = receive_striped(connections, &buffer) && ok;
+  reader.join();
+  return ok && buffer.IsFinished();
+}
+
+int main(int argc, char **argv) {
+  // argv: *, object_size, n_trials, [server | sender_ip]
+  // without the third argument, the sender runs in this process and the object goes over loopback.
+  // to measure a real NIC, run "server" on one node and pass its address on another.
+  int64_t object_size = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (1LL << 30);
+  int64_t n_trials = argc > 2 ? std::strtoll(argv[2], NULL, 10) : 5;
+  std::string sender_ip = argc > 3 ? argv[3] : "127.0.0.1";
+  ::hoplite::RayLog::StartRayLog("striping_test", ::hoplite::RayLogLevel::INFO);
+  if (sender_ip == "server") {
+    serve(object_size);
+    return 0;
+  }
+  if (argc <= 3) {
+    std::thread(serve, object_size).detach();
+  }
+  LOG(INFO) << "object_size = " << object_size << ", n_trials = " << n_trials << ", sender = " << sender_ip;
+
+  bool ok = true;
+  double single = 0;
+  Buffer buffer(object_size);
+  for (int n_stripes : {1, 2, 4, 8}) {
+    std::vector<int> connections(n_stripes);
+    for (int &conn_fd : connections) {
+      // the server may still be starting
+      while (tcp_connect(sender_ip, kBenchmarkPort, &conn_fd)) {
+        close(conn_fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+    }
+    ok = verify_striped(connections, std::min<int64_t>(object_size, 8 << 20)) && ok;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int64_t trial = 0; trial < n_trials; trial++) {
+      buffer.SetProgress(0);
+      ok = receive_striped(connections, &buffer) && ok;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    double seconds = duration.count() / n_trials;
+    if (n_stripes == 1) {
+      single = seconds;
+    }
+    LOG(INFO) << n_stripes << " stripes: " << object_size * 8 / seconds / 1e9
+              << " Gb/s, speedup = " << single / seconds;
+    for (int conn_fd : connections) {
+      close(conn_fd);
+    }
+  }
+  return ok ? 0 : 1;
+}
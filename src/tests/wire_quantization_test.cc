@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "common/config.h"
+#include "common/wire_quantization.h"
+#include "util/logging.h"
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+  std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+// Encode and decode 'src' block by block like a transfer, optionally with error feedback.
+void transfer(WireFormat format, const std::vector<float> &src, std::vector<float> *dst, ErrorFeedback *feedback,
+              const ObjectID &transfer_id, int64_t *wire_size) {
+  const int64_t n = src.size();
+  std::vector<uint8_t> wire(wire_block_size(format, HOPLITE_WIRE_BLOCK_ELEMENTS));
+  *wire_size = 0;
+  for (int64_t begin = 0; begin < n; begin += HOPLITE_WIRE_BLOCK_ELEMENTS) {
+    int64_t count = std::min<int64_t>(n - begin, HOPLITE_WIRE_BLOCK_ELEMENTS);
+    if (feedback) {
+      feedback->Encode(format, transfer_id, src.data() + begin, begin, count, wire.data());
+    } else {
+      wire_encode(format, src.data() + begin, count, wire.data(), nullptr);
+    }
+    wire_decode(format, wire.data(), count, dst->data() + begin);
+    *wire_size += wire_block_size(format, count);
+  }
+}
+
+// The largest error relative to the largest magnitude of the block.
+double max_relative_error(const std::vector<float> &expected, const std::vector<float> &actual) {
+  double max_error = 0;
+  for (size_t begin = 0; begin < expected.size(); begin += HOPLITE_WIRE_BLOCK_ELEMENTS) {
+    size_t end = std::min<size_t>(expected.size(), begin + HOPLITE_WIRE_BLOCK_ELEMENTS);
+    double magnitude = 0;
+    for (size_t i = begin; i < end; i++) {
+      magnitude = std::max(magnitude, (double)std::fabs(expected[i]));
+    }
+    for (size_t i = begin; i < end; i++) {
+      max_error = std::max(max_error, std::fabs(expected[i] - actual[i]) / magnitude);
+    }
+  }
+  return max_error;
+}
+
+int main(int argc, char **argv) {
+  // argv: *, n_elements
+  int64_t n_elements = argc > 1 ? std::strtoll(argv[1], NULL, 10) : (16LL << 20);
+  ::hoplite::RayLog::StartRayLog("wire_quantization_test", ::hoplite::RayLogLevel::INFO);
+  LOG(INFO) << "n_elements = " << n_elements << ", block_elements = " << HOPLITE_WIRE_BLOCK_ELEMENTS;
+
+  std::mt19937_64 rng(0);
+  std::normal_distribution<float> normal(0, 1);
+  std::vector<float> gradient(n_elements);
+  for (auto &x : gradient) {
+    x = normal(rng);
+  }
+
+  bool ok = true;
+  // the bound of the error of a single transfer, relative to the largest magnitude of the block
+  const std::pair<WireFormat, double> bounds[] = {
+      {WireFormat::RAW, 0}, {WireFormat::FLOAT16, 1.0 / 1024}, {WireFormat::BFLOAT16, 1.0 / 128},
+      {WireFormat::INT8, 0.5 / 127 + 1e-6}};
+  for (const auto &bound : bounds) {
+    WireFormat format = bound.first;
+    std::vector<float> received(n_elements);
+    int64_t wire_size;
+    auto start = std::chrono::high_resolution_clock::now();
+    transfer(format, gradient, &received, nullptr, ObjectID::FromRandom(), &wire_size);
+    double seconds = seconds_since(start);
+    double error = max_relative_error(gradient, received);
+    double ratio = (double)n_elements * sizeof(float) / wire_size;
+    LOG(INFO) << WireFormatName(format) << ": ratio = " << ratio << ", max relative error = " << error
+              << ", encode + decode = " << n_elements * sizeof(float) * 8 / seconds / 1e9 << " Gb/s";
+    if (error > bound.second) {
+      LOG(ERROR) << WireFormatName(format) << " exceeds the error bound " << bound.second;
+      ok = false;
+    }
+  }
+
+  // with error feedback, the error of the sum over many reductions stays at the error of a single
+  // transfer instead of growing with the number of reductions
+  const int n_iterations = 64;
+  const int64_t n_feedback = std::min<int64_t>(n_elements, 1 << 20);
+  std::vector<float> small(gradient.begin(), gradient.begin() + n_feedback);
+  for (WireFormat format : {WireFormat::BFLOAT16, WireFormat::INT8}) {
+    ErrorFeedback feedback(n_feedback);
+    std::vector<double> sent_sum(n_feedback, 0), plain_sum(n_feedback, 0);
+    std::vector<float> received(n_feedback);
+    int64_t wire_size;
+    for (int iteration = 0; iteration < n_iterations; iteration++) {
+      transfer(format, small, &received, &feedback, ObjectID::FromRandom(), &wire_size);
+      for (int64_t i = 0; i < n_feedback; i++) {
+        sent_sum[i] += received[i];
+      }
+      transfer(format, small, &received, nullptr, ObjectID::FromRandom(), &wire_size);
+      for (int64_t i = 0; i < n_feedback; i++) {
+        plain_sum[i] += received[i];
+      }
+    }
+    double feedback_error = 0, plain_error = 0;
+    for (int64_t i = 0; i < n_feedback; i++) {
+      feedback_error = std::max(feedback_error, std::fabs(sent_sum[i] - (double)small[i] * n_iterations));
+      plain_error = std::max(plain_error, std::fabs(plain_sum[i] - (double)small[i] * n_iterations));
+    }
+    LOG(INFO) << WireFormatName(format) << " over " << n_iterations
+              << " reductions: max error of the sum = " << feedback_error << " with error feedback, " << plain_error
+              << " without";
+    if (feedback_error * 4 > plain_error) {
+      LOG(ERROR) << "error feedback does not bound the accumulated error";
+      ok = false;
+    }
+  }
+
+  // a block that is sent again in the same transfer does not consume the residual twice
+  {
+    const int64_t n = HOPLITE_WIRE_BLOCK_ELEMENTS;
+    ErrorFeedback feedback(n);
+    std::vector<float> block(gradient.begin(), gradient.begin() + n);
+    std::vector<uint8_t> first(wire_block_size(WireFormat::INT8, n)), second(first.size());
+    // leave a residual from an earlier reduction
+    feedback.Encode(WireFormat::INT8, ObjectID::FromRandom(), block.data(), 0, n, first.data());
+    ObjectID transfer_id = ObjectID::FromRandom();
+    feedback.Encode(WireFormat::INT8, transfer_id, block.data(), 0, n, first.data());
+    feedback.Encode(WireFormat::INT8, transfer_id, block.data(), 0, n, second.data());
+    std::vector<uint8_t> plain(first.size());
+    wire_encode(WireFormat::INT8, block.data(), n, plain.data(), nullptr);
+    if (second != plain) {
+      LOG(ERROR) << "a resent block is encoded with the residual";
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #include "logging.h"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
@@ -10,16 +12,19 @@
 #include <mutex>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <thread>
 #include <unistd.h>
 #include <zlib.h>
 
 #include "logging.h"
+#include "socket_utils.h"
 
 constexpr int BACKLOG = 10;
 
@@ -28,10 +33,10 @@ int send_all(int conn_fd, const void *buf, const size_t size) {
   while (cursor < size) {
     int bytes_sent = send(conn_fd, (const uint8_t *)buf + cursor, size - cursor, 0);
     if (bytes_sent < 0) {
-      LOG(ERROR) << "Socket send error (" << strerror(errno) << ", code=" << errno << ")";
-      if (errno == EAGAIN) {
+      if (errno == EAGAIN && wait_socket(conn_fd, POLLOUT) > 0) {
         continue;
       }
+      LOG(ERROR) << "Socket send error (" << strerror(errno) << ", code=" << errno << ")";
       return bytes_sent;
     }
     cursor += bytes_sent;
@@ -44,16 +49,42 @@ int recv_all(int conn_fd, void *buf, const size_t size) {
   while (cursor < size) {
     int bytes_recv = recv(conn_fd, (uint8_t *)buf + cursor, size - cursor, 0);
     if (bytes_recv < 0) {
-      if (errno == EAGAIN) {
+      if (errno == EAGAIN && wait_socket(conn_fd, POLLIN) > 0) {
         continue;
       }
       return bytes_recv;
+    } else if (bytes_recv == 0) {
+      // the peer has closed the connection
+      return -1;
     }
     cursor += bytes_recv;
   }
   return 0;
 }
 
+int wait_socket(int conn_fd, short events, int wakeup_fd) {
+  struct pollfd fds[2];
+  fds[0].fd = conn_fd;
+  fds[0].events = events;
+  fds[1].fd = wakeup_fd;
+  fds[1].events = POLLIN;
+  while (true) {
+    int n_ready = poll(fds, wakeup_fd >= 0 ? 2 : 1, -1);
+    if (n_ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Socket poll error (" << strerror(errno) << ", code=" << errno << ")";
+      return -1;
+    }
+    if (wakeup_fd >= 0 && (fds[1].revents & POLLIN)) {
+      return 0;
+    }
+    // errors and hang-ups are reported by the following send/recv
+    return 1;
+  }
+}
+
 int tcp_connect(const std::string &ip_address, int port, int *conn_fd) {
   struct sockaddr_in push_addr;
   *conn_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -86,6 +117,48 @@ void tcp_bind_and_listen(int port, struct sockaddr_in *address, int *server_fd)
   DCHECK(!status) << "Socket listen error.";
 }
 
+std::string local_socket_name(const std::string &ip_address, int port) {
+  return "hoplite-" + ip_address + ":" + std::to_string(port);
+}
+
+namespace {
+
+socklen_t abstract_socket_address(const std::string &name, struct sockaddr_un *address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  // a leading null byte puts the name in the abstract namespace
+  size_t name_size = std::min(name.size(), sizeof(address->sun_path) - 1);
+  memcpy(address->sun_path + 1, name.data(), name_size);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + name_size;
+}
+
+} // namespace
+
+int unix_connect(const std::string &name, int *conn_fd) {
+  struct sockaddr_un address;
+  socklen_t address_size = abstract_socket_address(name, &address);
+  *conn_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  DCHECK(*conn_fd >= 0) << "socket creation error";
+  int status = connect(*conn_fd, (struct sockaddr *)&address, address_size);
+  if (status) {
+    close(*conn_fd);
+  }
+  return status;
+}
+
+void unix_bind_and_listen(const std::string &name, int *server_fd) {
+  struct sockaddr_un address;
+  socklen_t address_size = abstract_socket_address(name, &address);
+  *server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  DCHECK(*server_fd >= 0) << "socket creation error";
+
+  auto status = bind(*server_fd, (struct sockaddr *)&address, address_size);
+  DCHECK(!status) << "Cannot bind to the local socket " << name << " (errno = " << errno << ").";
+
+  status = listen(*server_fd, BACKLOG);
+  DCHECK(!status) << "Socket listen error.";
+}
+
 void recv_ack(int fd) {
   char ack[5];
   auto status = recv_all(fd, ack, 3);
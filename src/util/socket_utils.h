@@ -7,10 +7,30 @@ int send_all(int conn_fd, const void *buf, const size_t size);
 
 int recv_all(int conn_fd, void *buf, const size_t size);
 
+/// Wait until the socket is ready for 'events' (POLLIN or POLLOUT), or until 'wakeup_fd' becomes readable.
+/// \param conn_fd The socket.
+/// \param events The poll events to wait for.
+/// \param wakeup_fd A file descriptor that interrupts the wait when it is readable. Negative means none.
+/// \return 1 if the socket is ready, 0 if the wait was interrupted by 'wakeup_fd', and -1 on errors.
+int wait_socket(int conn_fd, short events, int wakeup_fd = -1);
+
 int tcp_connect(const std::string &ip_address, int port, int *conn_fd);
 
 void tcp_bind_and_listen(int port, struct sockaddr_in *address, int *server_fd);
 
+/// The name of the Unix domain socket of a server, for peers on the same host. The name is in
+/// the abstract namespace, which belongs to the network namespace, so only peers that share
+/// the network (and thus the address) of the server can connect to it.
+/// \param ip_address The address of the server.
+/// \param port The TCP port of the server.
+std::string local_socket_name(const std::string &ip_address, int port);
+
+/// Connect to a Unix domain socket in the abstract namespace.
+/// \return 0 on success. The connection is closed on failure.
+int unix_connect(const std::string &name, int *conn_fd);
+
+void unix_bind_and_listen(const std::string &name, int *server_fd);
+
 void recv_ack(int fd);
 
 void send_ack(int fd);